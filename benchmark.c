@@ -0,0 +1,565 @@
+/*
+ * benchmark.c: in-process generation benchmark covering every puzzle
+ * in the collection, with machine-readable output.
+ *
+ * For each preset of each game, we generate a fixed set of puzzles
+ * (game ids '<params>#1' up to '<params>#<n>', so successive runs
+ * measure the same work) and check that each can be solved from its
+ * description alone, as benchmark.sh used to with '--generate
+ * --test-solve'. (A game whose solver gives up after a fixed amount
+ * of work may refuse a hard puzzle; that isn't an error, but the
+ * number of refusals is reported.) For each preset we report
+ * percentiles of the wall
+ * clock and CPU time taken by generation, the allocations made per
+ * puzzle (counted by malloc.c, which is built with MALLOC_STATS
+ * defined), and the peak resident set size. Each preset is run in a
+ * child process of its own, so that the peak is that preset's and not
+ * the largest of everything run before it, and so that no cache one
+ * preset builds up speeds up the next.
+ *
+ * The environment is cleared before timing anything, as benchmark.sh
+ * used to with 'env -i': otherwise a <GAME>_DEFAULT setting, or one
+ * turning on the optional threaded code (SOLO_THREADS, MINES_THREADS,
+ * PUZZLES_POOL), would change what was measured.
+ *
+ * Usage: benchmark [--seeds <n>] [<game>...]
+ *        benchmark --ids <n> [<game>...]
+ *
+ * The output is a JSON document on standard output. Games can be
+ * named on the command line as they are in the Unix binary names; by
+ * default all of them are run.
+ *
+ * With '--ids', nothing is timed: for each game, n puzzles with the
+ * default parameters and no seed are generated one after another in
+ * an interactive mid-end (drawing to nowhere), each is clicked in the
+ * middle, and the resulting game ids are listed. This is the path
+ * the optional threaded code takes (Solo's parallel clue stripping,
+ * Mines' speculative layouts, the mid-end's puzzle pool), all of
+ * which promise to produce exactly the puzzles the serial code does,
+ * so 'make test' compares the lists with each of them turned off and
+ * on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "puzzles.h"
+
+extern const game *gamelist[];
+extern const int gamecount;
+
+extern char **environ;
+static char *empty_environment[] = { NULL };
+
+/* ----------------------------------------------------------------------
+ * The front end functions the mid-end and the games need. We never
+ * draw anything or run timers.
+ */
+
+void frontend_default_colour(frontend *fe, float *output)
+{
+    output[0] = output[1] = output[2] = 0.8F;
+}
+
+void activate_timer(frontend *fe) {}
+void deactivate_timer(frontend *fe) {}
+
+void get_random_seed(void **randseed, int *randseedsize)
+{
+    /* Only reached if a game id has no seed, which ours always do. */
+    static const char seed[] = "benchmark";
+
+    *randseed = snewn(sizeof(seed), char);
+    memcpy(*randseed, seed, sizeof(seed));
+    *randseedsize = sizeof(seed);
+}
+
+void fatal(const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "fatal error: ");
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+#ifdef DEBUGGING
+void debug_printf(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+#endif
+
+/*
+ * A drawing API that draws nothing, for the mid-ends of '--ids',
+ * which have to be interactive ones.
+ */
+struct blitter {
+    int dummy;
+};
+
+static void null_draw_text(void *handle, int x, int y, int fonttype,
+                           int fontsize, int align, int colour,
+                           const char *text) {}
+static void null_draw_rect(void *handle, int x, int y, int w, int h,
+                           int colour) {}
+static void null_draw_line(void *handle, int x1, int y1, int x2, int y2,
+                           int colour) {}
+static void null_draw_polygon(void *handle, int *coords, int npoints,
+                              int fillcolour, int outlinecolour) {}
+static void null_draw_circle(void *handle, int cx, int cy, int radius,
+                             int fillcolour, int outlinecolour) {}
+static void null_clip(void *handle, int x, int y, int w, int h) {}
+static void null_unclip(void *handle) {}
+static void null_start_draw(void *handle) {}
+static void null_end_draw(void *handle) {}
+static blitter *null_blitter_new(void *handle, int w, int h)
+{
+    return snew(blitter);
+}
+static void null_blitter_free(void *handle, blitter *bl)
+{
+    sfree(bl);
+}
+static void null_blitter_save(void *handle, blitter *bl, int x, int y) {}
+static void null_blitter_load(void *handle, blitter *bl, int x, int y) {}
+
+static const struct drawing_api null_drawing = {
+    null_draw_text,
+    null_draw_rect,
+    null_draw_line,
+    null_draw_polygon,
+    null_draw_circle,
+    NULL /* draw_update */,
+    null_clip,
+    null_unclip,
+    null_start_draw,
+    null_end_draw,
+    NULL /* status_bar */,
+    null_blitter_new,
+    null_blitter_free,
+    null_blitter_save,
+    null_blitter_load,
+    NULL /* begin_doc */,
+    NULL /* begin_page */,
+    NULL /* begin_puzzle */,
+    NULL /* end_puzzle */,
+    NULL /* end_page */,
+    NULL /* end_doc */,
+    NULL /* line_width */,
+    NULL /* line_dotted */,
+    NULL /* text_fallback */,
+    NULL /* draw_thick_line */,
+};
+
+/* ----------------------------------------------------------------------
+ * Measurement.
+ */
+
+static double wall_time(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static double cpu_time(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0 +
+            ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0);
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;               /* kilobytes, on Linux at least */
+}
+
+static int double_cmp(const void *av, const void *bv)
+{
+    double a = *(const double *)av, b = *(const double *)bv;
+    return a < b ? -1 : a > b ? +1 : 0;
+}
+
+/* Nearest-rank percentile of a sorted array. */
+static double percentile(const double *sorted, int n, int pc)
+{
+    int i = (n * pc + 99) / 100 - 1;
+    return sorted[i < 0 ? 0 : i];
+}
+
+/* ----------------------------------------------------------------------
+ * JSON output.
+ */
+
+static void json_string(const char *s)
+{
+    putchar('"');
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+            printf("\\%c", c);
+        else if (c < 0x20)
+            printf("\\u%04x", c);
+        else
+            putchar(c);
+    }
+    putchar('"');
+}
+
+static void json_times(const char *name, double *samples, int n)
+{
+    double *sorted = snewn(n, double);
+    double total = 0.0;
+    int i;
+
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), double_cmp);
+    for (i = 0; i < n; i++)
+        total += samples[i];
+
+    printf("      \"%s\": {\"min\": %.6f, \"p50\": %.6f, \"p90\": %.6f, "
+           "\"p99\": %.6f, \"max\": %.6f, \"mean\": %.6f,\n"
+           "        \"samples\": [", name, sorted[0],
+           percentile(sorted, n, 50), percentile(sorted, n, 90),
+           percentile(sorted, n, 99), sorted[n-1], total / n);
+    for (i = 0; i < n; i++)
+        printf("%s%.6f", i ? ", " : "", samples[i]);
+    printf("]}");
+
+    sfree(sorted);
+}
+
+/* ----------------------------------------------------------------------
+ * The benchmark itself.
+ */
+
+struct bench {
+    int nseeds;
+    double *wall, *cpu;
+    int npresets;
+    int failed;
+};
+
+/*
+ * Classify an error from midend_solve(). Games with no algorithmic
+ * solver can't solve a puzzle without its aux_info at all, which is
+ * fine; a game whose solver works to a fixed budget (Cube) says so
+ * when a puzzle is beyond it, which is worth counting but isn't a
+ * failure either. Anything else is a bug.
+ */
+enum { SOLVE_OK, SOLVE_REFUSED, SOLVE_FAILED };
+static int solve_result(const char *err)
+{
+    if (!err || !strcmp(err, "Solution not known for this puzzle"))
+        return SOLVE_OK;
+    if (strstr(err, "too difficult to solve automatically"))
+        return SOLVE_REFUSED;
+    return SOLVE_FAILED;
+}
+
+/*
+ * Generate and solve 'nseeds' puzzles with one set of parameters, and
+ * print the results as one element of the presets array.
+ */
+static void run_preset(struct bench *b, const game *thegame,
+                       const char *title, const game_params *params)
+{
+    midend *me = midend_new(NULL, thegame, NULL, NULL);
+    char *pstr = thegame->encode_params(params, TRUE);
+    char *id = snewn(strlen(pstr) + 40, char);
+    unsigned long count0 = smalloc_count, bytes0 = smalloc_bytes;
+    unsigned long count, bytes;
+    const char *err;
+    int i, refused = 0;
+
+    for (i = 0; i < b->nseeds; i++) {
+        double w, c;
+
+        sprintf(id, "%s#%d", pstr, i + 1);
+        err = midend_game_id(me, id);
+        if (err) {
+            fprintf(stderr, "%s %s: error parsing game id: %s\n",
+                    thegame->name, id, err);
+            b->failed = TRUE;
+            break;
+        }
+
+        w = wall_time();
+        c = cpu_time();
+        midend_new_game(me);
+        b->cpu[i] = cpu_time() - c;
+        b->wall[i] = wall_time() - w;
+
+        if (thegame->can_solve) {
+            /*
+             * Re-enter the game id to get rid of the aux_info, and
+             * make sure the game can still be solved. (Our mid-end
+             * has no drawing, so this never starts an animation.)
+             */
+            char *gameid = midend_get_game_id(me);
+            err = midend_game_id(me, gameid);
+            sfree(gameid);
+            if (!err) {
+                midend_new_game(me);
+                err = midend_solve(me);
+                switch (solve_result(err)) {
+                  case SOLVE_OK:
+                    err = NULL;
+                    break;
+                  case SOLVE_REFUSED:
+                    refused++;
+                    err = NULL;
+                    break;
+                }
+            }
+            if (err) {
+                fprintf(stderr, "%s %s: solve error: %s\n",
+                        thegame->name, id, err);
+                b->failed = TRUE;
+            }
+        }
+    }
+
+    /*
+     * The allocation counts include the solving, and the mid-end's
+     * own bookkeeping, as well as generation proper.
+     */
+    count = smalloc_count - count0;
+    bytes = smalloc_bytes - bytes0;
+
+    if (i == b->nseeds) {
+        printf("%s    {\"game\": ", b->npresets ? ",\n" : "");
+        json_string(thegame->htmlhelp_topic);
+        printf(", \"preset\": ");
+        json_string(title);
+        printf(", \"params\": ");
+        json_string(pstr);
+        printf(",\n");
+        json_times("wall", b->wall, b->nseeds);
+        printf(",\n");
+        json_times("cpu", b->cpu, b->nseeds);
+        printf(",\n      \"allocs_per_puzzle\": %.1f, "
+               "\"bytes_per_puzzle\": %.1f, \"peak_rss_kb\": %ld, "
+               "\"solve_refused\": %d}",
+               (double)count / b->nseeds, (double)bytes / b->nseeds,
+               peak_rss_kb(), refused);
+        fflush(stdout);
+        b->npresets++;
+    }
+
+    sfree(id);
+    sfree(pstr);
+    midend_free(me);
+}
+
+/*
+ * Do run_preset() in a child process, and pass its results back to
+ * us in its exit status.
+ */
+#define CHILD_FAILED 1
+#define CHILD_PRINTED 2
+static void bench_preset(struct bench *b, const game *thegame,
+                         const char *title, const game_params *params)
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0)
+        fatal("unable to fork: %s", strerror(errno));
+
+    if (pid == 0) {
+        int npresets = b->npresets;
+
+        b->failed = FALSE;
+        run_preset(b, thegame, title, params);
+        fflush(stdout);
+        _exit((b->failed ? CHILD_FAILED : 0) |
+              (b->npresets > npresets ? CHILD_PRINTED : 0));
+    }
+
+    if (waitpid(pid, &status, 0) < 0)
+        fatal("waitpid: %s", strerror(errno));
+    if (!WIFEXITED(status)) {
+        fprintf(stderr, "%s %s: benchmark process died\n",
+                thegame->name, title);
+        b->failed = TRUE;
+        return;
+    }
+    status = WEXITSTATUS(status);
+    if (status & CHILD_FAILED)
+        b->failed = TRUE;
+    if (status & CHILD_PRINTED)
+        b->npresets++;
+}
+
+static void bench_menu(struct bench *b, const game *thegame,
+                       struct preset_menu *menu, const char *prefix)
+{
+    int i;
+
+    for (i = 0; i < menu->n_entries; i++) {
+        struct preset_menu_entry *e = &menu->entries[i];
+        char *title = snewn(strlen(prefix) + strlen(e->title) + 4, char);
+
+        sprintf(title, "%s%s%s", prefix, *prefix ? " / " : "", e->title);
+        if (e->params)
+            bench_preset(b, thegame, title, e->params);
+        else
+            bench_menu(b, thegame, e->submenu, title);
+        sfree(title);
+    }
+}
+
+static void bench_game(struct bench *b, const game *thegame)
+{
+    midend *me = midend_new(NULL, thegame, NULL, NULL);
+    struct preset_menu *menu = midend_get_presets(me, NULL);
+
+    if (menu->n_entries > 0) {
+        bench_menu(b, thegame, menu, "");
+    } else {
+        game_params *params = thegame->default_params();
+        bench_preset(b, thegame, "Default", params);
+        thegame->free_params(params);
+    }
+
+    midend_free(me);
+}
+
+/*
+ * List 'n' random game ids for one game, generated and played as the
+ * GTK front end would (see the comment at the top).
+ */
+static void list_ids(const game *thegame, int n)
+{
+    midend *me = midend_new(NULL, thegame, &null_drawing, NULL);
+    int i;
+
+    for (i = 0; i < n; i++) {
+        int x = 800, y = 600;
+        char *id;
+
+        midend_new_game(me);
+        midend_size(me, &x, &y, FALSE);
+        midend_process_key(me, x/2, y/2, LEFT_BUTTON);
+        midend_process_key(me, x/2, y/2, LEFT_RELEASE);
+
+        id = midend_get_game_id(me);
+        printf("%s: %s\n", thegame->htmlhelp_topic, id);
+        sfree(id);
+    }
+
+    midend_free(me);
+}
+
+/* Match a game as named on the command line, ignoring case. */
+static int game_matches(const game *thegame, const char *name)
+{
+    const char *p = thegame->htmlhelp_topic;
+
+    while (*p && *name && tolower((unsigned char)*p) ==
+           tolower((unsigned char)*name))
+        p++, name++;
+    return !*p && !*name;
+}
+
+int main(int argc, char **argv)
+{
+    struct bench b;
+    int *selected = snewn(gamecount, int);
+    int i, nselected = 0, nids = 0;
+
+    b.nseeds = 100;
+    b.npresets = 0;
+    b.failed = FALSE;
+    memset(selected, 0, gamecount * sizeof(int));
+
+    for (i = 1; i < argc; i++) {
+        const char *p = argv[i];
+
+        if (!strcmp(p, "--seeds") && i+1 < argc) {
+            b.nseeds = atoi(argv[++i]);
+            if (b.nseeds <= 0) {
+                fprintf(stderr, "%s: --seeds needs a positive number\n",
+                        argv[0]);
+                return 1;
+            }
+        } else if (!strcmp(p, "--ids") && i+1 < argc) {
+            nids = atoi(argv[++i]);
+            if (nids <= 0) {
+                fprintf(stderr, "%s: --ids needs a positive number\n",
+                        argv[0]);
+                return 1;
+            }
+        } else if (p[0] == '-') {
+            fprintf(stderr, "usage: %s [--seeds <n>] [<game>...]\n"
+                    "       %s --ids <n> [<game>...]\n", argv[0], argv[0]);
+            return 1;
+        } else {
+            int j;
+            for (j = 0; j < gamecount; j++)
+                if (game_matches(gamelist[j], p))
+                    break;
+            if (j == gamecount) {
+                fprintf(stderr, "%s: unknown game '%s'\n", argv[0], p);
+                return 1;
+            }
+            selected[j] = TRUE;
+            nselected++;
+        }
+    }
+
+    if (nids) {
+        for (i = 0; i < gamecount; i++)
+            if (!nselected || selected[i])
+                list_ids(gamelist[i], nids);
+        sfree(selected);
+        return 0;
+    }
+
+    environ = empty_environment;
+
+    b.wall = snewn(b.nseeds, double);
+    b.cpu = snewn(b.nseeds, double);
+
+    printf("{\"version\": ");
+    json_string(ver);
+    printf(", \"seeds\": %d,\n  \"presets\": [\n", b.nseeds);
+    for (i = 0; i < gamecount; i++)
+        if (!nselected || selected[i])
+            bench_game(&b, gamelist[i]);
+    printf("\n  ]\n}\n");
+
+    sfree(b.wall);
+    sfree(b.cpu);
+    sfree(selected);
+
+    return b.failed ? 1 : 0;
+}
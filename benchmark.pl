@@ -1,20 +1,25 @@
 #!/usr/bin/perl
 
-# Process the raw output from benchmark.sh into Javascript-ified HTML.
+# Process the JSON output from the benchmark program into
+# Javascript-ified HTML.
 
 use strict;
 use warnings;
+use JSON::PP;
 
 my @presets = ();
 my %presets = ();
 my $maxval = 0;
 
-while (<>) {
-    chomp;
-    if (/^(.*)(#.*): ([\d\.]+)$/) {
-        push @presets, $1 unless defined $presets{$1};
-        push @{$presets{$1}}, $3;
-        $maxval = $3 if $maxval < $3;
+my $json = do { local $/; <> };
+my $data = JSON::PP->new->decode($json);
+
+for my $p (@{$data->{presets}}) {
+    my $name = "$p->{game} $p->{params}";
+    push @presets, $name unless defined $presets{$name};
+    for my $t (@{$p->{cpu}->{samples}}) {
+        push @{$presets{$name}}, $t;
+        $maxval = $t if $maxval < $t;
     }
 }
 
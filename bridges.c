@@ -133,8 +133,8 @@ struct game_params {
 typedef unsigned int grid_type; /* change me later if we invent > 16 bits of flags. */
 
 struct solver_state {
-    int *dsf, *comptspaces;
-    int *tmpdsf, *tmpcompspaces;
+    rdsf *dsf;
+    int *comptspaces, *tmpcompspaces;
     int refcount;
 };
 
@@ -1128,13 +1128,13 @@ static int map_hasloops(game_state *state, int mark)
 
 static void map_group(game_state *state)
 {
-    int i, wh = state->w*state->h, d1, d2;
+    int i, d1, d2;
     int x, y, x2, y2;
-    int *dsf = state->solver->dsf;
+    rdsf *dsf = state->solver->dsf;
     struct island *is, *is_join;
 
     /* Initialise dsf. */
-    dsf_init(dsf, wh);
+    rdsf_reset(dsf);
 
     /* For each island, find connected islands right or down
      * and merge the dsf for the island squares as well as the
@@ -1155,7 +1155,8 @@ static void map_group(game_state *state)
                 if (!is_join) continue;
 
                 d2 = DINDEX(is_join->x, is_join->y);
-                if (dsf_canonify(dsf,d1) == dsf_canonify(dsf,d2)) {
+                if (rdsf_canonify(dsf, d1, NULL) ==
+                    rdsf_canonify(dsf, d2, NULL)) {
                     ; /* we have a loop. See comment in map_hasloops. */
                     /* However, we still want to merge all squares joining
                      * this side-that-makes-a-loop. */
@@ -1164,7 +1165,7 @@ static void map_group(game_state *state)
                 for (x2 = x; x2 <= is_join->x; x2++) {
                     for (y2 = y; y2 <= is_join->y; y2++) {
                         d2 = DINDEX(x2,y2);
-                        if (d1 != d2) dsf_merge(dsf,d1,d2);
+                        if (d1 != d2) rdsf_merge(dsf,d1,d2,FALSE);
                     }
                 }
             }
@@ -1175,13 +1176,14 @@ static void map_group(game_state *state)
 static int map_group_check(game_state *state, int canon, int warn,
                            int *nislands_r)
 {
-    int *dsf = state->solver->dsf, nislands = 0;
+    rdsf *dsf = state->solver->dsf;
+    int nislands = 0;
     int x, y, i, allfull = 1;
     struct island *is;
 
     for (i = 0; i < state->n_islands; i++) {
         is = &state->islands[i];
-        if (dsf_canonify(dsf, DINDEX(is->x,is->y)) != canon) continue;
+        if (rdsf_canonify(dsf, DINDEX(is->x,is->y), NULL) != canon) continue;
 
         GRID(state, is->x, is->y) |= G_SWEEP;
         nislands++;
@@ -1193,7 +1195,7 @@ static int map_group_check(game_state *state, int canon, int warn,
          * Mark all squares with this dsf canon as ERR. */
         for (x = 0; x < state->w; x++) {
             for (y = 0; y < state->h; y++) {
-                if (dsf_canonify(dsf, DINDEX(x,y)) == canon) {
+                if (rdsf_canonify(dsf, DINDEX(x,y), NULL) == canon) {
                     GRID(state,x,y) |= G_WARN;
                 }
             }
@@ -1206,7 +1208,8 @@ static int map_group_check(game_state *state, int canon, int warn,
 
 static int map_group_full(game_state *state, int *ngroups_r)
 {
-    int *dsf = state->solver->dsf, ngroups = 0;
+    rdsf *dsf = state->solver->dsf;
+    int ngroups = 0;
     int i, anyfull = 0;
     struct island *is;
 
@@ -1217,7 +1220,8 @@ static int map_group_full(game_state *state, int *ngroups_r)
         if (GRID(state,is->x,is->y) & G_SWEEP) continue;
 
         ngroups++;
-        if (map_group_check(state, dsf_canonify(dsf, DINDEX(is->x,is->y)),
+        if (map_group_check(state,
+                            rdsf_canonify(dsf, DINDEX(is->x,is->y), NULL),
                             1, NULL))
             anyfull = 1;
     }
@@ -1260,7 +1264,8 @@ static void map_clear(game_state *state)
 static void solve_join(struct island *is, int direction, int n, int is_max)
 {
     struct island *is_orth;
-    int d1, d2, *dsf = is->state->solver->dsf;
+    rdsf *dsf = is->state->solver->dsf;
+    int d1, d2;
     game_state *state = is->state; /* for DINDEX */
 
     is_orth = INDEX(is->state, gridi,
@@ -1274,8 +1279,7 @@ static void solve_join(struct island *is, int direction, int n, int is_max)
     if (n > 0 && !is_max) {
         d1 = DINDEX(is->x, is->y);
         d2 = DINDEX(is_orth->x, is_orth->y);
-        if (dsf_canonify(dsf, d1) != dsf_canonify(dsf, d2))
-            dsf_merge(dsf, d1, d2);
+        rdsf_merge(dsf, d1, d2, FALSE);
     }
 }
 
@@ -1375,7 +1379,8 @@ static int solve_island_stage1(struct island *is, int *didsth_r)
 static int solve_island_checkloop(struct island *is, int direction)
 {
     struct island *is_orth;
-    int *dsf = is->state->solver->dsf, d1, d2;
+    rdsf *dsf = is->state->solver->dsf;
+    int d1, d2;
     game_state *state = is->state;
 
     if (is->state->allowloops) return 0; /* don't care anyway */
@@ -1389,7 +1394,7 @@ static int solve_island_checkloop(struct island *is, int direction)
 
     d1 = DINDEX(is->x, is->y);
     d2 = DINDEX(is_orth->x, is_orth->y);
-    if (dsf_canonify(dsf, d1) == dsf_canonify(dsf, d2)) {
+    if (rdsf_canonify(dsf, d1, NULL) == rdsf_canonify(dsf, d2, NULL)) {
         /* two islands are connected already; don't join them. */
         return 1;
     }
@@ -1446,7 +1451,8 @@ static int solve_island_stage2(struct island *is, int *didsth_r)
 static int solve_island_subgroup(struct island *is, int direction)
 {
     struct island *is_join;
-    int nislands, *dsf = is->state->solver->dsf;
+    rdsf *dsf = is->state->solver->dsf;
+    int nislands;
     game_state *state = is->state;
 
     debug(("..checking subgroups.\n"));
@@ -1472,7 +1478,8 @@ static int solve_island_subgroup(struct island *is, int direction)
     }
 
     /* Check group membership for is->dsf; if it's full return 1. */
-    if (map_group_check(state, dsf_canonify(dsf, DINDEX(is->x,is->y)),
+    if (map_group_check(state,
+                        rdsf_canonify(dsf, DINDEX(is->x,is->y), NULL),
                         0, &nislands)) {
         if (nislands < state->n_islands) {
             /* we have a full subgroup that isn't the whole set.
@@ -1508,7 +1515,7 @@ static int solve_island_impossible(game_state *state)
 static int solve_island_stage3(struct island *is, int *didsth_r)
 {
     int i, n, x, y, missing, spc, curr, maxb, didsth = 0;
-    int wh = is->state->w * is->state->h;
+    int checkpoint;
     struct solver_state *ss = is->state->solver;
 
     assert(didsth_r);
@@ -1530,9 +1537,9 @@ static int solve_island_stage3(struct island *is, int *didsth_r)
         /* Now we know that this island could have more bridges,
          * to bring the total from curr+1 to curr+spc. */
         maxb = -1;
-        /* We have to squirrel the dsf away and restore it afterwards;
-         * it is additive only, and can't be removed from. */
-        memcpy(ss->tmpdsf, ss->dsf, wh*sizeof(int));
+        /* Removing bridges doesn't split the dsf back up, so we have
+         * to roll it back to here afterwards. */
+        checkpoint = rdsf_checkpoint(ss->dsf);
         for (n = curr+1; n <= curr+spc; n++) {
             solve_join(is, i, n, 0);
             map_update_possibles(is->state);
@@ -1548,7 +1555,7 @@ static int solve_island_stage3(struct island *is, int *didsth_r)
             }
         }
         solve_join(is, i, curr, 0); /* put back to before. */
-        memcpy(ss->dsf, ss->tmpdsf, wh*sizeof(int));
+        rdsf_rollback(ss->dsf, checkpoint);
 
         if (maxb != -1) {
             /*debug_state(is->state);*/
@@ -1617,7 +1624,7 @@ static int solve_island_stage3(struct island *is, int *didsth_r)
                                   is->adj.points[j].dx ? G_LINEH : G_LINEV);
         if (before[i] != 0) continue;  /* this idea is pointless otherwise */
 
-        memcpy(ss->tmpdsf, ss->dsf, wh*sizeof(int));
+        checkpoint = rdsf_checkpoint(ss->dsf);
 
         for (j = 0; j < is->adj.npoints; j++) {
             spc = island_adjspace(is, 1, missing, j);
@@ -1632,7 +1639,7 @@ static int solve_island_stage3(struct island *is, int *didsth_r)
 
         for (j = 0; j < is->adj.npoints; j++)
             solve_join(is, j, before[j], 0);
-        memcpy(ss->dsf, ss->tmpdsf, wh*sizeof(int));
+        rdsf_rollback(ss->dsf, checkpoint);
 
         if (got) {
             debug(("island at (%d,%d) must connect in direction (%d,%d) to"
@@ -1750,8 +1757,7 @@ static game_state *new_state(const game_params *params)
     ret->solved = ret->completed = 0;
 
     ret->solver = snew(struct solver_state);
-    ret->solver->dsf = snew_dsf(wh);
-    ret->solver->tmpdsf = snewn(wh, int);
+    ret->solver->dsf = rdsf_new(wh);
 
     ret->solver->refcount = 1;
 
@@ -1800,8 +1806,7 @@ static game_state *dup_game(const game_state *state)
 static void free_game(game_state *state)
 {
     if (--state->solver->refcount <= 0) {
-        sfree(state->solver->dsf);
-        sfree(state->solver->tmpdsf);
+        rdsf_free(state->solver->dsf);
         sfree(state->solver);
     }
 
@@ -3232,6 +3237,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     TRUE, solve_game,
     TRUE, game_can_format_as_text_now, game_text_format,
     new_ui,
@@ -0,0 +1,37 @@
+/*
+ * cputime.c: the user CPU time used by the calling thread, for the
+ * GTK front end's '--time-generation', where '--jobs' may have several
+ * threads generating puzzles at once.
+ */
+
+/*
+ * For RUSAGE_THREAD, which -ansi would otherwise hide. It's kept to
+ * this file so that nothing else is compiled with the GNU extensions.
+ */
+#define _GNU_SOURCE
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "puzzles.h"
+
+/*
+ * With several threads running at once, RUSAGE_SELF would charge
+ * each one with everybody's CPU time, so use the per-thread figure
+ * where the OS provides one.
+ */
+#ifdef RUSAGE_THREAD
+#define CPUTIME_RUSAGE RUSAGE_THREAD
+const int thread_cpu_time_is_per_thread = TRUE;
+#else
+#define CPUTIME_RUSAGE RUSAGE_SELF
+const int thread_cpu_time_is_per_thread = FALSE;
+#endif
+
+double thread_cpu_time(void)
+{
+    struct rusage ru;
+
+    getrusage(CPUTIME_RUSAGE, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0;
+}
@@ -207,6 +207,12 @@ struct game_grid {
 #define GET_SQUARE(state, i) \
     (((state)->bluemask[(i)/32] >> ((i)%32)) & 1)
 
+/*
+ * The rolls made by a Solve are kept in the state's solve_path so
+ * that it can be animated, each as the same direction letter as an
+ * ordinary move.
+ */
+
 struct game_state {
     struct game_params params;
     const struct solid *solid;
@@ -221,7 +227,9 @@ struct game_state {
     int previous;
     float angle;
     int completed;
+    int used_solve;
     int movecount;
+    solve_path *soln;
 };
 
 static game_params *default_params(void)
@@ -952,7 +960,9 @@ static game_state *new_game(midend *me, const game_params *params,
     state->previous = state->current;
     state->angle = 0.0;
     state->completed = 0;
+    state->used_solve = FALSE;
     state->movecount = 0;
+    state->soln = NULL;
 
     return state;
 }
@@ -983,13 +993,16 @@ static game_state *dup_game(const game_state *state)
     ret->previous = state->previous;
     ret->angle = state->angle;
     ret->completed = state->completed;
+    ret->used_solve = state->used_solve;
     ret->movecount = state->movecount;
+    ret->soln = solve_path_ref(state->soln);
 
     return ret;
 }
 
 static void free_game(game_state *state)
 {
+    solve_path_free(state->soln);
     if (--state->grid->refcount <= 0) {
 	sfree(state->grid->squares);
 	sfree(state->grid);
@@ -999,10 +1012,577 @@ static void free_game(game_state *state)
     sfree(state);
 }
 
+/* ----------------------------------------------------------------------
+ * Solver.
+ *
+ * This is an A* search for the shortest sequence of rolls. The
+ * position is completely described by which grid square the solid
+ * is on, which of its faces are blue and which grid squares are
+ * blue, since we always keep the solid in its standard orientation
+ * and let the face colours move round instead. Each position is
+ * packed into a short string of bytes as a key into a hash table of
+ * the positions seen so far.
+ *
+ * A blue square can only be picked up by landing on it, which
+ * gives us a lower bound on the rolls still needed, described in
+ * solver_estimate. That bound can drop by more than one in a
+ * single roll, so we never let a position's estimate fall more than
+ * one below its parent's, which keeps it a lower bound and means
+ * the queue is taken in order of increasing total. The first
+ * solution we take off the queue is therefore a shortest one.
+ *
+ * That's only practical while there are few enough blue squares:
+ * an icosahedron has twenty to pick up and needs eighty-odd rolls.
+ * So each search is limited to SOLVE_MAX_STATES positions, and if
+ * it runs out we search again with the estimate multiplied by 4,
+ * then 16, and so on up to SOLVE_MAX_WEIGHT. A weighted search
+ * heads much more directly for a solution, but it's no longer
+ * guaranteed to be a shortest one.
+ */
+
+#define SOLVE_MAX_STATES 500000
+#define SOLVE_MAX_WEIGHT 256
+#define SOLVE_MAX_PICKUP 4194304       /* entries in solver->pickup */
+
+/*
+ * Key layout: two bytes of current square, three of face colours,
+ * then one bit per grid square.
+ */
+#define KEY_FACES 2
+#define KEY_GRID 5
+
+static const char solve_dirchars[] = "LRUD";
+
+struct solver {
+    int nsquares, nfaces, bottom, keylen;
+    int *dest;			       /* dest[4*sq+dir], or -1 if none */
+    /*
+     * For each roll, the face whose colour each face ends up with:
+     * face i gets the colour of face perm[nfaces*(4*sq+dir)+i].
+     */
+    unsigned char *perm;
+    int *dist;			       /* rolls from one square to another */
+    int *pickup;		       /* see solver_new; may be NULL */
+    int *mst;			       /* scratch space for solver_estimate */
+
+    unsigned char *keys;
+    int *parent, *g, *h;
+    unsigned char *move;
+    int nstates, statesize;
+    int *hash, hashsize;
+
+    int weight;			       /* how much the estimate counts */
+    int **queue, *queuelen, *queuesize;   /* a stack for each f */
+    int nqueues, lowest;
+};
+
+static game_state *execute_move(const game_state *from, const char *move);
+
+static struct solver *solver_new(const game_state *state)
+{
+    struct solver *s = snew(struct solver);
+    game_state *probe = dup_game(state);
+    int n = state->grid->nsquares, nf = state->solid->nfaces;
+    int *todo, i, j, head, tail;
+    char move[2];
+
+    s->nsquares = n;
+    s->nfaces = nf;
+    s->bottom = lowest_face(state->solid);
+    s->keylen = KEY_GRID + (n + 7) / 8;
+
+    /*
+     * Work out where each roll goes and how it moves the faces
+     * round, by making it in a state whose face `colours' are the
+     * faces' own indices. Marking it as completed stops any colours
+     * being swapped with the grid.
+     */
+    s->dest = snewn(4 * n, int);
+    s->perm = snewn(4 * n * nf, unsigned char);
+    probe->completed = 1;
+    for (i = 0; i < nf; i++)
+	probe->facecolours[i] = i;
+    move[1] = '\0';
+    for (i = 0; i < 4 * n; i++) {
+	game_state *ret;
+
+	probe->current = i / 4;
+	move[0] = solve_dirchars[i % 4];
+	ret = execute_move(probe, move);
+	s->dest[i] = (ret ? ret->current : -1);
+	for (j = 0; j < nf; j++)
+	    s->perm[i*nf+j] = (ret ? ret->facecolours[j] : j);
+	if (ret)
+	    free_game(ret);
+    }
+    free_game(probe);
+
+    /*
+     * Breadth-first search from each square for the distances.
+     */
+    s->dist = snewn(n * n, int);
+    todo = snewn(n, int);
+    for (i = 0; i < n; i++) {
+	int *d = s->dist + i*n;
+
+	for (j = 0; j < n; j++)
+	    d[j] = -1;
+	d[i] = 0;
+	todo[0] = i;
+	head = 0;
+	tail = 1;
+	while (head < tail) {
+	    int sq = todo[head++];
+	    for (j = 0; j < 4; j++) {
+		int t = s->dest[4*sq+j];
+		if (t >= 0 && d[t] < 0) {
+		    d[t] = d[sq] + 1;
+		    todo[tail++] = t;
+		}
+	    }
+	}
+    }
+    sfree(todo);
+
+    /*
+     * Picking up a blue square needs the solid to land on it with a
+     * non-blue face underneath, which can take a lot more rolls than
+     * just getting there. So for each square sq and face i we find
+     * the fewest rolls (at least one) that take the colour on face i
+     * to the bottom of the solid as it lands on square b, as
+     * pickup[(sq*nf+i)*n+b], or 0 if it never gets there. That's a
+     * breadth-first search from every (sq, i) pair, following the
+     * colour round, so we only do it if the table isn't too big.
+     */
+    s->pickup = NULL;
+    if ((double)n * n * nf <= SOLVE_MAX_PICKUP) {
+	int np = n * nf, *next = snewn(4 * np, int), *d = snewn(np, int);
+	int p, q;
+
+	/* next[4*p+dir] is where a roll takes the pair p = sq*nf+i. */
+	for (i = 0; i < 4 * n; i++)
+	    for (j = 0; j < nf; j++) {
+		p = (i / 4) * nf + s->perm[i*nf+j];
+		next[4*p + i%4] = (s->dest[i] < 0 ? -1 : s->dest[i] * nf + j);
+	    }
+
+	s->pickup = snewn(n * np, int);
+	todo = snewn(np, int);
+	for (p = 0; p < np; p++) {
+	    for (q = 0; q < np; q++)
+		d[q] = -1;
+	    head = tail = 0;
+	    for (j = 0; j < 4; j++) {
+		q = next[4*p+j];
+		if (q >= 0 && d[q] < 0) {
+		    d[q] = 1;
+		    todo[tail++] = q;
+		}
+	    }
+	    while (head < tail) {
+		int from = todo[head++];
+		for (j = 0; j < 4; j++) {
+		    q = next[4*from+j];
+		    if (q >= 0 && d[q] < 0) {
+			d[q] = d[from] + 1;
+			todo[tail++] = q;
+		    }
+		}
+	    }
+	    for (i = 0; i < n; i++)
+		s->pickup[p * n + i] = max(d[i * nf + s->bottom], 0);
+	}
+	sfree(todo);
+	sfree(next);
+	sfree(d);
+    }
+
+    s->mst = snewn(2 * (n + 1), int);
+
+    s->nstates = 0;
+    s->statesize = 1024;
+    s->keys = snewn(s->statesize * s->keylen, unsigned char);
+    s->parent = snewn(s->statesize, int);
+    s->g = snewn(s->statesize, int);
+    s->h = snewn(s->statesize, int);
+    s->move = snewn(s->statesize, unsigned char);
+    s->hashsize = 4096;
+    s->hash = snewn(s->hashsize, int);
+    s->nqueues = 0;
+    s->queue = NULL;
+    s->queuelen = s->queuesize = NULL;
+
+    return s;
+}
+
+static void solver_free(struct solver *s)
+{
+    int i;
+
+    for (i = 0; i < s->nqueues; i++)
+	sfree(s->queue[i]);
+    sfree(s->queue);
+    sfree(s->queuelen);
+    sfree(s->queuesize);
+    sfree(s->keys);
+    sfree(s->parent);
+    sfree(s->g);
+    sfree(s->h);
+    sfree(s->move);
+    sfree(s->hash);
+    sfree(s->dest);
+    sfree(s->perm);
+    sfree(s->dist);
+    sfree(s->pickup);
+    sfree(s->mst);
+    sfree(s);
+}
+
+#define KEY_SQUARE(k) ((k)[0] | ((k)[1] << 8))
+#define KEY_BLUE(k, i) (((k)[KEY_GRID + (i)/8] >> ((i)%8)) & 1)
+
+static unsigned long key_faces(const unsigned char *key)
+{
+    return (key[KEY_FACES] | ((unsigned long)key[KEY_FACES+1] << 8) |
+	    ((unsigned long)key[KEY_FACES+2] << 16));
+}
+
+static void key_set_faces(unsigned char *key, unsigned long faces)
+{
+    key[KEY_FACES] = (unsigned char)(faces & 0xFF);
+    key[KEY_FACES+1] = (unsigned char)((faces >> 8) & 0xFF);
+    key[KEY_FACES+2] = (unsigned char)((faces >> 16) & 0xFF);
+}
+
+static int solver_estimate(struct solver *s, const unsigned char *key)
+{
+    int *sq = s->mst, *best = s->mst + s->nsquares + 1;
+    int i, j, n, nblue, tree, added, first;
+
+    /*
+     * Any route from here that lands on every blue square is at
+     * least as long as a minimum spanning tree of the current square
+     * and the blue ones, which we find by Prim's algorithm. It must
+     * also take at least one roll per blue square, which is more if
+     * the solid is sitting on one.
+     */
+    n = nblue = 0;
+    sq[n++] = KEY_SQUARE(key);
+    for (i = 0; i < s->nsquares; i++)
+	if (KEY_BLUE(key, i)) {
+	    nblue++;
+	    if (i != sq[0])
+		sq[n++] = i;
+	}
+
+    /*
+     * Picking up the first of them may take more rolls than getting
+     * to it, because the solid has to land on it with a non-blue
+     * face underneath.
+     */
+    first = 0;
+    if (s->pickup && nblue > 0) {
+	unsigned long faces = key_faces(key);
+	int f, d;
+
+	first = -1;
+	for (f = 0; f < s->nfaces; f++) {
+	    const int *p = s->pickup + (sq[0] * s->nfaces + f) * s->nsquares;
+
+	    if (faces & (1UL << f))
+		continue;
+	    for (i = (KEY_BLUE(key, sq[0]) ? 0 : 1); i < n; i++) {
+		d = p[sq[i]];
+		if (first < 0 || first > d)
+		    first = d;
+	    }
+	}
+	first = max(first, 0);
+    }
+    for (i = 1; i < n; i++)
+	best[i] = s->dist[sq[0] * s->nsquares + sq[i]];
+    tree = 0;
+    while (n > 1) {
+	for (j = 1, i = 2; i < n; i++)
+	    if (best[i] < best[j])
+		j = i;
+	tree += best[j];
+	added = sq[j];
+	sq[j] = sq[--n];
+	best[j] = best[n];
+	for (i = 1; i < n; i++)
+	    best[i] = min(best[i], s->dist[added * s->nsquares + sq[i]]);
+    }
+
+    return max(max(nblue, tree), first);
+}
+
+/*
+ * Make a roll from the position in `key', writing the result into
+ * `out'. Returns FALSE if there's no square in that direction.
+ */
+static int solver_roll(const struct solver *s, const unsigned char *key,
+		       int dir, unsigned char *out)
+{
+    int sq = KEY_SQUARE(key), roll = 4 * sq + dir, dest = s->dest[roll];
+    const unsigned char *perm = s->perm + roll * s->nfaces;
+    unsigned long faces = key_faces(key), newfaces = 0;
+    int i, b;
+
+    if (dest < 0)
+	return FALSE;
+
+    for (i = 0; i < s->nfaces; i++)
+	if (faces & (1UL << perm[i]))
+	    newfaces |= 1UL << i;
+
+    memcpy(out, key, s->keylen);
+    out[0] = dest & 0xFF;
+    out[1] = (dest >> 8) & 0xFF;
+
+    /* Swap the colours of the bottom face and the square it's on. */
+    b = (newfaces >> s->bottom) & 1;
+    newfaces &= ~(1UL << s->bottom);
+    if (KEY_BLUE(key, dest))
+	newfaces |= 1UL << s->bottom;
+    out[KEY_GRID + dest/8] &= ~(1 << (dest%8));
+    out[KEY_GRID + dest/8] |= b << (dest%8);
+    key_set_faces(out, newfaces);
+
+    return TRUE;
+}
+
+static int solver_hash(const struct solver *s, const unsigned char *key)
+{
+    unsigned long hash = 2166136261UL;
+    int i;
+
+    for (i = 0; i < s->keylen; i++)
+	hash = ((hash ^ key[i]) * 16777619UL) & 0xFFFFFFFFUL;
+    return (int)((hash ^ (hash >> 15)) & (s->hashsize - 1));
+}
+
+static int solver_lookup(const struct solver *s, const unsigned char *key,
+			 int *slot)
+{
+    int h = solver_hash(s, key);
+
+    while (s->hash[h] >= 0) {
+	if (!memcmp(s->keys + s->hash[h] * s->keylen, key, s->keylen))
+	    return s->hash[h];
+	h = (h + 1) & (s->hashsize - 1);
+    }
+    *slot = h;
+    return -1;
+}
+
+#define SOLVER_F(s, i) ((s)->g[i] + (s)->weight * (s)->h[i])
+
+static void solver_push(struct solver *s, int i)
+{
+    int f = SOLVER_F(s, i);
+
+    if (f >= s->nqueues) {
+	int newn = f + 16, j;
+	s->queue = sresize(s->queue, newn, int *);
+	s->queuelen = sresize(s->queuelen, newn, int);
+	s->queuesize = sresize(s->queuesize, newn, int);
+	for (j = s->nqueues; j < newn; j++) {
+	    s->queue[j] = NULL;
+	    s->queuelen[j] = s->queuesize[j] = 0;
+	}
+	s->nqueues = newn;
+    }
+    if (s->queuelen[f] >= s->queuesize[f]) {
+	s->queuesize[f] = s->queuelen[f] * 3 / 2 + 64;
+	s->queue[f] = sresize(s->queue[f], s->queuesize[f], int);
+    }
+    s->queue[f][s->queuelen[f]++] = i;
+    if (s->lowest > f)
+	s->lowest = f;
+}
+
+static int solver_add(struct solver *s, const unsigned char *key, int slot,
+		      int parent, int move, int g)
+{
+    int i = s->nstates++;
+
+    if (i >= s->statesize) {
+	s->statesize = s->statesize * 3 / 2 + 1024;
+	s->keys = sresize(s->keys, s->statesize * s->keylen, unsigned char);
+	s->parent = sresize(s->parent, s->statesize, int);
+	s->g = sresize(s->g, s->statesize, int);
+	s->h = sresize(s->h, s->statesize, int);
+	s->move = sresize(s->move, s->statesize, unsigned char);
+    }
+    memcpy(s->keys + i * s->keylen, key, s->keylen);
+    s->parent[i] = parent;
+    s->move[i] = move;
+    s->g[i] = g;
+    s->h[i] = solver_estimate(s, key);
+    if (parent >= 0 && s->h[i] < s->h[parent] - 1)
+	s->h[i] = s->h[parent] - 1;
+    s->hash[slot] = i;
+
+    /* Keep the hash table no more than half full. */
+    if (2 * s->nstates > s->hashsize) {
+	int j, k;
+	sfree(s->hash);
+	s->hashsize *= 2;
+	s->hash = snewn(s->hashsize, int);
+	for (j = 0; j < s->hashsize; j++)
+	    s->hash[j] = -1;
+	for (j = 0; j < s->nstates; j++) {
+	    solver_lookup(s, s->keys + j * s->keylen, &k);
+	    s->hash[k] = j;
+	}
+    }
+
+    solver_push(s, i);
+    return i;
+}
+
+/*
+ * Search from the position in `key' with the estimate multiplied
+ * by `weight'. Returns the solution as a string of direction
+ * letters, or NULL if there isn't one, or if the search ran out of
+ * budget, in which case *giveup is set.
+ */
+static char *solver_search(struct solver *s, const unsigned char *start,
+			   int weight, int *giveup)
+{
+    unsigned char *key = snewn(s->keylen, unsigned char);
+    unsigned char *child = snewn(s->keylen, unsigned char);
+    char *ret = NULL;
+    int i, j, k, slot;
+
+    s->nstates = 0;
+    for (i = 0; i < s->hashsize; i++)
+	s->hash[i] = -1;
+    for (i = 0; i < s->nqueues; i++)
+	s->queuelen[i] = 0;
+    s->lowest = 0;
+    s->weight = weight;
+    *giveup = FALSE;
+
+    solver_lookup(s, start, &slot);
+    solver_add(s, start, slot, -1, 0, 0);
+
+    while (!ret && !*giveup) {
+	while (s->lowest < s->nqueues && s->queuelen[s->lowest] == 0)
+	    s->lowest++;
+	if (s->lowest == s->nqueues)
+	    break;		       /* nothing left to try */
+	i = s->queue[s->lowest][--s->queuelen[s->lowest]];
+	if (SOLVER_F(s, i) != s->lowest)
+	    continue;		       /* superseded by a shorter route */
+
+	if (s->h[i] == 0) {
+	    /*
+	     * No blue squares left on the grid, so the solid is all
+	     * blue. Read off the moves that got us here.
+	     */
+	    ret = snewn(s->g[i] + 1, char);
+	    ret[s->g[i]] = '\0';
+	    for (j = i; s->parent[j] >= 0; j = s->parent[j])
+		ret[s->g[j] - 1] = solve_dirchars[s->move[j]];
+	    break;
+	}
+
+	memcpy(key, s->keys + i * s->keylen, s->keylen);
+	for (j = 0; j < 4; j++) {
+	    if (!solver_roll(s, key, j, child))
+		continue;
+	    k = solver_lookup(s, child, &slot);
+	    if (k < 0) {
+		if (s->nstates >= SOLVE_MAX_STATES) {
+		    *giveup = TRUE;
+		    break;
+		}
+		solver_add(s, child, slot, i, j, s->g[i] + 1);
+	    } else if (s->g[k] > s->g[i] + 1) {
+		s->g[k] = s->g[i] + 1;
+		if (s->h[k] < s->h[i] - 1)
+		    s->h[k] = s->h[i] - 1;
+		s->parent[k] = i;
+		s->move[k] = j;
+		solver_push(s, k);
+	    }
+	}
+    }
+
+    sfree(key);
+    sfree(child);
+    return ret;
+}
+
+/*
+ * Find a solution from the given state: a shortest one if we can,
+ * or failing that one found by trusting the estimate more heavily,
+ * which gets there much faster but not always by the shortest
+ * route. Returns it as a string of direction letters, or NULL with
+ * *error set.
+ */
+static char *solve_cube(const game_state *state, const char **error)
+{
+    struct solver *s;
+    unsigned char *key;
+    unsigned long faces;
+    char *ret = NULL;
+    int i, weight, giveup;
+
+    if (state->grid->nsquares > 65536 || state->solid->nfaces > 24) {
+	*error = "Puzzle is too large to solve automatically";
+	return NULL;
+    }
+
+    s = solver_new(state);
+    key = snewn(s->keylen, unsigned char);
+    memset(key, 0, s->keylen);
+    key[0] = state->current & 0xFF;
+    key[1] = (state->current >> 8) & 0xFF;
+    faces = 0;
+    for (i = 0; i < s->nfaces; i++)
+	if (state->facecolours[i])
+	    faces |= 1UL << i;
+    key_set_faces(key, faces);
+    for (i = 0; i < s->nsquares; i++)
+	if (GET_SQUARE(state, i))
+	    key[KEY_GRID + i/8] |= 1 << (i%8);
+
+    for (weight = 1; weight <= SOLVE_MAX_WEIGHT; weight *= 4) {
+	ret = solver_search(s, key, weight, &giveup);
+	if (ret || !giveup)
+	    break;
+    }
+    if (!ret)
+	*error = (giveup ?
+		  "This puzzle is too difficult to solve automatically" :
+		  "No solution exists for this puzzle");
+
+    sfree(key);
+    solver_free(s);
+    return ret;
+}
+
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *aux, const char **error)
 {
-    return NULL;
+    char *moves, *ret;
+
+    if (currstate->completed) {
+	*error = "Puzzle is already solved";
+	return NULL;
+    }
+
+    moves = solve_cube(currstate, error);
+    if (!moves)
+	return NULL;
+    ret = snewn(strlen(moves) + 2, char);
+    sprintf(ret, "S%s", moves);
+    sfree(moves);
+
+    return ret;
 }
 
 static int game_can_format_as_text_now(const game_params *params)
@@ -1128,7 +1708,21 @@ static char *interpret_move(const game_state *state, game_ui *ui,
         direction = UP_RIGHT;
     else if (button == (MOD_NUM_KEYPAD | '3'))
         direction = DOWN_RIGHT;
-    else if (button == LEFT_BUTTON) {
+    else if ((button == 'h' || button == 'H') && !state->completed) {
+        /*
+         * Make the first roll of the solution Solve would show.
+         */
+        const char *error;
+        char *moves = solve_cube(state, &error), *ret;
+
+        if (!moves)
+            return NULL;
+        ret = snewn(2, char);
+        ret[0] = moves[0];
+        ret[1] = '\0';
+        sfree(moves);
+        return ret;
+    } else if (button == LEFT_BUTTON) {
         /*
          * Find the bearing of the click point from the current
          * square's centre.
@@ -1230,6 +1824,42 @@ static game_state *execute_move(const game_state *from, const char *move)
     int i, j, dest;
     int direction;
 
+    if (*move == 'S') {
+        /*
+         * A Solve move: make each roll in turn, and check that we
+         * end up solved.
+         */
+        game_state *next;
+        char roll[2];
+        solve_path *sol;
+
+        ret = dup_game(from);
+        roll[1] = '\0';
+        for (i = 1; move[i]; i++) {
+            roll[0] = move[i];
+            if (!strchr("LRUD", roll[0]) ||
+                (next = execute_move(ret, roll)) == NULL) {
+                free_game(ret);
+                return NULL;
+            }
+            free_game(ret);
+            ret = next;
+        }
+        if (!ret->completed) {
+            free_game(ret);
+            return NULL;
+        }
+
+        solve_path_free(ret->soln);
+        ret->soln = sol = solve_path_new(i - 1);
+        for (i = 1; move[i]; i++)
+            sol->moves[sol->nmoves++] = move[i];
+        ret->used_solve = TRUE;
+        ret->completed = ret->movecount = 1;
+
+        return ret;
+    }
+
     switch (*move) {
       case 'L': direction = LEFT; break;
       case 'R': direction = RIGHT; break;
@@ -1243,6 +1873,8 @@ static game_state *execute_move(const game_state *from, const char *move)
         return NULL;
 
     ret = dup_game(from);
+    solve_path_free(ret->soln);
+    ret->soln = NULL;
     ret->current = dest;
 
     /*
@@ -1535,6 +2167,52 @@ static void game_free_drawstate(drawing *dr, game_drawstate *ds)
     sfree(ds);
 }
 
+/*
+ * Length of the animation of the move that led to `state'. A Solve
+ * move is animated one roll at a time, each taking at most ROLLTIME,
+ * and all of them together at most SOLVE_ANIM_TIME.
+ */
+static float anim_length(const game_state *state)
+{
+    if (state->soln)
+        return state->soln->nmoves *
+            solve_path_step_time(state->soln, ROLLTIME);
+    return ROLLTIME;
+}
+
+/*
+ * Work out which roll of a Solve move we're part way through, and
+ * make the states either side of it by replaying the rolls from
+ * the start. Returns how far through the roll we are, scaled to
+ * look like the time into an ordinary move.
+ */
+static float solve_anim_step(const game_state *oldstate,
+                             const game_state *state, float animtime,
+                             game_state **from, game_state **to)
+{
+    const solve_path *sol = state->soln;
+    float steptime = solve_path_step_time(sol, ROLLTIME);
+    int step = (int)(animtime / steptime);
+    char roll[2];
+    int i;
+
+    if (step >= sol->nmoves)
+        step = sol->nmoves - 1;
+
+    roll[1] = '\0';
+    *to = dup_game(oldstate);
+    for (i = 0; i <= step; i++) {
+        *from = *to;
+        roll[0] = sol->moves[i];
+        *to = execute_move(*from, roll);
+        assert(*to);
+        if (i < step)
+            free_game(*from);
+    }
+
+    return (animtime - step * steptime) * ROLLTIME / steptime;
+}
+
 static void game_redraw(drawing *dr, game_drawstate *ds,
                         const game_state *oldstate, const game_state *state,
                         int dir, const game_ui *ui,
@@ -1547,6 +2225,7 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
     float t[3];
     float angle;
     int square;
+    game_state *stepfrom = NULL, *stepto = NULL;
 
     draw_rect(dr, 0, 0, XSIZE(GRID_SCALE, bb, state->solid),
 	      YSIZE(GRID_SCALE, bb, state->solid), COL_BACKGROUND);
@@ -1564,7 +2243,14 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
         oldstate = state;
         state = t;
 
-        animtime = ROLLTIME - animtime;
+        animtime = anim_length(state) - animtime;
+    }
+
+    if (oldstate && state->soln) {
+        animtime = solve_anim_step(oldstate, state, animtime,
+                                   &stepfrom, &stepto);
+        oldstate = stepfrom;
+        state = stepto;
     }
 
     if (!oldstate) {
@@ -1688,18 +2374,27 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
     {
 	char statusbuf[256];
 
-	sprintf(statusbuf, "%sMoves: %d",
-		(state->completed ? "COMPLETED! " : ""),
-		(state->completed ? state->completed : state->movecount));
+	if (state->used_solve)
+	    sprintf(statusbuf, "Moves since auto-solve: %d",
+		    state->movecount - state->completed);
+	else
+	    sprintf(statusbuf, "%sMoves: %d",
+		    (state->completed ? "COMPLETED! " : ""),
+		    (state->completed ? state->completed : state->movecount));
 
 	status_bar(dr, statusbuf);
     }
+
+    if (stepfrom) {
+        free_game(stepfrom);
+        free_game(stepto);
+    }
 }
 
 static float game_anim_length(const game_state *oldstate,
                               const game_state *newstate, int dir, game_ui *ui)
 {
-    return ROLLTIME;
+    return anim_length(dir > 0 ? newstate : oldstate);
 }
 
 static float game_flash_length(const game_state *oldstate,
@@ -1745,7 +2440,8 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
-    FALSE, solve_game,
+    NULL, NULL,
+    TRUE, solve_game,
     FALSE, game_can_format_as_text_now, game_text_format,
     new_ui,
     free_ui,
@@ -1765,5 +2461,5 @@ const struct game thegame = {
     FALSE, FALSE, game_print_size, game_print,
     TRUE,			       /* wants_statusbar */
     FALSE, game_timing_state,
-    0,				       /* flags */
+    SOLVE_ANIMATES,		       /* flags */
 };
@@ -190,3 +190,121 @@ void edsf_merge(int *dsf, int v1, int v2, int inverse)
 
 /*    fprintf(stderr, "dsf[%2d] = %2d\n", v2, dsf[v2]); */
 }
+
+/*
+ * Rollback dsf. Merges use union by size, with no path compression,
+ * so that each merge changes exactly one parent pointer and can be
+ * undone by resetting it. Every merge is recorded on a trail, and
+ * rdsf_rollback pops merges off the trail back to a position returned
+ * earlier by rdsf_checkpoint.
+ *
+ * Since each merge joins two classes, there can be at most size-1 of
+ * them on the trail at once, so the trail never needs to grow.
+ */
+struct rdsf {
+    int size;
+    int *parent;     /* (parent << 1) | inverse; a root is its own parent */
+    int *setsize;    /* number of elements in each root's class */
+    int *trail;      /* the non-root side of each merge, oldest first */
+    int ntrail;
+};
+
+rdsf *rdsf_new(int size)
+{
+    rdsf *r = snew(rdsf);
+
+    r->size = size;
+    r->parent = snewn(size, int);
+    r->setsize = snewn(size, int);
+    r->trail = snewn(size, int);
+    rdsf_reset(r);
+
+    return r;
+}
+
+void rdsf_free(rdsf *r)
+{
+    sfree(r->parent);
+    sfree(r->setsize);
+    sfree(r->trail);
+    sfree(r);
+}
+
+void rdsf_reset(rdsf *r)
+{
+    int i;
+
+    for (i = 0; i < r->size; i++) {
+        r->parent[i] = i << 1;
+        r->setsize[i] = 1;
+    }
+    r->ntrail = 0;
+}
+
+int rdsf_canonify(rdsf *r, int index, int *inverse_return)
+{
+    int inverse = 0;
+
+    assert(index >= 0 && index < r->size);
+
+    while ((r->parent[index] >> 1) != index) {
+        inverse ^= r->parent[index] & 1;
+        index = r->parent[index] >> 1;
+    }
+
+    if (inverse_return)
+        *inverse_return = inverse;
+
+    return index;
+}
+
+int rdsf_size(rdsf *r, int index)
+{
+    return r->setsize[rdsf_canonify(r, index, NULL)];
+}
+
+int rdsf_merge(rdsf *r, int v1, int v2, int inverse)
+{
+    int i1, i2;
+
+    v1 = rdsf_canonify(r, v1, &i1);
+    v2 = rdsf_canonify(r, v2, &i2);
+    inverse = !!inverse ^ i1 ^ i2;
+
+    if (v1 == v2) {
+        assert(!inverse);
+        return FALSE;
+    }
+
+    /* Hang the smaller tree off the larger, to keep the trees shallow. */
+    if (r->setsize[v1] < r->setsize[v2]) {
+        int v3 = v1;
+        v1 = v2;
+        v2 = v3;
+    }
+    r->parent[v2] = (v1 << 1) | inverse;
+    r->setsize[v1] += r->setsize[v2];
+
+    assert(r->ntrail < r->size);
+    r->trail[r->ntrail++] = v2;
+
+    return TRUE;
+}
+
+int rdsf_checkpoint(rdsf *r)
+{
+    return r->ntrail;
+}
+
+void rdsf_rollback(rdsf *r, int checkpoint)
+{
+    assert(checkpoint >= 0 && checkpoint <= r->ntrail);
+
+    while (r->ntrail > checkpoint) {
+        int v2 = r->trail[--r->ntrail];
+        int v1 = r->parent[v2] >> 1;
+
+        r->setsize[v1] -= r->setsize[v2];
+        r->parent[v2] = v2 << 1;
+    }
+}
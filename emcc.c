@@ -71,31 +71,15 @@ extern void js_enable_undo_redo(int undo, int redo);
 extern void js_activate_timer();
 extern void js_deactivate_timer();
 extern void js_canvas_start_draw(void);
-extern void js_canvas_draw_update(int x, int y, int w, int h);
 extern void js_canvas_end_draw(void);
-extern void js_canvas_draw_rect(int x, int y, int w, int h,
-                                const char *colour);
-extern void js_canvas_clip_rect(int x, int y, int w, int h);
-extern void js_canvas_unclip(void);
-extern void js_canvas_draw_line(float x1, float y1, float x2, float y2,
-                                int width, const char *colour);
-extern void js_canvas_draw_poly(int *points, int npoints,
-                                const char *fillcolour,
-                                const char *outlinecolour);
-extern void js_canvas_draw_circle(int x, int y, int r,
-                                  const char *fillcolour,
-                                  const char *outlinecolour);
 extern int js_canvas_find_font_midpoint(int height, const char *fontptr);
-extern void js_canvas_draw_text(int x, int y, int halign,
-                                const char *colptr, const char *fontptr,
-                                const char *text);
 extern int js_canvas_new_blitter(int w, int h);
 extern void js_canvas_free_blitter(int id);
-extern void js_canvas_copy_to_blitter(int id, int x, int y, int w, int h);
-extern void js_canvas_copy_from_blitter(int id, int x, int y, int w, int h);
 extern void js_canvas_make_statusbar(void);
 extern void js_canvas_set_statusbar(const char *text);
 extern void js_canvas_set_size(int w, int h);
+extern void js_canvas_draw_batch(int *commands, int ncommands,
+                                 char **colours);
 
 extern void js_dialog_init(const char *title);
 extern void js_dialog_string(int i, const char *title, const char *initvalue);
@@ -367,7 +351,83 @@ static void ids_changed(void *ignored)
  * Implementation of the drawing API by calling Javascript canvas
  * drawing functions. (Well, half of it; the other half is on the JS
  * side.)
+ *
+ * Calls from C into Javascript are expensive enough that a full
+ * redraw of a big puzzle, which can be thousands of primitives, is
+ * noticeably slowed down by them. So the drawing operations between
+ * start_draw and end_draw are not passed across one by one: instead
+ * we encode them into a buffer of 32-bit words, and end_draw hands
+ * the whole buffer to js_canvas_draw_batch() to decode and execute in
+ * one go. Each command is an opcode word followed by its arguments.
+ * Colours are indices into colour_strings (-1 for no fill), strings
+ * are stored inline (as a word count followed by the NUL-terminated
+ * bytes), and line coordinates are stored as floats.
  */
+enum {
+    DRAW_RECT,                         /* x, y, w, h, colour */
+    DRAW_LINE,                         /* float x1,y1,x2,y2,width; colour */
+    DRAW_POLY,                         /* n, fill, outline, 2n coords */
+    DRAW_CIRCLE,                       /* x, y, r, fill, outline */
+    DRAW_TEXT,                         /* x, y, halign, colour, font, text */
+    DRAW_CLIP,                         /* x, y, w, h */
+    DRAW_UNCLIP,
+    DRAW_UPDATE,                       /* x, y, w, h */
+    DRAW_BLITTER_SAVE,                 /* id, x, y, w, h */
+    DRAW_BLITTER_LOAD                  /* id, x, y, w, h */
+};
+
+static int *drawbuf;
+static int drawbuf_len, drawbuf_size;
+
+static void drawbuf_reserve(int n)
+{
+    if (drawbuf_len + n > drawbuf_size) {
+        drawbuf_size = (drawbuf_len + n) * 5 / 4 + 1024;
+        drawbuf = sresize(drawbuf, drawbuf_size, int);
+    }
+}
+
+static void drawbuf_put(int n, ...)
+{
+    va_list ap;
+
+    drawbuf_reserve(n);
+    va_start(ap, n);
+    while (n-- > 0)
+        drawbuf[drawbuf_len++] = va_arg(ap, int);
+    va_end(ap);
+}
+
+static void drawbuf_put_float(float f)
+{
+    drawbuf_reserve(1);
+    memcpy(&drawbuf[drawbuf_len++], &f, sizeof(float));
+}
+
+static void drawbuf_put_string(const char *str)
+{
+    int nwords = (strlen(str) + 1 + sizeof(int) - 1) / sizeof(int);
+
+    drawbuf_reserve(nwords + 1);
+    drawbuf[drawbuf_len++] = nwords;
+    drawbuf[nwords + drawbuf_len - 1] = 0;  /* zero the padding */
+    strcpy((char *)&drawbuf[drawbuf_len], str);
+    drawbuf_len += nwords;
+}
+
+/*
+ * Execute everything buffered so far. Called at end_draw, and
+ * whenever something is about to happen on the JS side which must
+ * not overtake the buffered commands.
+ */
+static void js_flush_draw(void)
+{
+    if (drawbuf_len > 0) {
+        js_canvas_draw_batch(drawbuf, drawbuf_len, colour_strings);
+        drawbuf_len = 0;
+    }
+}
+
 static void js_start_draw(void *handle)
 {
     js_canvas_start_draw();
@@ -375,12 +435,12 @@ static void js_start_draw(void *handle)
 
 static void js_clip(void *handle, int x, int y, int w, int h)
 {
-    js_canvas_clip_rect(x, y, w, h);
+    drawbuf_put(5, DRAW_CLIP, x, y, w, h);
 }
 
 static void js_unclip(void *handle)
 {
-    js_canvas_unclip();
+    drawbuf_put(1, DRAW_UNCLIP);
 }
 
 static void js_draw_text(void *handle, int x, int y, int fonttype,
@@ -403,41 +463,48 @@ static void js_draw_text(void *handle, int x, int y, int fonttype,
     else
         halign = 0;
 
-    js_canvas_draw_text(x, y, halign, colour_strings[colour], fontstyle, text);
+    drawbuf_put(5, DRAW_TEXT, x, y, halign, colour);
+    drawbuf_put_string(fontstyle);
+    drawbuf_put_string(text);
 }
 
 static void js_draw_rect(void *handle, int x, int y, int w, int h, int colour)
 {
-    js_canvas_draw_rect(x, y, w, h, colour_strings[colour]);
-}
-
-static void js_draw_line(void *handle, int x1, int y1, int x2, int y2,
-                         int colour)
-{
-    js_canvas_draw_line(x1, y1, x2, y2, 1, colour_strings[colour]);
+    drawbuf_put(6, DRAW_RECT, x, y, w, h, colour);
 }
 
 static void js_draw_thick_line(void *handle, float thickness,
                                float x1, float y1, float x2, float y2,
                                int colour)
 {
-    js_canvas_draw_line(x1, y1, x2, y2, thickness, colour_strings[colour]);
+    drawbuf_put(1, DRAW_LINE);
+    drawbuf_put_float(x1);
+    drawbuf_put_float(y1);
+    drawbuf_put_float(x2);
+    drawbuf_put_float(y2);
+    drawbuf_put_float(thickness);
+    drawbuf_put(1, colour);
+}
+
+static void js_draw_line(void *handle, int x1, int y1, int x2, int y2,
+                         int colour)
+{
+    js_draw_thick_line(handle, 1, x1, y1, x2, y2, colour);
 }
 
 static void js_draw_poly(void *handle, int *coords, int npoints,
                          int fillcolour, int outlinecolour)
 {
-    js_canvas_draw_poly(coords, npoints,
-                        fillcolour >= 0 ? colour_strings[fillcolour] : NULL,
-                        colour_strings[outlinecolour]);
+    drawbuf_put(4, DRAW_POLY, npoints, fillcolour, outlinecolour);
+    drawbuf_reserve(2 * npoints);
+    memcpy(&drawbuf[drawbuf_len], coords, 2 * npoints * sizeof(int));
+    drawbuf_len += 2 * npoints;
 }
 
 static void js_draw_circle(void *handle, int cx, int cy, int radius,
                            int fillcolour, int outlinecolour)
 {
-    js_canvas_draw_circle(cx, cy, radius,
-                          fillcolour >= 0 ? colour_strings[fillcolour] : NULL,
-                          colour_strings[outlinecolour]);
+    drawbuf_put(6, DRAW_CIRCLE, cx, cy, radius, fillcolour, outlinecolour);
 }
 
 struct blitter {
@@ -456,6 +523,7 @@ static blitter *js_blitter_new(void *handle, int w, int h)
 
 static void js_blitter_free(void *handle, blitter *bl)
 {
+    js_flush_draw();                   /* commands may still refer to it */
     js_canvas_free_blitter(bl->id);
     sfree(bl);
 }
@@ -493,7 +561,7 @@ static void js_blitter_save(void *handle, blitter *bl, int x, int y)
     int w = bl->w, h = bl->h;
     trim_rect(&x, &y, &w, &h);
     if (w > 0 && h > 0)
-        js_canvas_copy_to_blitter(bl->id, x, y, w, h);
+        drawbuf_put(6, DRAW_BLITTER_SAVE, bl->id, x, y, w, h);
 }
 
 static void js_blitter_load(void *handle, blitter *bl, int x, int y)
@@ -501,18 +569,19 @@ static void js_blitter_load(void *handle, blitter *bl, int x, int y)
     int w = bl->w, h = bl->h;
     trim_rect(&x, &y, &w, &h);
     if (w > 0 && h > 0)
-        js_canvas_copy_from_blitter(bl->id, x, y, w, h);
+        drawbuf_put(6, DRAW_BLITTER_LOAD, bl->id, x, y, w, h);
 }
 
 static void js_draw_update(void *handle, int x, int y, int w, int h)
 {
     trim_rect(&x, &y, &w, &h);
     if (w > 0 && h > 0)
-        js_canvas_draw_update(x, y, w, h);
+        drawbuf_put(5, DRAW_UPDATE, x, y, w, h);
 }
 
 static void js_end_draw(void *handle)
 {
+    js_flush_draw();
     js_canvas_end_draw();
 }
 
@@ -513,6 +513,100 @@ mergeInto(LibraryManager.library, {
                       x, y, w, h);
     },
 
+    /*
+     * void js_canvas_draw_batch(int *commands, int ncommands,
+     *                           char **colours);
+     *
+     * Execute a buffer of drawing commands encoded by emcc.c (see the
+     * comment above its drawing API for the format), by calling the
+     * functions above. The C side never calls those directly any
+     * more: crossing into Javascript once per frame rather than once
+     * per primitive saves a lot of time on big puzzles. 'colours' is
+     * the C colour_strings array, which the commands index into.
+     */
+    js_canvas_draw_batch__deps: ['js_canvas_draw_rect',
+                                 'js_canvas_draw_line',
+                                 'js_canvas_draw_poly',
+                                 'js_canvas_draw_circle',
+                                 'js_canvas_draw_text',
+                                 'js_canvas_clip_rect',
+                                 'js_canvas_unclip',
+                                 'js_canvas_draw_update',
+                                 'js_canvas_copy_to_blitter',
+                                 'js_canvas_copy_from_blitter'],
+    js_canvas_draw_batch: function(ptr, n, colours) {
+        var end = ptr + 4*n;
+        var word = function() {
+            var ret = getValue(ptr, 'i32');
+            ptr += 4;
+            return ret;
+        };
+        var flt = function() {
+            var ret = getValue(ptr, 'float');
+            ptr += 4;
+            return ret;
+        };
+        var colour = function() {
+            var c = word();
+            return c < 0 ? 0 : getValue(colours + 4*c, 'i32');
+        };
+        var string = function() {
+            var nwords = word();
+            var ret = ptr;
+            ptr += 4*nwords;
+            return ret;
+        };
+        var x, y, w, h, id, width, npoints, halign, fill, outline, font;
+
+        while (ptr < end) {
+            switch (word()) {
+              case 0:                  /* DRAW_RECT */
+                x = word(); y = word(); w = word(); h = word();
+                _js_canvas_draw_rect(x, y, w, h, colour());
+                break;
+              case 1:                  /* DRAW_LINE */
+                x = flt(); y = flt(); w = flt(); h = flt(); width = flt();
+                _js_canvas_draw_line(x, y, w, h, width, colour());
+                break;
+              case 2:                  /* DRAW_POLY */
+                npoints = word(); fill = colour(); outline = colour();
+                _js_canvas_draw_poly(ptr, npoints, fill, outline);
+                ptr += 8*npoints;
+                break;
+              case 3:                  /* DRAW_CIRCLE */
+                x = word(); y = word(); w = word(); fill = colour();
+                _js_canvas_draw_circle(x, y, w, fill, colour());
+                break;
+              case 4:                  /* DRAW_TEXT */
+                x = word(); y = word(); halign = word(); fill = colour();
+                font = string();
+                _js_canvas_draw_text(x, y, halign, fill, font, string());
+                break;
+              case 5:                  /* DRAW_CLIP */
+                x = word(); y = word(); w = word(); h = word();
+                _js_canvas_clip_rect(x, y, w, h);
+                break;
+              case 6:                  /* DRAW_UNCLIP */
+                _js_canvas_unclip();
+                break;
+              case 7:                  /* DRAW_UPDATE */
+                x = word(); y = word(); w = word(); h = word();
+                _js_canvas_draw_update(x, y, w, h);
+                break;
+              case 8:                  /* DRAW_BLITTER_SAVE */
+                id = word(); x = word(); y = word(); w = word(); h = word();
+                _js_canvas_copy_to_blitter(id, x, y, w, h);
+                break;
+              case 9:                  /* DRAW_BLITTER_LOAD */
+                id = word(); x = word(); y = word(); w = word(); h = word();
+                _js_canvas_copy_from_blitter(id, x, y, w, h);
+                break;
+              default:
+                throw "js_canvas_draw_batch: bad command";
+            }
+        }
+    },
+
     /*
      * void js_canvas_make_statusbar(void);
      * 
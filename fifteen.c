@@ -9,6 +9,10 @@
 #include <ctype.h>
 #include <math.h>
 
+#if defined MIDEND_POOL || defined GENERATE_JOBS
+#include <pthread.h>
+#endif
+
 #include "puzzles.h"
 
 #define PREFERRED_TILE_SIZE 48
@@ -42,6 +46,13 @@ struct game_params {
     int w, h;
 };
 
+/*
+ * The path taken by a Solve move is kept in the state's solve_path
+ * so that it can be animated: `moves' lists the gap position after
+ * each step. It's empty if the Solve simply replaced the grid, in
+ * which case there's no animation at all.
+ */
+
 struct game_state {
     int w, h, n;
     int *tiles;
@@ -49,6 +60,7 @@ struct game_state {
     int completed;
     int used_solve;		       /* used to suppress completion flash */
     int movecount;
+    solve_path *soln;
 };
 
 static game_params *default_params(void)
@@ -351,6 +363,7 @@ static game_state *new_game(midend *me, const game_params *params,
 
     state->completed = state->movecount = 0;
     state->used_solve = FALSE;
+    state->soln = NULL;
 
     return state;
 }
@@ -368,20 +381,482 @@ static game_state *dup_game(const game_state *state)
     ret->completed = state->completed;
     ret->movecount = state->movecount;
     ret->used_solve = state->used_solve;
+    ret->soln = solve_path_ref(state->soln);
 
     return ret;
 }
 
 static void free_game(game_state *state)
 {
+    solve_path_free(state->soln);
     sfree(state->tiles);
     sfree(state);
 }
 
+/*
+ * Move the gap within a tile array from `gap' to `newgap', which must
+ * be in the same row or column, sliding the tiles in between along.
+ */
+static void slide(int *tiles, int w, int gap, int newgap)
+{
+    int up = (newgap % w == gap % w ? (newgap > gap ? w : -w) :
+              (newgap > gap ? 1 : -1));
+    int p;
+
+    for (p = gap; p != newgap; p += up)
+        tiles[p] = tiles[p + up];
+    tiles[newgap] = 0;
+}
+
+/* ----------------------------------------------------------------------
+ * Solver.
+ *
+ * This is IDA* with an additive pattern database heuristic. The tiles
+ * are divided into groups of at most PDB_GROUP, and for each group we
+ * precompute, for every placement of its tiles, the number of moves
+ * of _those_ tiles needed to get them all home, counting moves of
+ * other tiles as free. Each move moves exactly one tile, so the sum
+ * of those over all the groups never overestimates the distance to
+ * the solution, and the first solution IDA* finds is a shortest one.
+ *
+ * On a square grid, reflecting a position in the leading diagonal
+ * gives another position exactly as far from the solution, so we
+ * look that up too and take whichever estimate is larger.
+ *
+ * A placement is indexed by packing the positions of the group's
+ * tiles into 4 bits each, so this only works for grids of up to 16
+ * squares. Bigger grids, and any search which runs over its node
+ * budget, are solved by following the hint algorithm instead, which
+ * gives a real sequence of moves, just not a shortest one.
+ */
+
+#define PDB_GROUP 5
+#define PDB_MAXCELLS 16
+#define SOLVE_MAX_NODES 50000000L
+
+/*
+ * Other grids just split the tiles into runs in reading order, but
+ * for the standard 4x4 one an L-shaped partition makes the search
+ * several times faster, mostly because its reflection is a
+ * different partition.
+ */
+static const int pdb_groups_4x4[] = {
+    1, 5, 6, 9, 13, 0,
+    2, 3, 4, 7, 8, 0,
+    10, 11, 12, 14, 15, 0,
+};
+
+struct pdb {
+    int w, h, n;
+    unsigned left, right;              /* squares on each edge */
+    int ngroups;
+    int group[PDB_MAXCELLS], shift[PDB_MAXCELLS];   /* indexed by tile */
+    unsigned char *table[PDB_MAXCELLS];
+};
+
+/*
+ * The databases take a noticeable fraction of a second to build, so
+ * we keep the ones for each grid size around for next time. There
+ * are only a few sizes small enough to have them, and they're never
+ * freed, since a solver on another thread may be using them. (In
+ * builds with the threaded code, several puzzles can be generated or
+ * solved at once, so the cache needs a lock.)
+ */
+static struct pdb *pdb_cache[PDB_MAXCELLS+1][PDB_MAXCELLS+1];
+
+#if defined MIDEND_POOL || defined GENERATE_JOBS
+static pthread_mutex_t pdb_lock = PTHREAD_MUTEX_INITIALIZER;
+#define PDB_LOCK() pthread_mutex_lock(&pdb_lock)
+#define PDB_UNLOCK() pthread_mutex_unlock(&pdb_lock)
+#else
+#define PDB_LOCK() ((void)0)
+#define PDB_UNLOCK() ((void)0)
+#endif
+
+/*
+ * Return the squares in `empty' connected to any in `start'.
+ */
+static unsigned pdb_flood(const struct pdb *pdb, unsigned start,
+                          unsigned empty)
+{
+    unsigned prev;
+
+    do {
+        prev = start;
+        start |= ((start << 1) & ~pdb->left) | ((start >> 1) & ~pdb->right) |
+            (start << pdb->w) | (start >> pdb->w);
+        start &= empty;
+    } while (start != prev);
+
+    return start;
+}
+
+static int pdb_lowest(unsigned mask)
+{
+    int i = 0;
+
+    assert(mask);
+    while (!(mask & 1)) {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+}
+
+/*
+ * Build the table for one group, by breadth-first search backwards
+ * from the solved position. Since moves of tiles outside the group
+ * are free, a search position is the group's placement together with
+ * the connected region of empty squares containing the gap,
+ * represented by its lowest-numbered square.
+ */
+static unsigned char *pdb_build_group(const struct pdb *pdb,
+                                      const int *tiles, int k)
+{
+    int w = pdb->w, h = pdb->h, n = pdb->n;
+    int size = 1 << (4*k);
+    unsigned all = (1U << n) - 1;
+    unsigned char *table, *seen;
+    int *queue, qsize, qhead, qtail, qlevel, dist;
+    int i, start;
+
+    table = snewn(size, unsigned char);
+    memset(table, 0xFF, size);
+    seen = snewn(size * 2, unsigned char);   /* size*16 bits */
+    memset(seen, 0, size * 2);
+
+    qsize = 1024;
+    queue = snewn(qsize, int);
+
+    start = 0;
+    for (i = 0; i < k; i++)
+        start |= (tiles[i] - 1) << (4*i);
+    table[start] = 0;
+    {
+        unsigned empty = all;
+        for (i = 0; i < k; i++)
+            empty &= ~(1U << (tiles[i] - 1));
+        start |= pdb_lowest(pdb_flood(pdb, 1U << (n-1), empty)) << (4*k);
+    }
+    seen[start >> 3] |= 1 << (start & 7);
+    queue[0] = start;
+    qhead = 0;
+    qtail = qlevel = 1;
+    dist = 0;
+
+    while (qhead < qtail) {
+        int state = queue[qhead++];
+        int idx = state & (size - 1), rep = state >> (4*k);
+        unsigned empty = all, comp;
+
+        for (i = 0; i < k; i++)
+            empty &= ~(1U << ((idx >> (4*i)) & 15));
+        comp = pdb_flood(pdb, 1U << rep, empty);
+
+        for (i = 0; i < k; i++) {
+            int p = (idx >> (4*i)) & 15, x = p % w, y = p / w;
+            int dir;
+
+            for (dir = 0; dir < 4; dir++) {
+                int q, nidx, nstate;
+
+                if (dir == 0 && x > 0) q = p - 1;
+                else if (dir == 1 && x < w-1) q = p + 1;
+                else if (dir == 2 && y > 0) q = p - w;
+                else if (dir == 3 && y < h-1) q = p + w;
+                else continue;
+                if (!(comp & (1U << q)))
+                    continue;      /* the gap can't get there */
+
+                /*
+                 * Move the tile into q, leaving the gap where it was.
+                 */
+                nidx = idx ^ ((p ^ q) << (4*i));
+                nstate = nidx | (pdb_lowest(pdb_flood(
+                    pdb, 1U << p, (empty | (1U << p)) & ~(1U << q))) << (4*k));
+                if (seen[nstate >> 3] & (1 << (nstate & 7)))
+                    continue;
+                seen[nstate >> 3] |= 1 << (nstate & 7);
+                if (table[nidx] == 0xFF)
+                    table[nidx] = dist + 1;
+                if (qtail == qsize) {
+                    qsize = qsize * 3 / 2;
+                    queue = sresize(queue, qsize, int);
+                }
+                queue[qtail++] = nstate;
+            }
+        }
+
+        if (qhead == qlevel) {
+            dist++;
+            qlevel = qtail;
+        }
+    }
+
+    sfree(queue);
+    sfree(seen);
+    return table;
+}
+
+static struct pdb *pdb_new(int w, int h)
+{
+    struct pdb *pdb;
+    int tiles[PDB_GROUP];
+    int n = w*h, i, k, g;
+
+    pdb = snew(struct pdb);
+    pdb->w = w;
+    pdb->h = h;
+    pdb->n = n;
+    pdb->left = pdb->right = 0;
+    for (i = 0; i < h; i++) {
+        pdb->left |= 1U << (i*w);
+        pdb->right |= 1U << (i*w + w-1);
+    }
+    pdb->ngroups = 0;
+    for (i = 1; i < n; i += k) {
+        if (w == 4 && h == 4) {
+            k = 0;
+            for (g = 0; pdb_groups_4x4[pdb->ngroups*(PDB_GROUP+1) + g]; g++)
+                tiles[k++] = pdb_groups_4x4[pdb->ngroups*(PDB_GROUP+1) + g];
+        } else {
+            k = (n - i < PDB_GROUP ? n - i : PDB_GROUP);
+            for (g = 0; g < k; g++)
+                tiles[g] = i + g;
+        }
+        for (g = 0; g < k; g++) {
+            pdb->group[tiles[g]] = pdb->ngroups;
+            pdb->shift[tiles[g]] = 4*g;
+        }
+        pdb->table[pdb->ngroups++] = pdb_build_group(pdb, tiles, k);
+    }
+
+    return pdb;
+}
+
+static const struct pdb *get_pdb(int w, int h)
+{
+    struct pdb *pdb;
+
+    assert(w*h <= PDB_MAXCELLS);
+    PDB_LOCK();
+    if (!pdb_cache[w][h])
+        pdb_cache[w][h] = pdb_new(w, h);
+    pdb = pdb_cache[w][h];
+    PDB_UNLOCK();
+
+    return pdb;
+}
+
+struct solver {
+    const struct pdb *pdb;
+    int tiles[PDB_MAXCELLS];
+    int idx[PDB_MAXCELLS];             /* each group's placement */
+    int mirror;                        /* whether to use the reflection */
+    int mcell[PDB_MAXCELLS], mtile[PDB_MAXCELLS];
+    int midx[PDB_MAXCELLS];            /* placements in the reflection */
+    int *path, pathlen;
+    long nodes;
+};
+
+#define SEARCH_FOUND (-1)
+#define SEARCH_GIVEUP (-2)
+
+/*
+ * Depth-first search below a position `g' moves deep, whose
+ * heuristic distances are `hval' and, for its reflection, `mval'.
+ * Returns SEARCH_FOUND or SEARCH_GIVEUP, or otherwise the smallest
+ * estimated solution length exceeding `bound' that we pruned.
+ */
+static int ida_search(struct solver *s, int gap, int prev, int g, int hval,
+                      int mval, int bound)
+{
+    const struct pdb *pdb = s->pdb;
+    int w = pdb->w, x = gap % w, y = gap / w;
+    int dir, ret = -1;
+
+    if (hval == 0) {
+        s->pathlen = g;
+        return SEARCH_FOUND;
+    }
+    if (++s->nodes > SOLVE_MAX_NODES)
+        return SEARCH_GIVEUP;
+
+    for (dir = 0; dir < 4; dir++) {
+        int q, t, grp, old, new, mgrp, mold, mnew, f, mf;
+
+        if (dir == 0 && x > 0) q = gap - 1;
+        else if (dir == 1 && x < w-1) q = gap + 1;
+        else if (dir == 2 && y > 0) q = gap - w;
+        else if (dir == 3 && y < pdb->h-1) q = gap + w;
+        else continue;
+        if (q == prev)
+            continue;              /* don't just undo the last move */
+
+        t = s->tiles[q];
+        grp = pdb->group[t];
+        old = s->idx[grp];
+        new = old ^ ((q ^ gap) << pdb->shift[t]);
+        f = hval - pdb->table[grp][old] + pdb->table[grp][new];
+
+        mgrp = mold = mnew = 0;
+        mf = 0;
+        if (s->mirror) {
+            int mt = s->mtile[t];
+            mgrp = pdb->group[mt];
+            mold = s->midx[mgrp];
+            mnew = mold ^ ((s->mcell[q] ^ s->mcell[gap]) << pdb->shift[mt]);
+            mf = mval - pdb->table[mgrp][mold] + pdb->table[mgrp][mnew];
+        }
+
+        if (g + 1 + max(f, mf) <= bound) {
+            s->tiles[gap] = t;
+            s->tiles[q] = 0;
+            s->idx[grp] = new;
+            s->midx[mgrp] = mnew;
+            s->path[g] = q;
+            f = ida_search(s, q, gap, g+1, f, mf, bound);
+            s->tiles[q] = t;
+            s->tiles[gap] = 0;
+            s->idx[grp] = old;
+            s->midx[mgrp] = mold;
+            if (f == SEARCH_FOUND || f == SEARCH_GIVEUP)
+                return f;
+        } else {
+            f = g + 1 + max(f, mf);
+        }
+        if (ret < 0 || f < ret)
+            ret = f;
+    }
+
+    return ret;
+}
+
+static int *solve_optimal(const game_state *state, int *nmoves)
+{
+    struct solver s;
+    int w = state->w, i, hval, mval, bound, ret;
+
+    if (state->n > PDB_MAXCELLS)
+        return NULL;
+
+    s.pdb = get_pdb(state->w, state->h);
+    s.mirror = (state->w == state->h);
+    for (i = 0; i < state->n; i++) {
+        s.mcell[i] = (s.mirror ? (i % w) * w + i / w : i);
+        s.mtile[(i+1) % state->n] = (s.mcell[i]+1) % state->n;
+    }
+    for (i = 0; i < s.pdb->ngroups; i++)
+        s.idx[i] = s.midx[i] = 0;
+    for (i = 0; i < state->n; i++) {
+        int t = s.tiles[i] = state->tiles[i];
+        if (t) {
+            s.idx[s.pdb->group[t]] |= i << s.pdb->shift[t];
+            s.midx[s.pdb->group[s.mtile[t]]] |=
+                s.mcell[i] << s.pdb->shift[s.mtile[t]];
+        }
+    }
+    hval = mval = 0;
+    for (i = 0; i < s.pdb->ngroups; i++) {
+        hval += s.pdb->table[i][s.idx[i]];
+        mval += s.pdb->table[i][s.midx[i]];
+    }
+
+    s.nodes = 0;
+    s.path = NULL;
+    for (bound = max(hval, mval); ; bound = ret) {
+        s.path = sresize(s.path, bound + 1, int);
+        ret = ida_search(&s, state->gap_pos, -1, 0, hval, mval, bound);
+        if (ret == SEARCH_FOUND) {
+            *nmoves = s.pathlen;
+            return s.path;
+        }
+        if (ret == SEARCH_GIVEUP) {
+            sfree(s.path);
+            return NULL;
+        }
+    }
+}
+
+static int compute_hint(const game_state *state, int *out_x, int *out_y);
+
+/*
+ * Find a sequence of gap positions leading to the solution, or NULL
+ * if the puzzle can't be solved.
+ */
+static int *solve_puzzle(const game_state *state, int *nmoves)
+{
+    game_state *tmp;
+    int *moves, limit, size, solved, x, y;
+
+    if (PARITY_S(state) != perm_parity(state->tiles, state->n))
+        return NULL;
+
+    moves = solve_optimal(state, nmoves);
+    if (moves)
+        return moves;
+
+    tmp = dup_game(state);
+    size = 256;
+    moves = snewn(size, int);
+    *nmoves = 0;
+    solved = FALSE;
+    for (limit = 5 * state->n * state->n * state->n; limit; limit--) {
+        int i;
+
+        for (i = 0; i < tmp->n; i++)
+            if (tmp->tiles[i] != (i < tmp->n-1 ? i+1 : 0))
+                break;
+        if (i == tmp->n) {
+            solved = TRUE;
+            break;
+        }
+
+        if (!compute_hint(tmp, &x, &y))
+            break;
+        slide(tmp->tiles, tmp->w, tmp->gap_pos, C(tmp, x, y));
+        tmp->gap_pos = C(tmp, x, y);
+        if (*nmoves == size) {
+            size = size * 3 / 2;
+            moves = sresize(moves, size, int);
+        }
+        moves[(*nmoves)++] = tmp->gap_pos;
+    }
+    if (!solved) {
+        sfree(moves);
+        moves = NULL;
+    }
+    free_game(tmp);
+
+    return moves;
+}
+
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *aux, const char **error)
 {
-    return dupstr("S");
+    int *moves, nmoves, i;
+    char *ret, *p;
+
+    moves = solve_puzzle(currstate, &nmoves);
+    if (!moves) {
+        /*
+         * Fall back to simply replacing the grid with a solved one.
+         * This at least gives a clean state from which to practise
+         * manoeuvres.
+         */
+        return dupstr("S");
+    }
+
+    ret = snewn(2 + nmoves * 40, char);
+    p = ret;
+    *p++ = 'S';
+    for (i = 0; i < nmoves; i++)
+        p += sprintf(p, ";M%d,%d", X(currstate, moves[i]),
+                     Y(currstate, moves[i]));
+    *p = '\0';
+
+    sfree(moves);
+    return ret;
 }
 
 static int game_can_format_as_text_now(const game_params *params)
@@ -459,6 +934,7 @@ struct game_drawstate {
     int w, h, bgcolour;
     int *tiles;
     int tilesize;
+    int *animfrom, *animto;            /* steps of an animated Solve */
 };
 
 static int flip_cursor(int button)
@@ -726,61 +1202,92 @@ static char *interpret_move(const game_state *state, game_ui *ui,
     return NULL;
 }
 
+/*
+ * Any move location should be equal to the gap location in
+ * _precisely_ one coordinate.
+ */
+static int move_is_valid(const game_state *state, int dx, int dy)
+{
+    int gx = X(state, state->gap_pos), gy = Y(state, state->gap_pos);
+
+    return ((dx == gx) ^ (dy == gy)) &&
+	dx >= 0 && dx < state->w && dy >= 0 && dy < state->h;
+}
+
 static game_state *execute_move(const game_state *from, const char *move)
 {
-    int gx, gy, dx, dy, ux, uy, up, p;
+    int gx, gy, dx, dy, p;
     game_state *ret;
 
-    if (!strcmp(move, "S")) {
+    if (move[0] == 'S') {
+	solve_path *sol;
 	int i;
 
 	ret = dup_game(from);
-
-	/*
-	 * Simply replace the grid with a solved one. For this game,
-	 * this isn't a useful operation for actually telling the user
-	 * what they should have done, but it is useful for
-	 * conveniently being able to get hold of a clean state from
-	 * which to practise manoeuvres.
-	 */
-	for (i = 0; i < ret->n; i++)
-	    ret->tiles[i] = (i+1) % ret->n;
-	ret->gap_pos = ret->n-1;
+	solve_path_free(ret->soln);
+	ret->soln = sol = solve_path_new(strlen(move));
+
+	if (!move[1]) {
+	    /*
+	     * Simply replace the grid with a solved one. We do this
+	     * if the puzzle can't be solved, or for a Solve move from
+	     * an older version; it isn't a useful operation for
+	     * actually telling the user what they should have done,
+	     * but it is useful for conveniently being able to get
+	     * hold of a clean state from which to practise
+	     * manoeuvres.
+	     */
+	    for (i = 0; i < ret->n; i++)
+		ret->tiles[i] = (i+1) % ret->n;
+	    ret->gap_pos = ret->n-1;
+	} else {
+	    /*
+	     * Otherwise the Solve move is a sequence of ordinary
+	     * moves, which we make one at a time, remembering the
+	     * path so that it can be animated.
+	     */
+	    for (move++; *move == ';'; move += strcspn(move, ";")) {
+		move++;
+		if (move[0] != 'M' ||
+		    sscanf(move+1, "%d,%d", &dx, &dy) != 2 ||
+		    !move_is_valid(ret, dx, dy)) {
+		    free_game(ret);
+		    return NULL;
+		}
+		slide(ret->tiles, ret->w, ret->gap_pos, C(ret, dx, dy));
+		ret->gap_pos = C(ret, dx, dy);
+		sol->moves[sol->nmoves++] = ret->gap_pos;
+	    }
+	    for (i = 0; i < ret->n; i++)
+		if (ret->tiles[i] != (i+1) % ret->n)
+		    break;
+	    if (*move || i < ret->n) {
+		free_game(ret);
+		return NULL;
+	    }
+	}
 	ret->used_solve = TRUE;
 	ret->completed = ret->movecount = 1;
 
 	return ret;
     }
 
-    gx = X(from, from->gap_pos);
-    gy = Y(from, from->gap_pos);
-
     if (move[0] != 'M' ||
 	sscanf(move+1, "%d,%d", &dx, &dy) != 2 ||
-	(dx == gx && dy == gy) || (dx != gx && dy != gy) ||
-	dx < 0 || dx >= from->w || dy < 0 || dy >= from->h)
+	!move_is_valid(from, dx, dy))
 	return NULL;
 
-    /*
-     * Find the unit displacement from the original gap
-     * position towards this one.
-     */
-    ux = (dx < gx ? -1 : dx > gx ? +1 : 0);
-    uy = (dy < gy ? -1 : dy > gy ? +1 : 0);
-    up = C(from, ux, uy);
-
     ret = dup_game(from);
+    solve_path_free(ret->soln);
+    ret->soln = NULL;
+
+    gx = X(from, from->gap_pos);
+    gy = Y(from, from->gap_pos);
+    ret->movecount += abs(dx - gx) + abs(dy - gy);
 
     ret->gap_pos = C(from, dx, dy);
     assert(ret->gap_pos >= 0 && ret->gap_pos < ret->n);
-
-    ret->tiles[ret->gap_pos] = 0;
-
-    for (p = from->gap_pos; p != ret->gap_pos; p += up) {
-        assert(p >= 0 && p < from->n);
-        ret->tiles[p] = from->tiles[p + up];
-	ret->movecount++;
-    }
+    slide(ret->tiles, ret->w, from->gap_pos, ret->gap_pos);
 
     /*
      * See if the game has been completed.
@@ -840,6 +1347,8 @@ static game_drawstate *game_new_drawstate(drawing *dr, const game_state *state)
     ds->h = state->h;
     ds->bgcolour = COL_BACKGROUND;
     ds->tiles = snewn(ds->w*ds->h, int);
+    ds->animfrom = snewn(ds->w*ds->h, int);
+    ds->animto = snewn(ds->w*ds->h, int);
     ds->tilesize = 0;                  /* haven't decided yet */
     for (i = 0; i < ds->w*ds->h; i++)
         ds->tiles[i] = -1;
@@ -850,6 +1359,8 @@ static game_drawstate *game_new_drawstate(drawing *dr, const game_state *state)
 static void game_free_drawstate(drawing *dr, game_drawstate *ds)
 {
     sfree(ds->tiles);
+    sfree(ds->animfrom);
+    sfree(ds->animto);
     sfree(ds);
 }
 
@@ -887,12 +1398,71 @@ static void draw_tile(drawing *dr, game_drawstate *ds, const game_state *state,
     draw_update(dr, x, y, TILE_SIZE, TILE_SIZE);
 }
 
+/*
+ * A Solve move is animated one step at a time, each taking at most
+ * ANIM_TIME, and all of them together at most SOLVE_ANIM_TIME.
+ */
+static const solve_path *anim_soln(const game_state *oldstate,
+                             const game_state *newstate, int dir)
+{
+    return (dir > 0 ? newstate : oldstate)->soln;
+}
+
+/*
+ * Work out which step of a Solve move we're part way through, and
+ * fill in `from' and `to' with the grid either side of it. Returns
+ * how far through the step we are, scaled to look like the time
+ * into an ordinary move.
+ */
+static float solve_anim_step(const game_state *oldstate,
+                             const game_state *state, int dir,
+                             float animtime, int *from, int *to)
+{
+    const solve_path *sol = anim_soln(oldstate, state, dir);
+    float steptime = solve_path_step_time(sol, ANIM_TIME);
+    int step = (int)(animtime / steptime);
+    int i, gap, next;
+
+    if (step >= sol->nmoves)
+        step = sol->nmoves - 1;
+
+    /*
+     * When undoing, we're going from the solved position back along
+     * the path, whose start is the gap position in the new state.
+     */
+    memcpy(to, oldstate->tiles, state->n * sizeof(int));
+    gap = oldstate->gap_pos;
+    for (i = 0; i <= step; i++) {
+        if (i == step)
+            memcpy(from, to, state->n * sizeof(int));
+        if (dir > 0)
+            next = sol->moves[i];
+        else if (i < sol->nmoves - 1)
+            next = sol->moves[sol->nmoves - 2 - i];
+        else
+            next = state->gap_pos;
+        slide(to, state->w, gap, next);
+        gap = next;
+    }
+
+    return (animtime - step * steptime) * ANIM_TIME / steptime;
+}
+
 static void game_redraw(drawing *dr, game_drawstate *ds,
                         const game_state *oldstate, const game_state *state,
                         int dir, const game_ui *ui,
                         float animtime, float flashtime)
 {
     int i, pass, bgcolour;
+    const int *oldtiles = (oldstate ? oldstate->tiles : NULL);
+    const int *tiles = state->tiles;
+
+    if (oldstate && anim_soln(oldstate, state, dir)) {
+        animtime = solve_anim_step(oldstate, state, dir, animtime,
+                                   ds->animfrom, ds->animto);
+        oldtiles = ds->animfrom;
+        tiles = ds->animto;
+    }
 
     if (flashtime > 0) {
         int frame = (int)(flashtime / FLASH_FRAME);
@@ -946,10 +1516,10 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
              * -1 because it must always be drawn).
              */
 
-            if (oldstate && oldstate->tiles[i] != state->tiles[i])
+            if (oldtiles && oldtiles[i] != tiles[i])
                 t = -1;
             else
-                t = state->tiles[i];
+                t = tiles[i];
 
             t0 = t;
 
@@ -975,7 +1545,7 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
                     } else {
                         float c;
 
-                        t = state->tiles[i];
+                        t = tiles[i];
 
                         /*
                          * Don't bother moving the gap; just don't
@@ -990,10 +1560,10 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
                          */
                         x1 = COORD(X(state, i));
                         y1 = COORD(Y(state, i));
-                        for (j = 0; j < oldstate->n; j++)
-                            if (oldstate->tiles[j] == state->tiles[i])
+                        for (j = 0; j < state->n; j++)
+                            if (oldtiles[j] == tiles[i])
                                 break;
-                        assert(j < oldstate->n);
+                        assert(j < state->n);
                         x0 = COORD(X(state, j));
                         y0 = COORD(Y(state, j));
 
@@ -1047,6 +1617,10 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
 static float game_anim_length(const game_state *oldstate,
                               const game_state *newstate, int dir, game_ui *ui)
 {
+    const solve_path *sol = anim_soln(oldstate, newstate, dir);
+
+    if (sol)
+        return sol->nmoves * solve_path_step_time(sol, ANIM_TIME);
     return ANIM_TIME;
 }
 
@@ -1097,6 +1671,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     TRUE, solve_game,
     TRUE, game_can_format_as_text_now, game_text_format,
     new_ui,
@@ -1117,7 +1692,7 @@ const struct game thegame = {
     FALSE, FALSE, game_print_size, game_print,
     TRUE,			       /* wants_statusbar */
     FALSE, game_timing_state,
-    0,				       /* flags */
+    SOLVE_ANIMATES,		       /* flags */
 };
 
 #ifdef STANDALONE_SOLVER
@@ -1132,7 +1707,7 @@ int main(int argc, char **argv)
     char *progname = argv[0];
 
     char buf[80];
-    int limit, x, y, solvable;
+    int *moves, nmoves, i, x, y, solvable;
 
     while (--argc > 0) {
         char *p = *++argv;
@@ -1180,33 +1755,39 @@ int main(int argc, char **argv)
         return !grade;
     }
 
-    for (limit = 5 * state->n * state->n * state->n; limit; --limit) {
+    moves = solve_puzzle(state, &nmoves);
+    if (!moves) {
+        free_game(state);
+        fprintf(stderr, "couldn't solve %s:%s\n", id, desc);
+        return 1;
+    }
+
+    for (i = 0; i < nmoves; i++) {
         game_state *next_state;
-        if (!compute_hint(state, &x, &y)) {
-            fprintf(stderr, "couldn't compute next move while solving %s:%s",
-                    id, desc);
-            return 1;
-        }
+        x = X(state, moves[i]);
+        y = Y(state, moves[i]);
         printf("Move the space to (%d, %d), moving %d into the space\n",
-               x + 1, y + 1, state->tiles[C(state, x, y)]);
+               x + 1, y + 1, state->tiles[moves[i]]);
         sprintf(buf, "M%d,%d", x, y);
         next_state = execute_move(state, buf);
 
         free_game(state);
         if (!next_state) {
             fprintf(stderr, "invalid move when solving %s:%s\n", id, desc);
+            sfree(moves);
             return 1;
         }
         state = next_state;
-        if (next_state->completed) {
-            free_game(state);
-            return 0;
-        }
     }
 
+    sfree(moves);
+    solvable = state->completed || nmoves == 0;
     free_game(state);
-    fprintf(stderr, "ran out of moves for %s:%s\n", id, desc);
-    return 1;
+    if (!solvable) {
+        fprintf(stderr, "solution didn't solve %s:%s\n", id, desc);
+        return 1;
+    }
+    return 0;
 }
 
 #endif
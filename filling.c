@@ -2119,6 +2119,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     TRUE, solve_game,
     TRUE, game_can_format_as_text_now, game_text_format,
     new_ui,
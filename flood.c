@@ -246,35 +246,202 @@ void check_recursion_depth(void)
 #define check_recursion_depth() (void)0
 #endif
 
+/*
+ * Solve doesn't affect the game id, so it can afford to look further
+ * ahead than the generator. Each level of lookahead multiplies the
+ * work by the number of colours less one, so go as deep as we can
+ * while that stays within a fixed budget: 5 on the default grid,
+ * where it saves about half a move on average, but only 3 on a large
+ * grid with lots of colours.
+ *
+ * A deeper greedy lookahead isn't always better, though, so Solve
+ * also runs the generator's own search and keeps whichever route is
+ * shorter. From the start of a game, that means it never needs more
+ * moves than the limit.
+ */
+#define SOLVE_MAX_DEPTH 5
+#define SOLVE_BUDGET 1000000L
+
+static int solve_depth(int wh, int colours)
+{
+    int i, depth = RECURSION_DEPTH;
+    long cost = wh;
+
+    for (i = 0; i < depth; i++)
+        cost *= colours - 1;
+    while (depth < SOLVE_MAX_DEPTH && cost * (colours - 1) <= SOLVE_BUDGET) {
+        cost *= colours - 1;
+        depth++;
+    }
+    return depth;
+}
+
+/*
+ * The solver doesn't work on the grid directly. Instead it contracts
+ * the grid into a graph whose vertices are the maximal connected
+ * regions of one colour, with an edge between any two regions that
+ * touch. Flood-filling the controlled area then just absorbs every
+ * region on its boundary that has the new colour, and the distance
+ * search in evaluate() is a breadth-first search over regions rather
+ * than squares.
+ *
+ * A position in the search is recorded as a status for every region,
+ * plus a list of the boundary regions (those adjacent to the
+ * controlled area but not yet in it). We keep one position for each
+ * level of recursion, plus one for the real position at the top.
+ */
+enum { RS_FREE, RS_BOUNDARY, RS_CONTROLLED };
+
+struct solver_pos {
+    char *status;                      /* RS_* for each region */
+    int *boundary;                     /* list of RS_BOUNDARY regions */
+    int nboundary;
+    int control;                       /* number of squares controlled */
+    char colour;                       /* colour of the controlled area */
+};
+
 struct solver_scratch {
-    int *queue[2];
-    int *dist;
-    char *grid, *grid2;
-    char *rgrids;
+    int wh, depth;
+    int nregions;
+    int *size;                         /* number of squares in each region */
+    char *colour;                      /* colour of each region */
+    int *adjstart, *adj;               /* adjacency lists, indexed by region */
+    int *queue;
+    struct solver_pos *pos;            /* depth+1 of these */
 };
 
-static struct solver_scratch *new_scratch(int w, int h)
+static struct solver_scratch *new_scratch(int w, int h, const char *grid,
+                                          int x0, int y0, int depth)
 {
     int wh = w*h;
     struct solver_scratch *scratch = snew(struct solver_scratch);
-    check_recursion_depth();
-    scratch->queue[0] = snewn(wh, int);
-    scratch->queue[1] = snewn(wh, int);
-    scratch->dist = snewn(wh, int);
-    scratch->grid = snewn(wh, char);
-    scratch->grid2 = snewn(wh, char);
-    scratch->rgrids = snewn(wh * RECURSION_DEPTH, char);
+    int *region, *cells, *cellstart, *mark;
+    int i, j, r, n, nadj;
+    struct solver_pos *pos;
+
+    scratch->wh = wh;
+    scratch->depth = depth;
+
+    /*
+     * Label the regions. Each region's squares end up contiguous in
+     * `cells', so that we can go back over them to find its
+     * neighbours.
+     */
+    region = snewn(wh, int);
+    cells = snewn(wh, int);
+    cellstart = snewn(wh+1, int);
+    scratch->size = snewn(wh, int);
+    scratch->colour = snewn(wh, char);
+    for (i = 0; i < wh; i++)
+        region[i] = -1;
+    r = n = 0;
+    for (i = 0; i < wh; i++) {
+        int qtail;
+
+        if (region[i] >= 0)
+            continue;
+        cellstart[r] = qtail = n;
+        region[i] = r;
+        cells[n++] = i;
+        while (qtail < n) {
+            int pos = cells[qtail++];
+            int y = pos / w;
+            int x = pos % w;
+            int dir;
+            for (dir = 0; dir < 4; dir++) {
+                int y1 = y + (dir == 1 ? 1 : dir == 3 ? -1 : 0);
+                int x1 = x + (dir == 0 ? 1 : dir == 2 ? -1 : 0);
+                if (0 <= x1 && x1 < w && 0 <= y1 && y1 < h) {
+                    int pos1 = y1*w+x1;
+                    if (region[pos1] < 0 && grid[pos1] == grid[i]) {
+                        region[pos1] = r;
+                        cells[n++] = pos1;
+                    }
+                }
+            }
+        }
+        scratch->size[r] = n - cellstart[r];
+        scratch->colour[r] = grid[i];
+        r++;
+    }
+    cellstart[r] = n;
+    scratch->nregions = r;
+
+    /*
+     * Now list each region's neighbours, once each.
+     */
+    mark = snewn(scratch->nregions, int);
+    for (r = 0; r < scratch->nregions; r++)
+        mark[r] = -1;
+    scratch->adjstart = snewn(scratch->nregions + 1, int);
+    scratch->adj = snewn(4*wh, int);
+    nadj = 0;
+    for (r = 0; r < scratch->nregions; r++) {
+        scratch->adjstart[r] = nadj;
+        for (i = cellstart[r]; i < cellstart[r+1]; i++) {
+            int y = cells[i] / w;
+            int x = cells[i] % w;
+            int dir;
+            for (dir = 0; dir < 4; dir++) {
+                int y1 = y + (dir == 1 ? 1 : dir == 3 ? -1 : 0);
+                int x1 = x + (dir == 0 ? 1 : dir == 2 ? -1 : 0);
+                if (0 <= x1 && x1 < w && 0 <= y1 && y1 < h) {
+                    int r1 = region[y1*w+x1];
+                    if (r1 != r && mark[r1] != r) {
+                        mark[r1] = r;
+                        scratch->adj[nadj++] = r1;
+                    }
+                }
+            }
+        }
+    }
+    scratch->adjstart[r] = nadj;
+
+    scratch->queue = snewn(scratch->nregions, int);
+    scratch->pos = snewn(depth+1, struct solver_pos);
+    for (i = 0; i <= depth; i++) {
+        scratch->pos[i].status = snewn(scratch->nregions, char);
+        scratch->pos[i].boundary = snewn(scratch->nregions, int);
+    }
+
+    /*
+     * Set up the starting position, controlling just the region
+     * containing the fill square.
+     */
+    pos = &scratch->pos[0];
+    r = region[y0*w+x0];
+    memset(pos->status, RS_FREE, scratch->nregions);
+    pos->status[r] = RS_CONTROLLED;
+    pos->control = scratch->size[r];
+    pos->colour = scratch->colour[r];
+    pos->nboundary = 0;
+    for (j = scratch->adjstart[r]; j < scratch->adjstart[r+1]; j++) {
+        pos->status[scratch->adj[j]] = RS_BOUNDARY;
+        pos->boundary[pos->nboundary++] = scratch->adj[j];
+    }
+
+    sfree(region);
+    sfree(cells);
+    sfree(cellstart);
+    sfree(mark);
+
     return scratch;
 }
 
 static void free_scratch(struct solver_scratch *scratch)
 {
-    sfree(scratch->queue[0]);
-    sfree(scratch->queue[1]);
-    sfree(scratch->dist);
-    sfree(scratch->grid);
-    sfree(scratch->grid2);
-    sfree(scratch->rgrids);
+    int i;
+
+    for (i = 0; i <= scratch->depth; i++) {
+        sfree(scratch->pos[i].status);
+        sfree(scratch->pos[i].boundary);
+    }
+    sfree(scratch->pos);
+    sfree(scratch->queue);
+    sfree(scratch->adjstart);
+    sfree(scratch->adj);
+    sfree(scratch->size);
+    sfree(scratch->colour);
     sfree(scratch);
 }
 
@@ -324,83 +491,104 @@ void dump_dist(int w, int h, const int *dists, const char *titlefmt, ...)
 #endif
 
 /*
- * Search a grid to find the most distant square(s). Return their
+ * Enact a flood-fill move on a solver position, writing the result
+ * into another one.
+ */
+static void solver_move(struct solver_scratch *scratch,
+                        const struct solver_pos *from,
+                        struct solver_pos *to, char move)
+{
+    int i, j, n;
+
+    memcpy(to->status, from->status, scratch->nregions);
+    to->control = from->control;
+    to->colour = move;
+
+    /*
+     * Absorb the boundary regions of the new colour, and keep the
+     * rest on the boundary.
+     */
+    n = 0;
+    for (i = 0; i < from->nboundary; i++) {
+        int r = from->boundary[i];
+        if (scratch->colour[r] == move) {
+            to->status[r] = RS_CONTROLLED;
+            to->control += scratch->size[r];
+        } else {
+            to->boundary[n++] = r;
+        }
+    }
+
+    /*
+     * Then add the absorbed regions' free neighbours. None of those
+     * can have the new colour too, or they'd have been part of the
+     * same region.
+     */
+    for (i = 0; i < from->nboundary; i++) {
+        int r = from->boundary[i];
+        if (scratch->colour[r] != move)
+            continue;
+        for (j = scratch->adjstart[r]; j < scratch->adjstart[r+1]; j++) {
+            int r1 = scratch->adj[j];
+            if (to->status[r1] == RS_FREE) {
+                to->status[r1] = RS_BOUNDARY;
+                to->boundary[n++] = r1;
+            }
+        }
+    }
+    to->nboundary = n;
+}
+
+/*
+ * Search a position to find the most distant square(s), measuring
+ * distance as the number of fills needed to reach them. Return their
  * distance and the number of them, and also the number of squares in
  * the current controlled set (i.e. at distance zero).
+ *
+ * The distance is returned plus one, as it always has been, and the
+ * position's region statuses are used to mark regions visited, so the
+ * position is no longer usable afterwards.
  */
-static void search(int w, int h, char *grid, int x0, int y0,
-                   struct solver_scratch *scratch,
-                   int *rdist, int *rnumber, int *rcontrol)
+static void evaluate(struct solver_scratch *scratch, struct solver_pos *pos,
+                     int *rdist, int *rnumber, int *rcontrol)
 {
-    int wh = w*h;
-    int i, qcurr, qhead, qtail, qnext, currdist, remaining;
-
-    for (i = 0; i < wh; i++)
-        scratch->dist[i] = -1;
-    scratch->queue[0][0] = y0*w+x0;
-    scratch->queue[1][0] = y0*w+x0;
-    scratch->dist[y0*w+x0] = 0;
-    currdist = 0;
-    qcurr = 0;
-    qtail = 0;
-    qhead = 1;
-    qnext = 1;
-    remaining = wh - 1;
+    int *queue = scratch->queue;
+    int i, j, dist, number, nextnumber, qstart, qend, qnext;
+
+    /* The boundary regions are all at distance 1. */
+    number = 0;
+    for (i = 0; i < pos->nboundary; i++) {
+        queue[i] = pos->boundary[i];
+        number += scratch->size[queue[i]];
+    }
+    dist = 1;
+    qstart = 0;
+    qend = qnext = pos->nboundary;
 
     while (1) {
-        if (qtail == qhead) {
-            /* Switch queues. */
-            if (currdist == 0)
-                *rcontrol = qhead;
-            currdist++;
-            qcurr ^= 1;                    /* switch queues */
-            qhead = qnext;
-            qtail = 0;
-            qnext = 0;
-#if 0
-            printf("switch queue, new dist %d, queue %d\n", currdist, qhead);
-#endif
-        } else if (remaining == 0 && qnext == 0) {
-            break;
-        } else {
-            int pos = scratch->queue[qcurr][qtail++];
-            int y = pos / w;
-            int x = pos % w;
-#if 0
-            printf("checking neighbours of %d,%d\n", x, y);
-#endif
-            int dir;
-            for (dir = 0; dir < 4; dir++) {
-                int y1 = y + (dir == 1 ? 1 : dir == 3 ? -1 : 0);
-                int x1 = x + (dir == 0 ? 1 : dir == 2 ? -1 : 0);
-                if (0 <= x1 && x1 < w && 0 <= y1 && y1 < h) {
-                    int pos1 = y1*w+x1;
-#if 0
-                    printf("trying %d,%d: colours %d-%d dist %d\n", x1, y1,
-                           grid[pos], grid[pos1], scratch->dist[pos]);
-#endif
-                    if (scratch->dist[pos1] == -1 &&
-                        ((grid[pos1] == grid[pos] &&
-                          scratch->dist[pos] == currdist) ||
-                         (grid[pos1] != grid[pos] &&
-                          scratch->dist[pos] == currdist - 1))) {
-#if 0
-                        printf("marking %d,%d dist %d\n", x1, y1, currdist);
-#endif
-                        scratch->queue[qcurr][qhead++] = pos1;
-                        scratch->queue[qcurr^1][qnext++] = pos1;
-                        scratch->dist[pos1] = currdist;
-                        remaining--;
-                    }
+        nextnumber = 0;
+        for (i = qstart; i < qend; i++) {
+            int r = queue[i];
+            for (j = scratch->adjstart[r]; j < scratch->adjstart[r+1]; j++) {
+                int r1 = scratch->adj[j];
+                if (pos->status[r1] == RS_FREE) {
+                    pos->status[r1] = RS_BOUNDARY;
+                    queue[qnext++] = r1;
+                    nextnumber += scratch->size[r1];
                 }
             }
         }
+        if (qnext == qend)
+            break;
+        dist++;
+        number = nextnumber;
+        qstart = qend;
+        qend = qnext;
     }
 
-    *rdist = currdist;
-    *rnumber = qhead;
-    if (currdist == 0)
-        *rcontrol = qhead;
+    *rdist = dist + 1;
+    *rnumber = number;
+    *rcontrol = pos->control;
 }
 
 /*
@@ -454,35 +642,32 @@ static int completed(int w, int h, char *grid)
 }
 
 /*
- * Try out every possible move on a grid, and choose whichever one
- * reduced the result of search() by the most.
+ * Try out every possible move on a position, and choose whichever one
+ * reduced the result of evaluate() by the most.
  */
-static char choosemove_recurse(int w, int h, char *grid, int x0, int y0,
-                               int maxmove, struct solver_scratch *scratch,
-                               int depth, int *rbestdist, int *rbestnumber, int *rbestcontrol)
+static char choosemove_recurse(struct solver_scratch *scratch,
+                               const struct solver_pos *pos, int maxmove,
+                               int depth, int *rbestdist, int *rbestnumber,
+                               int *rbestcontrol)
 {
-    int wh = w*h;
+    int wh = scratch->wh;
     char move, bestmove;
     int dist, number, control, bestdist, bestnumber, bestcontrol;
-    char *tmpgrid;
+    struct solver_pos *next;
 
-    assert(0 <= depth && depth < RECURSION_DEPTH);
-    tmpgrid = scratch->rgrids + depth*wh;
+    assert(0 <= depth && depth < scratch->depth);
+    next = &scratch->pos[depth+1];
 
     bestdist = wh + 1;
     bestnumber = 0;
     bestcontrol = 0;
     bestmove = -1;
 
-#if 0
-    dump_grid(w, h, grid, "before choosemove_recurse %d", depth);
-#endif
     for (move = 0; move < maxmove; move++) {
-        if (grid[y0*w+x0] == move)
+        if (pos->colour == move)
             continue;
-        memcpy(tmpgrid, grid, wh * sizeof(*grid));
-        fill(w, h, tmpgrid, x0, y0, move, scratch->queue[0]);
-        if (completed(w, h, tmpgrid)) {
+        solver_move(scratch, pos, next, move);
+        if (next->nboundary == 0) {
             /*
              * A move that wins is immediately the best, so stop
              * searching. Record what depth of recursion that happened
@@ -494,18 +679,12 @@ static char choosemove_recurse(int w, int h, char *grid, int x0, int y0,
             *rbestcontrol = wh;
             return move;
         }
-        if (depth < RECURSION_DEPTH-1) {
-            choosemove_recurse(w, h, tmpgrid, x0, y0, maxmove, scratch,
-                               depth+1, &dist, &number, &control);
+        if (depth < scratch->depth-1) {
+            choosemove_recurse(scratch, next, maxmove, depth+1,
+                               &dist, &number, &control);
         } else {
+            evaluate(scratch, next, &dist, &number, &control);
 #if 0
-            dump_grid(w, h, tmpgrid, "after move %d at depth %d",
-                      move, depth);
-#endif
-            search(w, h, tmpgrid, x0, y0, scratch, &dist, &number, &control);
-#if 0
-            dump_dist(w, h, scratch->dist, "after move %d at depth %d",
-                      move, depth);
             printf("move %d at depth %d: %d at %d\n",
                    depth, move, number, dist);
 #endif
@@ -531,42 +710,60 @@ static char choosemove_recurse(int w, int h, char *grid, int x0, int y0,
     *rbestcontrol = bestcontrol;
     return bestmove;
 }
-static char choosemove(int w, int h, char *grid, int x0, int y0,
-                       int maxmove, struct solver_scratch *scratch)
+static char choosemove(struct solver_scratch *scratch, int maxmove)
 {
     int tmp0, tmp1, tmp2;
-    return choosemove_recurse(w, h, grid, x0, y0, maxmove, scratch,
+    return choosemove_recurse(scratch, &scratch->pos[0], maxmove,
                               0, &tmp0, &tmp1, &tmp2);
 }
 
+/*
+ * Run the solver from its starting position to the end, returning the
+ * number of moves it took and writing them into `moves' if that's
+ * non-NULL.
+ */
+static int solve(struct solver_scratch *scratch, int maxmove, char *moves)
+{
+    int nmoves = 0;
+
+    while (scratch->pos[0].nboundary > 0) {
+        char move = choosemove(scratch, maxmove);
+        struct solver_pos tmp;
+
+        solver_move(scratch, &scratch->pos[0], &scratch->pos[1], move);
+        tmp = scratch->pos[0];
+        scratch->pos[0] = scratch->pos[1];
+        scratch->pos[1] = tmp;
+        if (moves)
+            moves[nmoves] = move;
+        nmoves++;
+    }
+
+    return nmoves;
+}
+
 static char *new_game_desc(const game_params *params, random_state *rs,
 			   char **aux, int interactive)
 {
     int w = params->w, h = params->h, wh = w*h;
     int i, moves;
-    char *desc;
+    char *desc, *grid;
     struct solver_scratch *scratch;
 
-    scratch = new_scratch(w, h);
-
     /*
      * Invent a random grid.
      */
+    grid = snewn(wh, char);
     for (i = 0; i < wh; i++)
-        scratch->grid[i] = random_upto(rs, params->colours);
+        grid[i] = random_upto(rs, params->colours);
 
     /*
      * Run the solver, and count how many moves it uses.
      */
-    memcpy(scratch->grid2, scratch->grid, wh * sizeof(*scratch->grid2));
-    moves = 0;
     check_recursion_depth();
-    while (!completed(w, h, scratch->grid2)) {
-        char move = choosemove(w, h, scratch->grid2, FILLX, FILLY,
-                               params->colours, scratch);
-        fill(w, h, scratch->grid2, FILLX, FILLY, move, scratch->queue[0]);
-        moves++;
-    }
+    scratch = new_scratch(w, h, grid, FILLX, FILLY, RECURSION_DEPTH);
+    moves = solve(scratch, params->colours, NULL);
+    free_scratch(scratch);
 
     /*
      * Adjust for difficulty.
@@ -578,13 +775,13 @@ static char *new_game_desc(const game_params *params, random_state *rs,
      */
     desc = snewn(wh + 40, char);
     for (i = 0; i < wh; i++) {
-        char colour = scratch->grid[i];
+        char colour = grid[i];
         char textcolour = (colour > 9 ? 'A' : '0') + colour;
         desc[i] = textcolour;
     }
     sprintf(desc+i, ",%d", moves);
 
-    free_scratch(scratch);
+    sfree(grid);
 
     return desc;
 }
@@ -687,7 +884,7 @@ static char *solve_game(const game_state *state, const game_state *currstate,
 {
     int w = state->w, h = state->h, wh = w*h;
     char *moves, *ret, *p;
-    int i, len, nmoves;
+    int i, len, nmoves, colours, depth;
     char buf[256];
     struct solver_scratch *scratch;
 
@@ -700,19 +897,41 @@ static char *solve_game(const game_state *state, const game_state *currstate,
      * Find the best solution our solver can give.
      */
     moves = snewn(wh, char);           /* sure to be enough */
-    nmoves = 0;
-    scratch = new_scratch(w, h);
-    memcpy(scratch->grid2, currstate->grid, wh * sizeof(*scratch->grid2));
+
+    /*
+     * The colour count isn't in a descriptive game id, so a state
+     * made from one can have fewer colours than its grid uses. Make
+     * sure the solver tries them all, or it'll never finish.
+     */
+    colours = currstate->colours;
+    for (i = 0; i < wh; i++)
+        if (currstate->grid[i] >= colours)
+            colours = currstate->grid[i] + 1;
+
     check_recursion_depth();
-    while (!completed(w, h, scratch->grid2)) {
-        char move = choosemove(w, h, scratch->grid2, FILLX, FILLY,
-                               currstate->colours, scratch);
-        fill(w, h, scratch->grid2, FILLX, FILLY, move, scratch->queue[0]);
-        assert(nmoves < wh);
-        moves[nmoves++] = move;
-    }
+    depth = solve_depth(wh, colours);
+    scratch = new_scratch(w, h, currstate->grid, FILLX, FILLY, depth);
+    nmoves = solve(scratch, colours, moves);
     free_scratch(scratch);
 
+    if (depth > RECURSION_DEPTH) {
+        char *moves2 = snewn(wh, char);
+        int nmoves2;
+
+        scratch = new_scratch(w, h, currstate->grid, FILLX, FILLY,
+                              RECURSION_DEPTH);
+        nmoves2 = solve(scratch, colours, moves2);
+        free_scratch(scratch);
+
+        if (nmoves2 < nmoves) {
+            sfree(moves);
+            moves = moves2;
+            nmoves = nmoves2;
+        } else {
+            sfree(moves2);
+        }
+    }
+
     /*
      * Encode it as a move string.
      */
@@ -1342,6 +1561,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     TRUE, solve_game,
     TRUE, game_can_format_as_text_now, game_text_format,
     new_ui,
@@ -1364,3 +1584,76 @@ const struct game thegame = {
     FALSE, game_timing_state,
     0,				       /* flags */
 };
+
+#ifdef STANDALONE_SOLVER
+
+/*
+ * Check that Solve stays within the move limit: generate games with
+ * the given parameters from the seeds 1 to n (default 100), solve each
+ * from its starting position, and report any solution longer than the
+ * game allows.
+ */
+int main(int argc, char **argv)
+{
+    game_params *params;
+    const char *err;
+    int i, n = 100, bad = 0;
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s <params> [<number of games>]\n",
+                argv[0]);
+        return 1;
+    }
+    if (argc > 2)
+        n = atoi(argv[2]);
+
+    params = default_params();
+    decode_params(params, argv[1]);
+    err = validate_params(params, TRUE);
+    if (err) {
+        fprintf(stderr, "%s: %s\n", argv[0], err);
+        return 1;
+    }
+
+    for (i = 1; i <= n; i++) {
+        char seed[40], *desc, *aux = NULL, *move;
+        const char *p;
+        random_state *rs;
+        game_state *state;
+        int nmoves;
+
+        sprintf(seed, "%d", i);
+        rs = random_new(seed, strlen(seed));
+        desc = new_game_desc(params, rs, &aux, FALSE);
+        random_free(rs);
+        sfree(aux);
+
+        state = new_game(NULL, params, desc);
+        move = solve_game(state, state, NULL, &err);
+        if (!move) {
+            printf("%s#%s: %s\n", argv[1], seed, err);
+            bad++;
+        } else {
+            /* One colour per comma-separated move, after the 'S'. */
+            nmoves = 1;
+            for (p = move; *p; p++)
+                if (*p == ',')
+                    nmoves++;
+            if (nmoves > state->movelimit) {
+                printf("%s#%s: solution takes %d moves, limit %d\n",
+                       argv[1], seed, nmoves, state->movelimit);
+                bad++;
+            }
+            sfree(move);
+        }
+
+        free_game(state);
+        sfree(desc);
+    }
+
+    free_params(params);
+    printf("%d of %d games solved within the move limit\n", n - bad, n);
+    return bad ? 1 : 0;
+}
+
+#endif
@@ -3642,6 +3642,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
 #ifdef EDITOR
     FALSE, NULL,
 #else
@@ -14,11 +14,29 @@
 #include <math.h>
 #include <float.h>
 
+#if defined MIDEND_POOL || defined GENERATE_JOBS
+#include <pthread.h>
+#endif
+
 #include "puzzles.h"
 #include "tree234.h"
 #include "grid.h"
 #include "penrose.h"
 
+#if defined MIDEND_POOL || defined GENERATE_JOBS
+/*
+ * The midend's puzzle pool generates puzzles on a second thread, as
+ * does the GTK front end's '--generate --jobs', so the grid cache,
+ * and the reference counts of the grids it shares out, need a lock.
+ */
+static pthread_mutex_t grid_lock = PTHREAD_MUTEX_INITIALIZER;
+#define GRID_LOCK() pthread_mutex_lock(&grid_lock)
+#define GRID_UNLOCK() pthread_mutex_unlock(&grid_lock)
+#else
+#define GRID_LOCK() ((void)0)
+#define GRID_UNLOCK() ((void)0)
+#endif
+
 /* Debugging options */
 
 /*
@@ -28,26 +46,48 @@
 /* ----------------------------------------------------------------------
  * Deallocate or dereference a grid
  */
+static void grid_destroy(grid *g)
+{
+    int i;
+    for (i = 0; i < g->num_faces; i++) {
+        sfree(g->faces[i].dots);
+        sfree(g->faces[i].edges);
+    }
+    for (i = 0; i < g->num_dots; i++) {
+        sfree(g->dots[i].faces);
+        sfree(g->dots[i].edges);
+    }
+    sfree(g->face_edge_start);
+    sfree(g->face_edges);
+    sfree(g->dot_edge_start);
+    sfree(g->dot_edges);
+    sfree(g->edge_faces);
+    sfree(g->faces);
+    sfree(g->edges);
+    sfree(g->dots);
+    sfree(g);
+}
+
 void grid_free(grid *g)
 {
+    int last;
+
+    GRID_LOCK();
     assert(g->refcount);
+    last = (--g->refcount == 0);
+    GRID_UNLOCK();
 
-    g->refcount--;
-    if (g->refcount == 0) {
-        int i;
-        for (i = 0; i < g->num_faces; i++) {
-            sfree(g->faces[i].dots);
-            sfree(g->faces[i].edges);
-        }
-        for (i = 0; i < g->num_dots; i++) {
-            sfree(g->dots[i].faces);
-            sfree(g->dots[i].edges);
-        }
-        sfree(g->faces);
-        sfree(g->edges);
-        sfree(g->dots);
-        sfree(g);
-    }
+    if (last)
+        grid_destroy(g);
+}
+
+/* Take another reference to a grid. */
+grid *grid_ref(grid *g)
+{
+    GRID_LOCK();
+    g->refcount++;
+    GRID_UNLOCK();
+    return g;
 }
 
 /* Used by the other grid generators.  Create a brand new grid with nothing
@@ -59,6 +99,9 @@ static grid *grid_empty(void)
     g->edges = NULL;
     g->dots = NULL;
     g->num_faces = g->num_edges = g->num_dots = 0;
+    g->face_edge_start = g->face_edges = NULL;
+    g->dot_edge_start = g->dot_edges = NULL;
+    g->edge_faces = NULL;
     g->refcount = 1;
     g->lowest_x = g->lowest_y = g->highest_x = g->highest_y = 0;
     return g;
@@ -3143,12 +3186,157 @@ const char *grid_validate_desc(grid_type type, int width, int height,
     }
 }
 
+/* Build the index-based adjacency arrays (see grid.h) from the
+ * pointer-based lists, once the grid is otherwise complete. */
+static void grid_make_csr(grid *g)
+{
+    int i, j, n;
+
+    g->face_edge_start = snewn(g->num_faces + 1, int);
+    for (i = n = 0; i < g->num_faces; i++) {
+        g->face_edge_start[i] = n;
+        n += g->faces[i].order;
+    }
+    g->face_edge_start[i] = n;
+    g->face_edges = snewn(n, int);
+    for (i = n = 0; i < g->num_faces; i++)
+        for (j = 0; j < g->faces[i].order; j++)
+            g->face_edges[n++] = g->faces[i].edges[j] - g->edges;
+
+    g->dot_edge_start = snewn(g->num_dots + 1, int);
+    for (i = n = 0; i < g->num_dots; i++) {
+        g->dot_edge_start[i] = n;
+        n += g->dots[i].order;
+    }
+    g->dot_edge_start[i] = n;
+    g->dot_edges = snewn(n, int);
+    for (i = n = 0; i < g->num_dots; i++)
+        for (j = 0; j < g->dots[i].order; j++)
+            g->dot_edges[n++] = g->dots[i].edges[j] - g->edges;
+
+    g->edge_faces = snewn(2 * g->num_edges, int);
+    for (i = 0; i < g->num_edges; i++) {
+        grid_edge *e = g->edges + i;
+        g->edge_faces[2*i] = e->face1 ? e->face1 - g->faces : -1;
+        g->edge_faces[2*i+1] = e->face2 ? e->face2 - g->faces : -1;
+    }
+}
+
+/* The grid cache, in most-recently-used order. */
+struct grid_cache_entry {
+    grid_type type;
+    int width, height;
+    char *desc;
+    grid *g;
+};
+static struct grid_cache_entry *grid_cache = NULL;
+static int grid_cache_len = 0, grid_cache_size = -1; /* -1: not yet set */
+
+/* Drop the cache's reference to a grid. The caller holds the lock. */
+static void grid_cache_drop(struct grid_cache_entry *ent)
+{
+    sfree(ent->desc);
+    if (--ent->g->refcount == 0)
+        grid_destroy(ent->g);
+}
+
+static void grid_cache_resize(int size)
+{
+    if (size < 0)
+        size = 0;
+    while (grid_cache_len > size)
+        grid_cache_drop(&grid_cache[--grid_cache_len]);
+    if (size) {
+        grid_cache = sresize(grid_cache, size, struct grid_cache_entry);
+    } else {
+        sfree(grid_cache);
+        grid_cache = NULL;
+    }
+    grid_cache_size = size;
+}
+
+void grid_cache_set_size(int size)
+{
+    GRID_LOCK();
+    grid_cache_resize(size);
+    GRID_UNLOCK();
+}
+
+/*
+ * Look for a grid in the cache, and if it's there, move it to the front
+ * and return a new reference to it. The caller holds the lock.
+ */
+static grid *grid_cache_find(grid_type type, int width, int height,
+                             const char *desc)
+{
+    struct grid_cache_entry ent;
+    int i;
+
+    for (i = 0; i < grid_cache_len; i++) {
+        ent = grid_cache[i];
+        if (ent.type == type && ent.width == width && ent.height == height &&
+            (ent.desc ? desc && !strcmp(ent.desc, desc) : !desc)) {
+            memmove(grid_cache + 1, grid_cache, i * sizeof(*grid_cache));
+            grid_cache[0] = ent;
+            ent.g->refcount++;
+            return ent.g;
+        }
+    }
+
+    return NULL;
+}
+
 grid *grid_new(grid_type type, int width, int height, const char *desc)
 {
     const char *err = grid_validate_desc(type, width, height, desc);
+    grid *g, *cached;
+    int caching;
+
     if (err) assert(!"Invalid grid description.");
 
-    return grid_news[type](width, height, desc);
+    GRID_LOCK();
+    if (grid_cache_size < 0) {
+        char *env = getenv("PUZZLES_GRID_CACHE");
+        grid_cache_resize(env ? atoi(env) : 0);
+    }
+    cached = grid_cache_find(type, width, height, desc);
+    caching = (grid_cache_size > 0);
+    GRID_UNLOCK();
+    if (cached)
+        return cached;
+
+    /* Build the grid without the lock, so as not to hold up others. */
+    g = grid_news[type](width, height, desc);
+    grid_make_csr(g);
+    if (!caching)
+        return g;
+
+    /*
+     * Another thread may have built and cached the same grid in the
+     * meantime, in which case we use that one and throw ours away.
+     */
+    GRID_LOCK();
+    cached = grid_cache_find(type, width, height, desc);
+    if (!cached && grid_cache_size > 0) {
+        if (grid_cache_len == grid_cache_size)
+            grid_cache_drop(&grid_cache[--grid_cache_len]);
+        memmove(grid_cache + 1, grid_cache,
+                grid_cache_len * sizeof(*grid_cache));
+        grid_cache_len++;
+        grid_cache[0].type = type;
+        grid_cache[0].width = width;
+        grid_cache[0].height = height;
+        grid_cache[0].desc = desc ? dupstr(desc) : NULL;
+        grid_cache[0].g = g;
+        g->refcount++;                 /* the cache's reference */
+    }
+    GRID_UNLOCK();
+
+    if (cached) {
+        grid_destroy(g);
+        return cached;
+    }
+    return g;
 }
 
 void grid_compute_size(grid_type type, int width, int height,
@@ -49,6 +49,12 @@ struct grid_face {
    * computed, because it's fiddly to do. You can call
    * grid_find_incentre() on a face, and it will fill in ix,iy below
    * and set has_incentre to indicate that it's done so.
+   *
+   * This is the one thing that changes in a grid after it's built, and
+   * it isn't locked, even though grid_new() may hand the same grid to
+   * another thread (see below). So only call grid_find_incentre() from
+   * drawing code, which front ends run on a single thread; generators
+   * and solvers mustn't use it.
    */
   int has_incentre;
   int ix, iy;      /* incentre (centre of largest inscribed circle) */
@@ -85,6 +91,18 @@ typedef struct grid {
    * of a square cell. */
   int tilesize;
 
+  /* Index-based copies of the incidence lists above, in compressed
+   * sparse row form, built by grid_new() for solvers that want to walk
+   * them without chasing pointers.  The edges of face i are
+   * face_edges[face_edge_start[i]] up to (but not including)
+   * face_edges[face_edge_start[i+1]], in the same order as
+   * faces[i].edges; dot_edge_start/dot_edges likewise follow
+   * dots[i].edges.  edge_faces[2*i] and edge_faces[2*i+1] are the
+   * indices of edges[i].face1 and face2, or -1 for the outside face. */
+  int *face_edge_start, *face_edges;
+  int *dot_edge_start, *dot_edges;
+  int *edge_faces;
+
   /* We really don't want to copy this monstrosity!
    * A grid is immutable once generated.
    */
@@ -122,6 +140,18 @@ const char *grid_validate_desc(grid_type type, int width, int height,
 
 grid *grid_new(grid_type type, int width, int height, const char *desc);
 
+/* grid_new() can keep the last few grids it built in a cache, and hand
+ * out further references to one of those (see 'refcount' above) instead
+ * of building the same grid again.  The cache holds up to 'size' grids
+ * and discards the least recently used; a size of zero (the default,
+ * unless the environment variable PUZZLES_GRID_CACHE is set to a size)
+ * turns it off and frees anything in it.  Cached grids are shared, so
+ * take further references with grid_ref(): in builds with MIDEND_POOL
+ * or GENERATE_JOBS defined, which call grid_new() from other threads,
+ * that and the cache are protected by a lock. */
+void grid_cache_set_size(int size);
+
+grid *grid_ref(grid *g);
 void grid_free(grid *g);
 
 grid_edge *grid_nearest_edge(grid *g, int x, int y);
@@ -12,7 +12,6 @@
 #include <math.h>
 
 #include <sys/time.h>
-#include <sys/resource.h>
 
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h>
@@ -2489,6 +2488,7 @@ static frontend *new_window(char *arg, int argtype, char **error)
     fe->timer_id = -1;
 
     fe->me = midend_new(fe, &thegame, &gtk_drawing, fe);
+    midend_set_pool(fe->me, 4);
 
     if (arg) {
 	const char *err;
@@ -2921,11 +2921,332 @@ static void list_presets_from_menu(struct preset_menu *menu)
     }
 }
 
+/*
+ * One puzzle's worth of work for --generate: enter the game id (if
+ * any) into the midend, generate a game, and optionally time that
+ * and check the game can be solved from its description alone.
+ * Messages that should stop the program are left in 'error' rather
+ * than printed, because with --jobs this runs on a worker thread.
+ */
+struct generate_job {
+    char *pstr;                        /* game id to enter, or NULL */
+    midend *me;
+    char *seed;
+    double elapsed;
+    char *error;
+    int ready;                         /* used by generate_pool */
+};
+
+static char *generate_error(const char *fmt, const char *a, const char *b,
+                            const char *c)
+{
+    char *ret = snewn(strlen(fmt) + strlen(a) + strlen(b) + strlen(c) + 1,
+                      char);
+    sprintf(ret, fmt, a, b, c);
+    return ret;
+}
+
+static void generate_one(struct generate_job *job, const char *pname,
+                         int time_generation, int test_solve)
+{
+    midend *me = job->me;
+    const char *err;
+    double before = 0.0;
+
+    job->seed = job->error = NULL;
+    job->elapsed = 0.0;
+
+    if (job->pstr) {
+        err = midend_game_id(me, job->pstr);
+        if (err) {
+            job->error = generate_error("%s: error parsing '%s': %s\n",
+                                        pname, job->pstr, err);
+            return;
+        }
+    }
+
+    /*
+     * With '--jobs', this counts only this thread's CPU time where the
+     * OS can tell us that (main() warns if it can't).
+     */
+    if (time_generation)
+        before = thread_cpu_time();
+
+    midend_new_game(me);
+
+    job->seed = midend_get_random_seed(me);
+
+    if (time_generation)
+        job->elapsed = thread_cpu_time() - before;
+
+    if (test_solve && thegame.can_solve) {
+        /*
+         * Now destroy the aux_info in the midend, by means of
+         * re-entering the same game id, and then try to solve
+         * it.
+         */
+        const char *seed = job->seed ? job->seed : "";
+        char *game_id;
+
+        game_id = midend_get_game_id(me);
+        err = midend_game_id(me, game_id);
+        if (err) {
+            job->error = generate_error("%s %s: game id re-entry error: %s\n",
+                                        thegame.name, seed, err);
+            sfree(game_id);
+            return;
+        }
+        midend_new_game(me);
+        sfree(game_id);
+
+        err = midend_solve(me);
+        /*
+         * If the solve operation returned the error "Solution
+         * not known for this puzzle", that's OK, because that
+         * just means it's a puzzle for which we don't have an
+         * algorithmic solver and hence can't solve it without
+         * the aux_info, e.g. Netslide. Nor is "too difficult to
+         * solve automatically", from a solver that works to a
+         * fixed budget (Cube) and ran out on this one.
+         * Any other error is a problem, though.
+         */
+        if (err && strcmp(err, "Solution not known for this puzzle") &&
+            !strstr(err, "too difficult to solve automatically")) {
+            job->error = generate_error("%s %s: solve error: %s\n",
+                                        thegame.name, seed, err);
+            return;
+        }
+    }
+}
+
+/*
+ * The game id to enter for the ith puzzle of a --generate run, given
+ * the command-line argument (if any). NULL means to let the midend
+ * invent a random seed for itself.
+ */
+static char *generate_game_id(const char *arg, int i)
+{
+    char *pstr;
+
+    if (!arg)
+        return NULL;
+
+    pstr = snewn(strlen(arg) + 40, char);
+    strcpy(pstr, arg);
+    if (i > 0 && strchr(arg, '#'))
+        sprintf(pstr + strlen(pstr), "-%d", i);
+    return pstr;
+}
+
+/*
+ * The caches shared between puzzles (grid.c's grids, Fifteen's
+ * pattern databases and so on) only take locks when something may
+ * use them from several threads, so '--jobs' is only offered if the
+ * whole build has GENERATE_JOBS defined.
+ */
+#if GLIB_CHECK_VERSION(2,32,0) && defined GENERATE_JOBS
+#define GENERATE_THREADS
+
+/*
+ * Support for '--generate n --jobs k'. Worker threads, each with a
+ * fresh midend per puzzle, take puzzle numbers in increasing order,
+ * and the main thread collects the finished puzzles in that same
+ * order, so the output is exactly what the serial loop would have
+ * produced.
+ *
+ * Where the serial loop would have let its midend invent a random
+ * seed, we invent it here instead (in the same format), under the
+ * lock and in puzzle order, and hand the workers full 'params#seed'
+ * game ids. Otherwise every worker midend would seed itself from the
+ * time of day, and two of them could easily agree.
+ */
+struct generate_pool {
+    GMutex lock;
+    GCond cond;
+    int n, next, consumed;
+    int window;                        /* puzzles in flight at once */
+    struct generate_job *jobs;         /* 'window' of them */
+    const char *arg, *pname;
+    char *params;                      /* if we invent seeds */
+    random_state *rs;                  /* ditto */
+    int fast_random, time_generation, test_solve;
+    int nthreads;
+    GThread **threads;
+};
+
+static char *generate_pool_game_id(struct generate_pool *pool, int i)
+{
+    char newseed[16], *pstr;
+    int j;
+
+    if (!pool->params)
+        return generate_game_id(pool->arg, i);
+
+    newseed[15] = '\0';
+    newseed[0] = '1' + (char)random_upto(pool->rs, 9);
+    for (j = 1; j < 15; j++)
+        newseed[j] = '0' + (char)random_upto(pool->rs, 10);
+
+    pstr = snewn(strlen(pool->params) + 20, char);
+    sprintf(pstr, "%s#%s", pool->params, newseed);
+    return pstr;
+}
+
+static gpointer generate_worker(gpointer vpool)
+{
+    struct generate_pool *pool = (struct generate_pool *)vpool;
+
+    while (1) {
+        struct generate_job *job;
+        int i;
+
+        g_mutex_lock(&pool->lock);
+        while (pool->next < pool->n &&
+               pool->next >= pool->consumed + pool->window)
+            g_cond_wait(&pool->cond, &pool->lock);
+        if (pool->next >= pool->n) {
+            g_mutex_unlock(&pool->lock);
+            break;
+        }
+        i = pool->next++;
+        job = &pool->jobs[i % pool->window];
+        job->pstr = generate_pool_game_id(pool, i);
+        g_mutex_unlock(&pool->lock);
+
+        job->me = midend_new(NULL, &thegame, NULL, NULL);
+        midend_set_fast_random(job->me, pool->fast_random);
+        generate_one(job, pool->pname, pool->time_generation,
+                     pool->test_solve);
+
+        g_mutex_lock(&pool->lock);
+        job->ready = TRUE;
+        g_cond_broadcast(&pool->cond);
+        g_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+/*
+ * 'me' is the main thread's midend, which has already had any
+ * command-line game id entered into it.
+ */
+static struct generate_pool *generate_pool_new(midend *me, const char *arg,
+                                               const char *pname, int n,
+                                               int nthreads, int fast_random,
+                                               int time_generation,
+                                               int test_solve)
+{
+    struct generate_pool *pool = snew(struct generate_pool);
+    int i;
+
+    g_mutex_init(&pool->lock);
+    g_cond_init(&pool->cond);
+    pool->n = n;
+    pool->next = pool->consumed = 0;
+    pool->window = 4 * nthreads;
+    pool->jobs = snewn(pool->window, struct generate_job);
+    for (i = 0; i < pool->window; i++)
+        pool->jobs[i].ready = FALSE;
+    pool->arg = arg;
+    pool->pname = pname;
+    pool->fast_random = fast_random;
+    pool->time_generation = time_generation;
+    pool->test_solve = test_solve;
+
+    if (!arg || !strpbrk(arg, "#:")) {
+        game_params *params = midend_get_params(me);
+        void *seed;
+        int seedsize;
+
+        pool->params = thegame.encode_params(params, TRUE);
+        thegame.free_params(params);
+        get_random_seed(&seed, &seedsize);
+        pool->rs = random_new(seed, seedsize);
+        sfree(seed);
+    } else {
+        pool->params = NULL;
+        pool->rs = NULL;
+    }
+
+    pool->nthreads = nthreads;
+    pool->threads = snewn(nthreads, GThread *);
+    for (i = 0; i < nthreads; i++)
+        pool->threads[i] = g_thread_new("generate", generate_worker, pool);
+
+    return pool;
+}
+
+static struct generate_job *generate_pool_wait(struct generate_pool *pool,
+                                               int i)
+{
+    struct generate_job *job = &pool->jobs[i % pool->window];
+
+    g_mutex_lock(&pool->lock);
+    while (!job->ready)
+        g_cond_wait(&pool->cond, &pool->lock);
+    g_mutex_unlock(&pool->lock);
+
+    return job;
+}
+
+static void generate_pool_release(struct generate_pool *pool, int i)
+{
+    struct generate_job *job = &pool->jobs[i % pool->window];
+
+    midend_free(job->me);
+    sfree(job->pstr);
+    sfree(job->seed);
+    sfree(job->error);
+
+    g_mutex_lock(&pool->lock);
+    job->ready = FALSE;
+    pool->consumed = i + 1;
+    g_cond_broadcast(&pool->cond);
+    g_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Wait for the workers to finish, having told them not to start any
+ * more puzzles, so that this can also be used to bail out early. Any
+ * puzzles generated but not yet released are thrown away.
+ */
+static void generate_pool_free(struct generate_pool *pool)
+{
+    int i;
+
+    g_mutex_lock(&pool->lock);
+    pool->n = pool->next;
+    g_cond_broadcast(&pool->cond);
+    g_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->nthreads; i++)
+        g_thread_join(pool->threads[i]);
+    sfree(pool->threads);
+    for (i = pool->consumed; i < pool->next; i++) {
+        struct generate_job *job = &pool->jobs[i % pool->window];
+        midend_free(job->me);
+        sfree(job->pstr);
+        sfree(job->seed);
+        sfree(job->error);
+    }
+    if (pool->rs)
+        random_free(pool->rs);
+    sfree(pool->params);
+    sfree(pool->jobs);
+    g_cond_clear(&pool->cond);
+    g_mutex_clear(&pool->lock);
+    sfree(pool);
+}
+
+#endif /* GENERATE_THREADS */
+
 int main(int argc, char **argv)
 {
     char *pname = argv[0];
     char *error;
-    int ngenerate = 0, print = FALSE, px = 1, py = 1;
+    int ngenerate = 0, njobs = 1, fast_random = FALSE;
+    int print = FALSE, px = 1, py = 1;
     int time_generation = FALSE, test_solve = FALSE, list_presets = FALSE;
     int soln = FALSE, colour = FALSE;
     float scale = 1.0F;
@@ -2979,6 +3300,21 @@ int main(int argc, char **argv)
 		}
 	    } else
 		ngenerate = 1;
+	} else if (doing_opts && !strcmp(p, "--jobs")) {
+	    if (--ac > 0) {
+		njobs = atoi(*++av);
+		if (njobs < 1) {
+		    fprintf(stderr, "%s: '--jobs' expected a positive number\n",
+			    pname);
+		    return 1;
+		}
+	    } else {
+		fprintf(stderr, "%s: no argument supplied to '--jobs'\n",
+			pname);
+		return 1;
+	    }
+	} else if (doing_opts && !strcmp(p, "--fast-random")) {
+            fast_random = TRUE;
 	} else if (doing_opts && !strcmp(p, "--time-generation")) {
             time_generation = TRUE;
 	} else if (doing_opts && !strcmp(p, "--test-solve")) {
@@ -3128,10 +3464,13 @@ int main(int argc, char **argv)
      * simplest-to-parse command-line syntax I came up with.
      */
     if (ngenerate > 0 || print || savefile || savesuffix) {
-	int i, n = 1;
+	int i, n = 1, ret = 0;
 	midend *me;
 	char *id;
 	document *doc = NULL;
+#ifdef GENERATE_THREADS
+	struct generate_pool *pool = NULL;
+#endif
 
         /*
          * If we're in this branch, we should display any pending
@@ -3146,6 +3485,7 @@ int main(int argc, char **argv)
 	n = ngenerate;
 
 	me = midend_new(NULL, &thegame, NULL, NULL);
+	midend_set_fast_random(me, fast_random);
 	i = 0;
 
 	if (savefile && !savesuffix)
@@ -3156,6 +3496,35 @@ int main(int argc, char **argv)
 	if (print)
 	    doc = document_new(px, py, scale);
 
+	if (njobs > 1 && ngenerate > 1) {
+#ifdef GENERATE_THREADS
+	    /*
+	     * Enter any parameters into our own midend now, partly to
+	     * report errors in them before starting any threads, and
+	     * partly so that generate_pool_new can find out the full
+	     * set of parameters to invent random seeds for.
+	     */
+	    if (arg && !strpbrk(arg, "#:")) {
+		const char *err = midend_game_id(me, arg);
+		if (err) {
+		    fprintf(stderr, "%s: error parsing '%s': %s\n",
+			    pname, arg, err);
+		    return 1;
+		}
+	    }
+	    if (time_generation && !thread_cpu_time_is_per_thread)
+		fprintf(stderr, "%s: warning: this OS has no per-thread CPU"
+			" times, so with '--jobs' each time printed is for"
+			" the whole process\n", pname);
+	    pool = generate_pool_new(me, arg, pname, n, njobs, fast_random,
+				     time_generation, test_solve);
+#else
+	    fprintf(stderr, "%s: '--jobs' not supported in this build\n",
+		    pname);
+	    return 1;
+#endif
+	}
+
 	/*
 	 * In this loop, we either generate a game ID or read one
 	 * from stdin depending on whether we're in generate mode;
@@ -3173,97 +3542,47 @@ int main(int argc, char **argv)
 	 * generated descriptive game IDs.)
 	 */
 	while (ngenerate == 0 || i < n) {
-	    char *pstr, *seed;
+	    struct generate_job serialjob, *job;
+	    midend *gme;
             const char *err;
-            struct rusage before, after;
 
-	    if (ngenerate == 0) {
-		pstr = fgetline(stdin);
-		if (!pstr)
-		    break;
-		pstr[strcspn(pstr, "\r\n")] = '\0';
-	    } else {
-		if (arg) {
-		    pstr = snewn(strlen(arg) + 40, char);
-
-		    strcpy(pstr, arg);
-		    if (i > 0 && strchr(arg, '#'))
-			sprintf(pstr + strlen(pstr), "-%d", i);
-		} else
-		    pstr = NULL;
-	    }
+#ifdef GENERATE_THREADS
+	    if (pool) {
+		job = generate_pool_wait(pool, i);
+	    } else
+#endif
+	    {
+		job = &serialjob;
+		job->me = me;
 
-	    if (pstr) {
-		err = midend_game_id(me, pstr);
-		if (err) {
-		    fprintf(stderr, "%s: error parsing '%s': %s\n",
-			    pname, pstr, err);
-		    return 1;
+		if (ngenerate == 0) {
+		    job->pstr = fgetline(stdin);
+		    if (!job->pstr)
+			break;
+		    job->pstr[strcspn(job->pstr, "\r\n")] = '\0';
+		} else {
+		    job->pstr = generate_game_id(arg, i);
 		}
-	    }
-
-            if (time_generation)
-                getrusage(RUSAGE_SELF, &before);
-
-            midend_new_game(me);
-
-            seed = midend_get_random_seed(me);
-
-            if (time_generation) {
-                double elapsed;
-
-                getrusage(RUSAGE_SELF, &after);
 
-                elapsed = (after.ru_utime.tv_sec -
-                           before.ru_utime.tv_sec);
-                elapsed += (after.ru_utime.tv_usec -
-                            before.ru_utime.tv_usec) / 1000000.0;
-
-                printf("%s %s: %.6f\n", thegame.name, seed, elapsed);
-            }
+		generate_one(job, pname, time_generation, test_solve);
+	    }
+	    gme = job->me;
 
-            if (test_solve && thegame.can_solve) {
-                /*
-                 * Now destroy the aux_info in the midend, by means of
-                 * re-entering the same game id, and then try to solve
-                 * it.
-                 */
-                char *game_id;
-
-                game_id = midend_get_game_id(me);
-                err = midend_game_id(me, game_id);
-                if (err) {
-                    fprintf(stderr, "%s %s: game id re-entry error: %s\n",
-                            thegame.name, seed, err);
-                    return 1;
-                }
-                midend_new_game(me);
-                sfree(game_id);
-
-                err = midend_solve(me);
-                /*
-                 * If the solve operation returned the error "Solution
-                 * not known for this puzzle", that's OK, because that
-                 * just means it's a puzzle for which we don't have an
-                 * algorithmic solver and hence can't solve it without
-                 * the aux_info, e.g. Netslide. Any other error is a
-                 * problem, though.
-                 */
-                if (err && strcmp(err, "Solution not known for this puzzle")) {
-                    fprintf(stderr, "%s %s: solve error: %s\n",
-                            thegame.name, seed, err);
-                    return 1;
-                }
-            }
+	    if (job->error) {
+		fputs(job->error, stderr);
+		ret = 1;
+		break;
+	    }
 
-	    sfree(pstr);
-            sfree(seed);
+            if (time_generation)
+                printf("%s %s: %.6f\n", thegame.name, job->seed, job->elapsed);
 
 	    if (doc) {
-		err = midend_print_puzzle(me, doc, soln);
+		err = midend_print_puzzle(gme, doc, soln);
 		if (err) {
 		    fprintf(stderr, "%s: error in printing: %s\n", pname, err);
-		    return 1;
+		    ret = 1;
+		    break;
 		}
 	    }
 	    if (savefile) {
@@ -3273,11 +3592,12 @@ int main(int argc, char **argv)
 		sprintf(realname, "%s%d%s", savefile, i, savesuffix);
 
                 if (soln) {
-                    const char *err = midend_solve(me);
+                    const char *err = midend_solve(gme);
                     if (err) {
                         fprintf(stderr, "%s: unable to show solution: %s\n",
                                 realname, err);
-                        return 1;
+                        ret = 1;
+                        break;
                     }
                 }
 
@@ -3285,41 +3605,65 @@ int main(int argc, char **argv)
 		if (!ctx.fp) {
 		    fprintf(stderr, "%s: open: %s\n", realname,
 			    strerror(errno));
-		    return 1;
+		    ret = 1;
+		    break;
 		}
                 ctx.error = 0;
-		midend_serialise(me, savefile_write, &ctx);
+		midend_serialise(gme, savefile_write, &ctx);
 		if (ctx.error) {
 		    fprintf(stderr, "%s: write: %s\n", realname,
 			    strerror(ctx.error));
-		    return 1;
+		    ret = 1;
+		    break;
 		}
 		if (fclose(ctx.fp)) {
 		    fprintf(stderr, "%s: close: %s\n", realname,
 			    strerror(errno));
-		    return 1;
+		    ret = 1;
+		    break;
 		}
 		sfree(realname);
 	    }
 	    if (!doc && !savefile && !time_generation) {
-		id = midend_get_game_id(me);
+		id = midend_get_game_id(gme);
 		puts(id);
 		sfree(id);
 	    }
 
+#ifdef GENERATE_THREADS
+	    if (pool) {
+		generate_pool_release(pool, i);
+	    } else
+#endif
+	    {
+		sfree(job->pstr);
+		sfree(job->seed);
+	    }
+
 	    i++;
 	}
 
+	/*
+	 * On an error, we broke out of the loop above, and must still
+	 * stop any worker threads before exiting.
+	 */
+#ifdef GENERATE_THREADS
+	if (pool)
+	    generate_pool_free(pool);
+#endif
+
 	if (doc) {
-	    psdata *ps = ps_init(stdout, colour);
-	    document_print(doc, ps_drawing_api(ps));
+	    if (!ret) {
+		psdata *ps = ps_init(stdout, colour);
+		document_print(doc, ps_drawing_api(ps));
+		ps_free(ps);
+	    }
 	    document_free(doc);
-	    ps_free(ps);
 	}
 
 	midend_free(me);
 
-	return 0;
+	return ret;
     } else if (list_presets) {
         /*
          * Another specialist mode which causes the puzzle to list the
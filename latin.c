@@ -4,7 +4,7 @@
 
 #include "puzzles.h"
 #include "tree234.h"
-#include "maxflow.h"
+#include "matching.h"
 
 #ifdef STANDALONE_LATIN_TEST
 #define STANDALONE_SOLVER
@@ -16,7 +16,10 @@
  * Solver.
  */
 
-static int latin_solver_top(struct latin_solver *solver, int maxdiff,
+struct latin_solver_arena;
+static int latin_solver_top(struct latin_solver *solver,
+                            struct latin_solver_arena *arena, int depth,
+                            int maxdiff,
 			    int diff_simple, int diff_set_0, int diff_set_1,
 			    int diff_forcing, int diff_recursive,
 			    usersolver_t const *usersolvers, void *ctx,
@@ -26,6 +29,117 @@ static int latin_solver_top(struct latin_solver *solver, int maxdiff,
 int solver_show_working, solver_recurse_depth;
 #endif
 
+/*
+ * Helpers for the packed candidate masks. Each mask is an array of
+ * solver->nw words, holding LATIN_WORDBITS bits in each.
+ */
+#define LWORD(i) ((i) / LATIN_WORDBITS)
+#define LBIT(i) (1UL << ((i) % LATIN_WORDBITS))
+
+#define cellmask(x,y) (solver->cellmask + ((x)*solver->o+(y)) * solver->nw)
+#define rowmask(y,n) (solver->rowmask + ((y)*solver->o+(n)-1) * solver->nw)
+#define colmask(x,n) (solver->colmask + ((x)*solver->o+(n)-1) * solver->nw)
+
+static int latin_bitcount(const unsigned long *mask, int nw)
+{
+    int i, count = 0;
+
+    for (i = 0; i < nw; i++) {
+        unsigned long w = mask[i];
+        w = w - ((w >> 1) & 0x55555555UL);
+        w = (w & 0x33333333UL) + ((w >> 2) & 0x33333333UL);
+        w = (w + (w >> 4)) & 0x0F0F0F0FUL;
+        count += (int)(((w * 0x01010101UL) & 0xFFFFFFFFUL) >> 24);
+    }
+    return count;
+}
+
+/*
+ * Return the index of the first set bit in mask at or after i, or
+ * -1 if there isn't one below nbits. If 'flip' is TRUE, look for
+ * clear bits instead.
+ */
+static int latin_nextbit(const unsigned long *mask, int i, int nbits,
+                         int flip)
+{
+    static const int debruijn[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
+    int word = LWORD(i);
+    unsigned long w;
+
+    if (i >= nbits)
+        return -1;
+    w = (flip ? ~mask[word] : mask[word]) & (~0UL << (i % LATIN_WORDBITS));
+    while (1) {
+        w &= 0xFFFFFFFFUL;
+        if (w) {
+            i = word * LATIN_WORDBITS +
+                debruijn[(((w & -w) * 0x077CB531UL) & 0xFFFFFFFFUL) >> 27];
+            return i < nbits ? i : -1;
+        }
+        if (++word * LATIN_WORDBITS >= nbits)
+            return -1;
+        w = flip ? ~mask[word] : mask[word];
+    }
+}
+
+static int latin_disjoint(const unsigned long *a, const unsigned long *b,
+                          int nw)
+{
+    int i;
+
+    for (i = 0; i < nw; i++)
+        if (a[i] & b[i])
+            return FALSE;
+    return TRUE;
+}
+
+/*
+ * Find the packed mask whose bit i mirrors cube[start+i*step], if
+ * there is one. This is the case for all the rows, columns and
+ * cells that the solver guts look along.
+ */
+static unsigned long *latin_solver_mask(struct latin_solver *solver,
+                                        int start, int step)
+{
+    int o = solver->o, nw = solver->nw;
+
+    if (step == 1 && start % o == 0)
+        return solver->cellmask + (start / o) * nw;
+    if (step == o && start % (o*o) < o)
+        return solver->colmask + ((start / (o*o)) * o + start % (o*o)) * nw;
+    if (step == o*o && start < o*o)
+        return solver->rowmask + start * nw;
+    return NULL;
+}
+
+/*
+ * Rule out the possibility of n at (x,y), keeping the masks in step
+ * with the cube.
+ */
+static void latin_solver_rule_out(struct latin_solver *solver,
+                                  int x, int y, int n)
+{
+    cube(x,y,n) = FALSE;
+    cellmask(x,y)[LWORD(n-1)] &= ~LBIT(n-1);
+    rowmask(y,n)[LWORD(x)] &= ~LBIT(x);
+    colmask(x,n)[LWORD(y)] &= ~LBIT(y);
+}
+
+static void latin_solver_rule_out_pos(struct latin_solver *solver, int fpos)
+{
+    int o = solver->o, x, y, n;
+
+    n = 1 + fpos % o;
+    y = fpos / o;
+    x = y / o;
+    y %= o;
+
+    latin_solver_rule_out(solver, x, y, n);
+}
+
 /*
  * Function called when we are certain that a particular square has
  * a particular number in it. The y-coordinate passed in here is
@@ -34,6 +148,7 @@ int solver_show_working, solver_recurse_depth;
 void latin_solver_place(struct latin_solver *solver, int x, int y, int n)
 {
     int i, o = solver->o;
+    unsigned long *mask;
 
     assert(n <= o);
     assert(cube(x,y,n));
@@ -41,23 +156,29 @@ void latin_solver_place(struct latin_solver *solver, int x, int y, int n)
     /*
      * Rule out all other numbers in this square.
      */
-    for (i = 1; i <= o; i++)
-	if (i != n)
-            cube(x,y,i) = FALSE;
+    mask = cellmask(x,y);
+    for (i = latin_nextbit(mask, 0, o, FALSE); i >= 0;
+         i = latin_nextbit(mask, i+1, o, FALSE))
+	if (i != n-1)
+            latin_solver_rule_out(solver, x, y, i+1);
 
     /*
      * Rule out this number in all other positions in the row.
      */
-    for (i = 0; i < o; i++)
+    mask = colmask(x,n);
+    for (i = latin_nextbit(mask, 0, o, FALSE); i >= 0;
+         i = latin_nextbit(mask, i+1, o, FALSE))
 	if (i != y)
-            cube(x,i,n) = FALSE;
+            latin_solver_rule_out(solver, x, i, n);
 
     /*
      * Rule out this number in all other positions in the column.
      */
-    for (i = 0; i < o; i++)
+    mask = rowmask(y,n);
+    for (i = latin_nextbit(mask, 0, o, FALSE); i >= 0;
+         i = latin_nextbit(mask, i+1, o, FALSE))
 	if (i != x)
-            cube(i,y,n) = FALSE;
+            latin_solver_rule_out(solver, i, y, n);
 
     /*
      * Enter the number in the result grid.
@@ -69,6 +190,8 @@ void latin_solver_place(struct latin_solver *solver, int x, int y, int n)
      * in its row, its column and its block.
      */
     solver->row[y*o+n-1] = solver->col[x*o+n-1] = TRUE;
+    solver->rowused[y*solver->nw + LWORD(n-1)] |= LBIT(n-1);
+    solver->colused[x*solver->nw + LWORD(n-1)] |= LBIT(n-1);
 }
 
 int latin_solver_elim(struct latin_solver *solver, int start, int step
@@ -82,6 +205,7 @@ int latin_solver_elim(struct latin_solver *solver, int start, int step
     char **names = solver->names;
 #endif
     int fpos, m, i;
+    unsigned long *mask;
 
     /*
      * Count the number of set bits within this section of the
@@ -89,11 +213,18 @@ int latin_solver_elim(struct latin_solver *solver, int start, int step
      */
     m = 0;
     fpos = -1;
-    for (i = 0; i < o; i++)
-	if (solver->cube[start+i*step]) {
-	    fpos = start+i*step;
-	    m++;
-	}
+    mask = latin_solver_mask(solver, start, step);
+    if (mask) {
+        m = latin_bitcount(mask, solver->nw);
+        if (m == 1)
+            fpos = start + latin_nextbit(mask, 0, o, FALSE) * step;
+    } else {
+        for (i = 0; i < o; i++)
+            if (solver->cube[start+i*step]) {
+                fpos = start+i*step;
+                m++;
+            }
+    }
 
     if (m == 1) {
 	int x, y, n;
@@ -140,6 +271,7 @@ int latin_solver_elim(struct latin_solver *solver, int start, int step
 
 struct latin_solver_scratch {
     unsigned char *grid, *rowidx, *colidx, *set;
+    unsigned long *gridmask, *setmask;
     int *neighbours, *bfsqueue;
 #ifdef STANDALONE_SOLVER
     int *bfsprev;
@@ -158,11 +290,13 @@ int latin_solver_set(struct latin_solver *solver,
 #ifdef STANDALONE_SOLVER
     char **names = solver->names;
 #endif
+    int nw = solver->nw;
     int i, j, n, count;
-    unsigned char *grid = scratch->grid;
     unsigned char *rowidx = scratch->rowidx;
     unsigned char *colidx = scratch->colidx;
     unsigned char *set = scratch->set;
+    unsigned long *gridmask = scratch->gridmask;
+    unsigned long *setmask = scratch->setmask;
 
     /*
      * We are passed a o-by-o matrix of booleans. Our first job
@@ -197,11 +331,15 @@ int latin_solver_set(struct latin_solver *solver,
     assert(n == j);
 
     /*
-     * And create the smaller matrix.
+     * And create the smaller matrix, with each row packed into a
+     * bitmask so that we can test it against a whole candidate set
+     * at once.
      */
+    memset(gridmask, 0, n * nw * sizeof(*gridmask));
     for (i = 0; i < n; i++)
         for (j = 0; j < n; j++)
-            grid[i*o+j] = solver->cube[start+rowidx[i]*step1+colidx[j]*step2];
+            if (solver->cube[start+rowidx[i]*step1+colidx[j]*step2])
+                gridmask[i*nw+LWORD(j)] |= LBIT(j);
 
     /*
      * Having done that, we now have a matrix in which every row
@@ -212,6 +350,7 @@ int latin_solver_set(struct latin_solver *solver,
      */
 
     memset(set, 0, n);
+    memset(setmask, 0, nw * sizeof(*setmask));
     count = 0;
     while (1) {
         /*
@@ -225,16 +364,9 @@ int latin_solver_set(struct latin_solver *solver,
              * the positions listed in `set'.
              */
             int rows = 0;
-            for (i = 0; i < n; i++) {
-                int ok = TRUE;
-                for (j = 0; j < n; j++)
-                    if (set[j] && grid[i*o+j]) {
-                        ok = FALSE;
-                        break;
-                    }
-                if (ok)
+            for (i = 0; i < n; i++)
+                if (latin_disjoint(gridmask + i*nw, setmask, nw))
                     rows++;
-            }
 
             /*
              * We expect never to be able to get _more_ than
@@ -275,15 +407,10 @@ int latin_solver_set(struct latin_solver *solver,
                  * positions in the cube to meddle with.
                  */
                 for (i = 0; i < n; i++) {
-                    int ok = TRUE;
-                    for (j = 0; j < n; j++)
-                        if (set[j] && grid[i*o+j]) {
-                            ok = FALSE;
-                            break;
-                        }
-                    if (!ok) {
+                    if (!latin_disjoint(gridmask + i*nw, setmask, nw)) {
                         for (j = 0; j < n; j++)
-                            if (!set[j] && grid[i*o+j]) {
+                            if (!set[j] &&
+                                (gridmask[i*nw+LWORD(j)] & LBIT(j))) {
                                 int fpos = (start+rowidx[i]*step1+
                                             colidx[j]*step2);
 #ifdef STANDALONE_SOLVER
@@ -311,7 +438,7 @@ int latin_solver_set(struct latin_solver *solver,
                                 }
 #endif
                                 progress = TRUE;
-                                solver->cube[fpos] = FALSE;
+                                latin_solver_rule_out_pos(solver, fpos);
                             }
                     }
                 }
@@ -327,11 +454,14 @@ int latin_solver_set(struct latin_solver *solver,
          * change all 1s to the right of it to 0s.
          */
         i = n;
-        while (i > 0 && set[i-1])
+        while (i > 0 && set[i-1]) {
             set[--i] = 0, count--;
-        if (i > 0)
+            setmask[LWORD(i)] &= ~LBIT(i);
+        }
+        if (i > 0) {
             set[--i] = 1, count++;
-        else
+            setmask[LWORD(i)] |= LBIT(i);
+        } else
             break;                     /* done */
     }
 
@@ -387,6 +517,8 @@ int latin_solver_forcing(struct latin_solver *solver,
 #endif
     unsigned char *number = scratch->grid;
     int *neighbours = scratch->neighbours;
+    int nw = solver->nw;
+    unsigned long *mask;
     int x, y;
 
     for (y = 0; y < o; y++)
@@ -397,16 +529,16 @@ int latin_solver_forcing(struct latin_solver *solver,
              * If this square doesn't have exactly two candidate
              * numbers, don't try it.
              *
-             * In this loop we also sum the candidate numbers,
-             * which is a nasty hack to allow us to quickly find
-             * `the other one' (since we will shortly know there
-             * are exactly two).
+             * We also sum the candidate numbers, which is a nasty
+             * hack to allow us to quickly find `the other one'
+             * (since we now know there are exactly two).
              */
-            for (count = t = 0, n = 1; n <= o; n++)
-                if (cube(x, y, n))
-                    count++, t += n;
+            mask = cellmask(x, y);
+            count = latin_bitcount(mask, nw);
             if (count != 2)
                 continue;
+            n = latin_nextbit(mask, 0, o, FALSE);
+            t = n + latin_nextbit(mask, n+1, o, FALSE) + 2;
 
             /*
              * Now attempt a bfs for each candidate.
@@ -477,10 +609,12 @@ int latin_solver_forcing(struct latin_solver *solver,
                              * this square to have exactly two
                              * possible numbers.
                              */
-                            for (cc = tt = 0, nn = 1; nn <= o; nn++)
-                                if (cube(xt, yt, nn))
-                                    cc++, tt += nn;
+                            mask = cellmask(xt, yt);
+                            cc = latin_bitcount(mask, nw);
                             if (cc == 2) {
+                                nn = latin_nextbit(mask, 0, o, FALSE);
+                                tt = nn + latin_nextbit(mask, nn+1, o,
+                                                        FALSE) + 2;
                                 bfsqueue[tail++] = yt*o+xt;
 #ifdef STANDALONE_SOLVER
                                 bfsprev[yt*o+xt] = yy*o+xx;
@@ -522,7 +656,7 @@ int latin_solver_forcing(struct latin_solver *solver,
 					   xt+1, yt+1);
                                 }
 #endif
-                                cube(xt, yt, orign) = FALSE;
+                                latin_solver_rule_out(solver, xt, yt, orign);
                                 return 1;
                             }
                         }
@@ -541,6 +675,8 @@ struct latin_solver_scratch *latin_solver_new_scratch(struct latin_solver *solve
     scratch->rowidx = snewn(o, unsigned char);
     scratch->colidx = snewn(o, unsigned char);
     scratch->set = snewn(o, unsigned char);
+    scratch->gridmask = snewn(o * solver->nw, unsigned long);
+    scratch->setmask = snewn(solver->nw, unsigned long);
     scratch->neighbours = snewn(3*o, int);
     scratch->bfsqueue = snewn(o*o, int);
 #ifdef STANDALONE_SOLVER
@@ -556,6 +692,8 @@ void latin_solver_free_scratch(struct latin_solver_scratch *scratch)
 #endif
     sfree(scratch->bfsqueue);
     sfree(scratch->neighbours);
+    sfree(scratch->setmask);
+    sfree(scratch->gridmask);
     sfree(scratch->set);
     sfree(scratch->colidx);
     sfree(scratch->rowidx);
@@ -563,19 +701,20 @@ void latin_solver_free_scratch(struct latin_solver_scratch *scratch)
     sfree(scratch);
 }
 
-void latin_solver_alloc(struct latin_solver *solver, digit *grid, int o)
+/*
+ * (Re)initialise an allocated latin_solver to solve from a given
+ * grid. This is separate from latin_solver_alloc so that the
+ * recursive solver can reuse the same buffers for every guess.
+ */
+static void latin_solver_setup(struct latin_solver *solver, digit *grid)
 {
-    int x, y;
+    int x, y, o = solver->o;
 
-    solver->o = o;
-    solver->cube = snewn(o*o*o, unsigned char);
     solver->grid = grid;		/* write straight back to the input */
     memset(solver->cube, TRUE, o*o*o);
-
-    solver->row = snewn(o*o, unsigned char);
-    solver->col = snewn(o*o, unsigned char);
     memset(solver->row, FALSE, o*o);
     memset(solver->col, FALSE, o*o);
+    latin_solver_sync(solver);
 
     for (x = 0; x < o; x++)
 	for (y = 0; y < o; y++)
@@ -587,49 +726,108 @@ void latin_solver_alloc(struct latin_solver *solver, digit *grid, int o)
 #endif
 }
 
+void latin_solver_alloc(struct latin_solver *solver, digit *grid, int o)
+{
+    int nw;
+
+    solver->o = o;
+    solver->cube = snewn(o*o*o, unsigned char);
+    solver->row = snewn(o*o, unsigned char);
+    solver->col = snewn(o*o, unsigned char);
+
+    solver->nw = nw = (o + LATIN_WORDBITS - 1) / LATIN_WORDBITS;
+    solver->cellmask = snewn(o*o*nw, unsigned long);
+    solver->rowmask = snewn(o*o*nw, unsigned long);
+    solver->colmask = snewn(o*o*nw, unsigned long);
+    solver->rowused = snewn(o*nw, unsigned long);
+    solver->colused = snewn(o*nw, unsigned long);
+
+    latin_solver_setup(solver, grid);
+}
+
 void latin_solver_free(struct latin_solver *solver)
 {
     sfree(solver->cube);
     sfree(solver->row);
     sfree(solver->col);
+    sfree(solver->cellmask);
+    sfree(solver->rowmask);
+    sfree(solver->colmask);
+    sfree(solver->rowused);
+    sfree(solver->colused);
+}
+
+void latin_solver_sync(struct latin_solver *solver)
+{
+    int o = solver->o, nw = solver->nw;
+    int x, y, n;
+
+    memset(solver->cellmask, 0, o*o*nw * sizeof(unsigned long));
+    memset(solver->rowmask, 0, o*o*nw * sizeof(unsigned long));
+    memset(solver->colmask, 0, o*o*nw * sizeof(unsigned long));
+    memset(solver->rowused, 0, o*nw * sizeof(unsigned long));
+    memset(solver->colused, 0, o*nw * sizeof(unsigned long));
+
+    for (x = 0; x < o; x++)
+        for (y = 0; y < o; y++)
+            for (n = 1; n <= o; n++)
+                if (cube(x,y,n)) {
+                    cellmask(x,y)[LWORD(n-1)] |= LBIT(n-1);
+                    rowmask(y,n)[LWORD(x)] |= LBIT(x);
+                    colmask(x,n)[LWORD(y)] |= LBIT(y);
+                }
+
+    for (x = 0; x < o; x++)
+        for (n = 1; n <= o; n++) {
+            if (solver->row[x*o+n-1])
+                solver->rowused[x*nw+LWORD(n-1)] |= LBIT(n-1);
+            if (solver->col[x*o+n-1])
+                solver->colused[x*nw+LWORD(n-1)] |= LBIT(n-1);
+        }
 }
 
 int latin_solver_diff_simple(struct latin_solver *solver)
 {
-    int x, y, n, ret, o = solver->o;
+    int x, y, n, ret, o = solver->o, nw = solver->nw;
+    unsigned long *used;
 #ifdef STANDALONE_SOLVER
     char **names = solver->names;
 #endif
 
     /*
-     * Row-wise positional elimination.
+     * Row-wise positional elimination, for each number not yet
+     * placed in the row.
      */
-    for (y = 0; y < o; y++)
-        for (n = 1; n <= o; n++)
-            if (!solver->row[y*o+n-1]) {
-                ret = latin_solver_elim(solver, cubepos(0,y,n), o*o
+    for (y = 0; y < o; y++) {
+        used = solver->rowused + y*nw;
+        for (n = latin_nextbit(used, 0, o, TRUE) + 1; n > 0;
+             n = latin_nextbit(used, n, o, TRUE) + 1) {
+            ret = latin_solver_elim(solver, cubepos(0,y,n), o*o
 #ifdef STANDALONE_SOLVER
-					, "positional elimination,"
-					" %s in row %d", names[n-1],
-					y+1
+				    , "positional elimination,"
+				    " %s in row %d", names[n-1],
+				    y+1
 #endif
-					);
-                if (ret != 0) return ret;
-            }
+				    );
+            if (ret != 0) return ret;
+        }
+    }
     /*
      * Column-wise positional elimination.
      */
-    for (x = 0; x < o; x++)
-        for (n = 1; n <= o; n++)
-            if (!solver->col[x*o+n-1]) {
-                ret = latin_solver_elim(solver, cubepos(x,0,n), o
+    for (x = 0; x < o; x++) {
+        used = solver->colused + x*nw;
+        for (n = latin_nextbit(used, 0, o, TRUE) + 1; n > 0;
+             n = latin_nextbit(used, n, o, TRUE) + 1) {
+            ret = latin_solver_elim(solver, cubepos(x,0,n), o
 #ifdef STANDALONE_SOLVER
-					, "positional elimination,"
-					" %s in column %d", names[n-1], x+1
+				    , "positional elimination,"
+				    " %s in column %d", names[n-1], x+1
 #endif
-					);
-                if (ret != 0) return ret;
-            }
+				    );
+            if (ret != 0) return ret;
+        }
+    }
 
     /*
      * Numeric elimination.
@@ -698,6 +896,88 @@ int latin_solver_diff_set(struct latin_solver *solver,
     return 0;
 }
 
+/*
+ * Working storage for latin_solver_top and latin_solver_recurse,
+ * indexed by recursion depth. Each level is allocated the first time
+ * the search gets that deep, and then kept until the outermost
+ * latin_solver_main returns, so that every later guess at that depth
+ * reuses it instead of going back to the heap. The depth can never
+ * exceed the number of squares, so the array of levels is allocated
+ * at its maximum size up front.
+ */
+struct latin_solver_level {
+    struct latin_solver solver;     /* the solver at this depth (unused,
+                                     * hence unallocated, at depth 0) */
+    struct latin_solver_scratch *scratch;
+    digit *list, *ingrid, *outgrid; /* for recursing from this depth */
+};
+
+struct latin_solver_arena {
+    int o, nlevels;
+    struct latin_solver_level **levels;
+};
+
+static struct latin_solver_arena *latin_solver_new_arena(int o)
+{
+    struct latin_solver_arena *arena = snew(struct latin_solver_arena);
+    int i;
+
+    arena->o = o;
+    arena->nlevels = o*o+1;
+    arena->levels = snewn(arena->nlevels, struct latin_solver_level *);
+    for (i = 0; i < arena->nlevels; i++)
+        arena->levels[i] = NULL;
+    return arena;
+}
+
+static void latin_solver_free_arena(struct latin_solver_arena *arena)
+{
+    int i;
+
+    for (i = 0; i < arena->nlevels; i++) {
+        struct latin_solver_level *level = arena->levels[i];
+        if (!level)
+            continue;
+        if (i > 0)
+            latin_solver_free(&level->solver);
+        latin_solver_free_scratch(level->scratch);
+        sfree(level->list);
+        sfree(level->ingrid);
+        sfree(level->outgrid);
+        sfree(level);
+    }
+    sfree(arena->levels);
+    sfree(arena);
+}
+
+/*
+ * Return the working storage for the given depth. 'solver' is the
+ * solver at that depth, used only to size the scratch space.
+ */
+static struct latin_solver_level *latin_solver_level
+    (struct latin_solver_arena *arena, int depth, struct latin_solver *solver)
+{
+    struct latin_solver_level *level;
+    int o = arena->o;
+
+    assert(depth < arena->nlevels);
+    level = arena->levels[depth];
+    if (!level) {
+        level = arena->levels[depth] = snew(struct latin_solver_level);
+        level->list = snewn(o, digit);
+        level->ingrid = snewn(o*o, digit);
+        level->outgrid = snewn(o*o, digit);
+        if (depth > 0) {
+            /* latin_solver_recurse sets it up with the real grid later */
+            memset(level->ingrid, 0, o*o);
+            latin_solver_alloc(&level->solver, level->ingrid, o);
+            solver = &level->solver;
+        }
+        level->scratch = latin_solver_new_scratch(solver);
+    }
+    return level;
+}
+
 /*
  * Returns:
  * 0 for 'didn't do anything' implying it was already solved.
@@ -709,7 +989,8 @@ int latin_solver_diff_set(struct latin_solver *solver,
  * and this function may well assert if given an impossible board.
  */
 static int latin_solver_recurse
-    (struct latin_solver *solver, int diff_simple, int diff_set_0,
+    (struct latin_solver *solver, struct latin_solver_arena *arena,
+     int depth, int diff_simple, int diff_set_0,
      int diff_set_1, int diff_forcing, int diff_recursive,
      usersolver_t const *usersolvers, void *ctx,
      ctxnew_t ctxnew, ctxfree_t ctxfree)
@@ -732,10 +1013,7 @@ static int latin_solver_recurse
                  * An unfilled square. Count the number of
                  * possible digits in it.
                  */
-                count = 0;
-                for (n = 1; n <= o; n++)
-                    if (cube(x,y,n))
-                        count++;
+                count = latin_bitcount(cellmask(x,y), solver->nw);
 
                 /*
                  * We should have found any impossibilities
@@ -754,6 +1032,7 @@ static int latin_solver_recurse
         return 0;
     else {
         int i, j;
+        struct latin_solver_level *level, *sublevel;
         digit *list, *ingrid, *outgrid;
         int diff = diff_impossible;    /* no solution found yet */
 
@@ -763,9 +1042,11 @@ static int latin_solver_recurse
         y = best / o;
         x = best % o;
 
-        list = snewn(o, digit);
-        ingrid = snewn(o*o, digit);
-        outgrid = snewn(o*o, digit);
+        level = latin_solver_level(arena, depth, solver);
+        sublevel = latin_solver_level(arena, depth+1, NULL);
+        list = level->list;
+        ingrid = level->ingrid;
+        outgrid = level->outgrid;
         memcpy(ingrid, solver->grid, o*o);
 
         /* Make a list of the possible digits. */
@@ -793,7 +1074,7 @@ static int latin_solver_recurse
         for (i = 0; i < j; i++) {
             int ret;
 	    void *newctx;
-	    struct latin_solver subsolver;
+	    struct latin_solver *subsolver = &sublevel->solver;
 
             memcpy(outgrid, ingrid, o*o);
             outgrid[y*o+x] = list[i];
@@ -810,15 +1091,15 @@ static int latin_solver_recurse
 	    } else {
 		newctx = ctx;
 	    }
-	    latin_solver_alloc(&subsolver, outgrid, o);
+	    latin_solver_setup(subsolver, outgrid);
 #ifdef STANDALONE_SOLVER
-	    subsolver.names = solver->names;
+	    subsolver->names = solver->names;
 #endif
-            ret = latin_solver_top(&subsolver, diff_recursive,
+            ret = latin_solver_top(subsolver, arena, depth+1,
+                                   diff_recursive,
 				   diff_simple, diff_set_0, diff_set_1,
 				   diff_forcing, diff_recursive,
 				   usersolvers, newctx, ctxnew, ctxfree);
-	    latin_solver_free(&subsolver);
 	    if (ctxnew)
 		ctxfree(newctx);
 
@@ -861,10 +1142,6 @@ static int latin_solver_recurse
                 break;
         }
 
-        sfree(outgrid);
-        sfree(ingrid);
-        sfree(list);
-
         if (diff == diff_impossible)
             return -1;
         else if (diff == diff_ambiguous)
@@ -876,13 +1153,16 @@ static int latin_solver_recurse
     }
 }
 
-static int latin_solver_top(struct latin_solver *solver, int maxdiff,
+static int latin_solver_top(struct latin_solver *solver,
+                            struct latin_solver_arena *arena, int depth,
+                            int maxdiff,
 			    int diff_simple, int diff_set_0, int diff_set_1,
 			    int diff_forcing, int diff_recursive,
 			    usersolver_t const *usersolvers, void *ctx,
 			    ctxnew_t ctxnew, ctxfree_t ctxfree)
 {
-    struct latin_solver_scratch *scratch = latin_solver_new_scratch(solver);
+    struct latin_solver_scratch *scratch =
+        latin_solver_level(arena, depth, solver)->scratch;
     int ret, diff = diff_simple;
 
     assert(maxdiff <= diff_recursive);
@@ -901,9 +1181,12 @@ static int latin_solver_top(struct latin_solver *solver, int maxdiff,
         latin_solver_debug(solver->cube, solver->o);
 
 	for (i = 0; i <= maxdiff; i++) {
-	    if (usersolvers[i])
+	    if (usersolvers[i]) {
 		ret = usersolvers[i](solver, ctx);
-	    else
+		/* it may have written to the cube behind our back */
+		if (ret > 0)
+		    latin_solver_sync(solver);
+	    } else
 		ret = 0;
 	    if (ret == 0 && i == diff_simple)
 		ret = latin_solver_diff_simple(solver);
@@ -938,7 +1221,7 @@ static int latin_solver_top(struct latin_solver *solver, int maxdiff,
      * possible.
      */
     if (maxdiff == diff_recursive) {
-        int nsol = latin_solver_recurse(solver,
+        int nsol = latin_solver_recurse(solver, arena, depth,
 					diff_simple, diff_set_0, diff_set_1,
 					diff_forcing, diff_recursive,
 					usersolvers, ctx, ctxnew, ctxfree);
@@ -990,8 +1273,6 @@ static int latin_solver_top(struct latin_solver *solver, int maxdiff,
     }
 #endif
 
-    latin_solver_free_scratch(scratch);
-
     return diff;
 }
 
@@ -1001,6 +1282,7 @@ int latin_solver_main(struct latin_solver *solver, int maxdiff,
 		      usersolver_t const *usersolvers, void *ctx,
 		      ctxnew_t ctxnew, ctxfree_t ctxfree)
 {
+    struct latin_solver_arena *arena;
     int diff;
 #ifdef STANDALONE_SOLVER
     int o = solver->o;
@@ -1024,10 +1306,12 @@ int latin_solver_main(struct latin_solver *solver, int maxdiff,
     }
 #endif
 
-    diff = latin_solver_top(solver, maxdiff,
+    arena = latin_solver_new_arena(solver->o);
+    diff = latin_solver_top(solver, arena, 0, maxdiff,
 			    diff_simple, diff_set_0, diff_set_1,
 			    diff_forcing, diff_recursive,
 			    usersolvers, ctx, ctxnew, ctxfree);
+    latin_solver_free_arena(arena);
 
 #ifdef STANDALONE_SOLVER
     sfree(names);
@@ -1111,9 +1395,9 @@ void latin_debug(digit *sq, int o)
 digit *latin_generate(int o, random_state *rs)
 {
     digit *sq;
-    int *edges, *backedges, *capacity, *flow;
+    int **adjlists, *adjdata, *adjsizes, *matching;
+    unsigned char *used;
     void *scratch;
-    int ne, scratchsize;
     int i, j, k;
     digit *row, *col, *numinv, *num;
 
@@ -1127,8 +1411,9 @@ digit *latin_generate(int o, random_state *rs)
      * row at all which doesn't conflict with previous rows, and
      * the theorem guarantees that we will never have to backtrack.
      *
-     * To find a viable row at each stage, we can make use of the
-     * support functions in maxflow.c.
+     * To find a viable row at each stage, we look for a perfect
+     * matching between the columns and the digits not yet used in
+     * them, using the support functions in matching.c.
      */
 
     sq = snewn(o*o, digit);
@@ -1147,50 +1432,25 @@ digit *latin_generate(int o, random_state *rs)
     shuffle(row, i, sizeof(*row), rs);
 
     /*
-     * Set up the infrastructure for the maxflow algorithm.
+     * Set up the infrastructure for the matching algorithm. We keep
+     * track of which digits have been used in each column as we go,
+     * rather than working it out afresh from the square every time.
      */
-    scratchsize = maxflow_scratch_size(o * 2 + 2);
-    scratch = smalloc(scratchsize);
-    backedges = snewn(o*o + 2*o, int);
-    edges = snewn((o*o + 2*o) * 2, int);
-    capacity = snewn(o*o + 2*o, int);
-    flow = snewn(o*o + 2*o, int);
-    /* Set up the edge array, and the initial capacities. */
-    ne = 0;
-    for (i = 0; i < o; i++) {
-	/* Each LHS vertex is connected to all RHS vertices. */
-	for (j = 0; j < o; j++) {
-	    edges[ne*2] = i;
-	    edges[ne*2+1] = j+o;
-	    /* capacity for this edge is set later on */
-	    ne++;
-	}
-    }
-    for (i = 0; i < o; i++) {
-	/* Each RHS vertex is connected to the distinguished sink vertex. */
-	edges[ne*2] = i+o;
-	edges[ne*2+1] = o*2+1;
-	capacity[ne] = 1;
-	ne++;
-    }
-    for (i = 0; i < o; i++) {
-	/* And the distinguished source vertex connects to each LHS vertex. */
-	edges[ne*2] = o*2;
-	edges[ne*2+1] = i;
-	capacity[ne] = 1;
-	ne++;
-    }
-    assert(ne == o*o + 2*o);
-    /* Now set up backedges. */
-    maxflow_setup_backedges(ne, edges, backedges);
-    
+    scratch = smalloc(matching_scratch_size(o, o));
+    adjdata = snewn(o*o, int);
+    adjlists = snewn(o, int *);
+    adjsizes = snewn(o, int);
+    matching = snewn(o, int);
+    used = snewn(o*o, unsigned char);
+    memset(used, 0, o*o);
+
     /*
      * Now generate each row of the latin square.
      */
     for (i = 0; i < o; i++) {
 	/*
-	 * To prevent maxflow from behaving deterministically, we
-	 * separately permute the columns and the digits for the
+	 * To prevent the matching from behaving deterministically,
+	 * we separately permute the columns and the digits for the
 	 * purposes of the algorithm, differently for every row.
 	 */
 	for (j = 0; j < o; j++)
@@ -1202,45 +1462,43 @@ digit *latin_generate(int o, random_state *rs)
 	    numinv[num[j]] = j;
 
 	/*
-	 * Set up the capacities for the maxflow run, by examining
-	 * the existing latin square.
+	 * Connect each (permuted) column to the (permuted) digits
+	 * which haven't yet been used in it.
 	 */
-	for (j = 0; j < o*o; j++)
-	    capacity[j] = 1;
-	for (j = 0; j < i; j++)
-	    for (k = 0; k < o; k++) {
-		int n = num[sq[row[j]*o + col[k]] - 1];
-		capacity[k*o+n] = 0;
-	    }
+	for (j = 0; j < o; j++) {
+	    const unsigned char *u = used + col[j]*o;
+	    adjlists[j] = adjdata + j*o;
+	    adjsizes[j] = 0;
+	    for (k = 0; k < o; k++)
+		if (!u[numinv[k]])
+		    adjlists[j][adjsizes[j]++] = k;
+	}
 
 	/*
-	 * Run maxflow.
+	 * Run the matching.
 	 */
-	j = maxflow_with_scratch(scratch, o*2+2, 2*o, 2*o+1, ne,
-				 edges, backedges, capacity, flow, NULL);
+	j = matching_with_scratch(scratch, o, o, adjlists, adjsizes,
+				  matching, NULL);
 	assert(j == o);   /* by the above theorem, this must have succeeded */
 
 	/*
-	 * And examine the flow array to pick out the new row of
-	 * the latin square.
+	 * And read off the new row of the latin square.
 	 */
 	for (j = 0; j < o; j++) {
-	    for (k = 0; k < o; k++) {
-		if (flow[j*o+k])
-		    break;
-	    }
-	    assert(k < o);
-	    sq[row[i]*o + col[j]] = numinv[k] + 1;
+	    k = numinv[matching[j]];
+	    sq[row[i]*o + col[j]] = k + 1;
+	    used[col[j]*o + k] = 1;
 	}
     }
 
     /*
      * Done. Free our internal workspaces...
      */
-    sfree(flow);
-    sfree(capacity);
-    sfree(edges);
-    sfree(backedges);
+    sfree(used);
+    sfree(matching);
+    sfree(adjsizes);
+    sfree(adjlists);
+    sfree(adjdata);
     sfree(scratch);
     sfree(numinv);
     sfree(num);
@@ -5,6 +5,8 @@
 
 typedef unsigned char digit;
 
+#define LATIN_WORDBITS 32       /* bits used in each word of a mask */
+
 /* --- Solver structures, definitions --- */
 
 #ifdef STANDALONE_SOLVER
@@ -20,6 +22,19 @@ struct latin_solver {
   unsigned char *row;   /* o^2: row[y*cr+n-1] TRUE if n is in row y */
   unsigned char *col;   /* o^2: col[x*cr+n-1] TRUE if n is in col x */
 
+  /*
+   * Packed copies of the above, as bitmasks of 'nw' words each,
+   * LATIN_WORDBITS bits per word. The cube is still the master
+   * copy (user solvers read and write it directly), and the masks
+   * are brought back into line with it by latin_solver_sync().
+   */
+  int nw;
+  unsigned long *cellmask; /* o^2 masks, by x*o+y: bit n-1 set iff cube(x,y,n) */
+  unsigned long *rowmask;  /* o^2 masks, by y*o+n-1: bit x set iff cube(x,y,n) */
+  unsigned long *colmask;  /* o^2 masks, by x*o+n-1: bit y set iff cube(x,y,n) */
+  unsigned long *rowused;  /* o masks, by y: bit n-1 set iff row[y*o+n-1] */
+  unsigned long *colused;  /* o masks, by x: bit n-1 set iff col[x*o+n-1] */
+
 #ifdef STANDALONE_SOLVER
   char **names;         /* o: names[n-1] gives name of 'digit' n */
 #endif
@@ -67,6 +82,11 @@ int latin_solver_forcing(struct latin_solver *solver,
 void latin_solver_alloc(struct latin_solver *solver, digit *grid, int o);
 void latin_solver_free(struct latin_solver *solver);
 
+/* Brings the packed masks back into line with the cube, after code
+ * outside latin.c has written to the cube directly. latin_solver_main
+ * does this itself whenever a usersolver reports progress. */
+void latin_solver_sync(struct latin_solver *solver);
+
 /* Allocates scratch space (for _set and _forcing) */
 struct latin_solver_scratch *
   latin_solver_new_scratch(struct latin_solver *solver);
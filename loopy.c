@@ -163,8 +163,43 @@ typedef struct solver_state {
 
     /* Hard level information */
     int *linedsf;
+
+    /* To-do queues of the faces and dots which trivial_deductions() and
+     * dline_deductions() need to look at again, because a line or dline
+     * near them has changed since they last did. (linedsf_deductions()
+     * and loop_deductions() depend on things which can change anywhere,
+     * so they still scan everything.) The dline queues are NULL below
+     * Normal difficulty. */
+    tdq *trivial_faces, *trivial_dots;
+    tdq *dline_faces, *dline_dots;
+
+    /* Where solve_game_rec() has got to: the index of the next solver
+     * function to try, and the thresholds described there. Keeping
+     * these here means a partly-run solver can be copied and resumed. */
+    int next_solver;
+    int threshold_diff, threshold_index;
+
+    /* Clue tracking, used by remove_clues(). nsteps counts the solver
+     * function calls made so far; clue_face is the face whose clue is
+     * being worked on at the moment (or -1); and clue_step, if not NULL,
+     * records for each face the first call in which its clue led to a
+     * deduction (or -1 if it hasn't yet). clue_step is not owned by the
+     * solver_state, and isn't copied by dup_solver_state(). */
+    int nsteps, clue_face;
+    int *clue_step;
 } solver_state;
 
+/* A record of a solver run: states[i] is a copy of the solver_state as it
+ * was just before solver function call number i*interval. Only every
+ * interval'th state is kept, so that a long solve of a big grid doesn't
+ * need a copy of the whole state for every call; once MAX_HISTORY states
+ * have been saved, the interval is doubled and every other one dropped. */
+#define MAX_HISTORY 64
+typedef struct solver_history {
+    int nstates, interval;
+    solver_state *states[MAX_HISTORY];
+} solver_history;
+
 /*
  * Difficulty levels. I do some macro ickery here to ensure that my
  * enum and the various forms of my name list always match up.
@@ -235,6 +270,7 @@ struct game_drawstate {
 static const char *validate_desc(const game_params *params, const char *desc);
 static int dot_order(const game_state* state, int i, char line_type);
 static int face_order(const game_state* state, int i, char line_type);
+static void solver_run(solver_state *sstate, solver_history *hist);
 static solver_state *solve_game_rec(const solver_state *sstate);
 
 #ifdef DEBUG_CACHES
@@ -336,8 +372,7 @@ static game_state *dup_game(const game_state *state)
 {
     game_state *ret = snew(game_state);
 
-    ret->game_grid = state->game_grid;
-    ret->game_grid->refcount++;
+    ret->game_grid = grid_ref(state->game_grid);
 
     ret->solved = state->solved;
     ret->cheated = state->cheated;
@@ -413,6 +448,27 @@ static solver_state *new_solver_state(const game_state *state, int diff) {
         ret->linedsf = snew_dsf(state->game_grid->num_edges);
     }
 
+    /* Everything needs looking at to begin with. */
+    ret->trivial_faces = tdq_new(num_faces);
+    tdq_fill(ret->trivial_faces);
+    ret->trivial_dots = tdq_new(num_dots);
+    tdq_fill(ret->trivial_dots);
+    if (diff < DIFF_NORMAL) {
+        ret->dline_faces = ret->dline_dots = NULL;
+    } else {
+        ret->dline_faces = tdq_new(num_faces);
+        tdq_fill(ret->dline_faces);
+        ret->dline_dots = tdq_new(num_dots);
+        tdq_fill(ret->dline_dots);
+    }
+
+    ret->next_solver = 0;
+    ret->threshold_diff = ret->threshold_index = 0;
+
+    ret->nsteps = 0;
+    ret->clue_face = -1;
+    ret->clue_step = NULL;
+
     return ret;
 }
 
@@ -432,10 +488,67 @@ static void free_solver_state(solver_state *sstate) {
         sfree(sstate->dlines);
         sfree(sstate->linedsf);
 
+        tdq_free(sstate->trivial_faces);
+        tdq_free(sstate->trivial_dots);
+        if (sstate->dline_faces) {
+            tdq_free(sstate->dline_faces);
+            tdq_free(sstate->dline_dots);
+        }
+
         sfree(sstate);
     }
 }
 
+/* Copy one solver_state over another which was set up for the same grid
+ * and difficulty level, reusing all of its memory. */
+static void copy_solver_state(solver_state *dst, const solver_state *src)
+{
+    game_state *state = dst->state;
+    int num_dots = state->game_grid->num_dots;
+    int num_faces = state->game_grid->num_faces;
+    int num_edges = state->game_grid->num_edges;
+
+    assert(src->state->game_grid == state->game_grid);
+    assert(src->diff == dst->diff);
+
+    memcpy(state->clues, src->state->clues, num_faces);
+    memcpy(state->lines, src->state->lines, num_edges);
+    memcpy(state->line_errors, src->state->line_errors, num_edges);
+    state->exactly_one_loop = src->state->exactly_one_loop;
+    state->solved = src->state->solved;
+    state->cheated = src->state->cheated;
+
+    dst->solver_status = src->solver_status;
+
+    memcpy(dst->dotdsf, src->dotdsf, num_dots * sizeof(int));
+    memcpy(dst->looplen, src->looplen, num_dots * sizeof(int));
+    memcpy(dst->dot_solved, src->dot_solved, num_dots);
+    memcpy(dst->face_solved, src->face_solved, num_faces);
+    memcpy(dst->dot_yes_count, src->dot_yes_count, num_dots);
+    memcpy(dst->dot_no_count, src->dot_no_count, num_dots);
+    memcpy(dst->face_yes_count, src->face_yes_count, num_faces);
+    memcpy(dst->face_no_count, src->face_no_count, num_faces);
+
+    if (src->dlines)
+        memcpy(dst->dlines, src->dlines, 2*num_edges);
+    if (src->linedsf)
+        memcpy(dst->linedsf, src->linedsf, num_edges * sizeof(int));
+
+    tdq_copy(dst->trivial_faces, src->trivial_faces);
+    tdq_copy(dst->trivial_dots, src->trivial_dots);
+    if (src->dline_faces) {
+        tdq_copy(dst->dline_faces, src->dline_faces);
+        tdq_copy(dst->dline_dots, src->dline_dots);
+    }
+
+    dst->next_solver = src->next_solver;
+    dst->threshold_diff = src->threshold_diff;
+    dst->threshold_index = src->threshold_index;
+
+    dst->nsteps = src->nsteps;
+    dst->clue_face = -1;
+}
+
 static solver_state *dup_solver_state(const solver_state *sstate) {
     game_state *state = sstate->state;
     int num_dots = state->game_grid->num_dots;
@@ -443,52 +556,83 @@ static solver_state *dup_solver_state(const solver_state *sstate) {
     int num_edges = state->game_grid->num_edges;
     solver_state *ret = snew(solver_state);
 
-    ret->state = state = dup_game(sstate->state);
+    ret->state = dup_game(sstate->state);
 
-    ret->solver_status = sstate->solver_status;
     ret->diff = sstate->diff;
 
     ret->dotdsf = snewn(num_dots, int);
     ret->looplen = snewn(num_dots, int);
-    memcpy(ret->dotdsf, sstate->dotdsf,
-           num_dots * sizeof(int));
-    memcpy(ret->looplen, sstate->looplen,
-           num_dots * sizeof(int));
 
     ret->dot_solved = snewn(num_dots, char);
     ret->face_solved = snewn(num_faces, char);
-    memcpy(ret->dot_solved, sstate->dot_solved, num_dots);
-    memcpy(ret->face_solved, sstate->face_solved, num_faces);
 
     ret->dot_yes_count = snewn(num_dots, char);
-    memcpy(ret->dot_yes_count, sstate->dot_yes_count, num_dots);
     ret->dot_no_count = snewn(num_dots, char);
-    memcpy(ret->dot_no_count, sstate->dot_no_count, num_dots);
-
     ret->face_yes_count = snewn(num_faces, char);
-    memcpy(ret->face_yes_count, sstate->face_yes_count, num_faces);
     ret->face_no_count = snewn(num_faces, char);
-    memcpy(ret->face_no_count, sstate->face_no_count, num_faces);
 
-    if (sstate->dlines) {
-        ret->dlines = snewn(2*num_edges, char);
-        memcpy(ret->dlines, sstate->dlines,
-               2*num_edges);
-    } else {
-        ret->dlines = NULL;
-    }
+    ret->dlines = sstate->dlines ? snewn(2*num_edges, char) : NULL;
+    ret->linedsf = sstate->linedsf ? snewn(num_edges, int) : NULL;
 
-    if (sstate->linedsf) {
-        ret->linedsf = snewn(num_edges, int);
-        memcpy(ret->linedsf, sstate->linedsf,
-               num_edges * sizeof(int));
+    ret->trivial_faces = tdq_new(num_faces);
+    ret->trivial_dots = tdq_new(num_dots);
+    if (sstate->dline_faces) {
+        ret->dline_faces = tdq_new(num_faces);
+        ret->dline_dots = tdq_new(num_dots);
     } else {
-        ret->linedsf = NULL;
+        ret->dline_faces = ret->dline_dots = NULL;
     }
 
+    ret->clue_step = NULL;
+
+    copy_solver_state(ret, sstate);
+
     return ret;
 }
 
+/* Thins out a history until it keeps only every interval'th state. The
+ * dropped states stay allocated, for reuse. */
+static void solver_history_thin(solver_history *hist, int interval)
+{
+    int i;
+
+    while (hist->interval < interval) {
+        for (i = 1; 2*i < hist->nstates; i++) {
+            solver_state *s = hist->states[i];
+            hist->states[i] = hist->states[2*i];
+            hist->states[2*i] = s;
+        }
+        hist->nstates = (hist->nstates + 1) / 2;
+        hist->interval *= 2;
+    }
+}
+
+static void solver_history_save(solver_history *hist,
+                                const solver_state *sstate)
+{
+    int t = sstate->nsteps;
+
+    while (t / hist->interval >= MAX_HISTORY)
+        solver_history_thin(hist, hist->interval * 2);
+    if (t % hist->interval)
+        return;
+    t /= hist->interval;
+
+    if (hist->states[t])
+        copy_solver_state(hist->states[t], sstate);
+    else
+        hist->states[t] = dup_solver_state(sstate);
+    hist->nstates = t + 1;
+}
+
+static void free_solver_history(solver_history *hist)
+{
+    int i;
+
+    for (i = 0; i < MAX_HISTORY; i++)
+        free_solver_state(hist->states[i]);
+}
+
 static game_params *default_params(void)
 {
     game_params *ret = snew(game_params);
@@ -1104,8 +1248,40 @@ static void check_caches(const solver_state* sstate)
  * Solver utility functions
  */
 
+/* Records that the clue currently being used by the solver (if any) has
+ * just led to a deduction. */
+static void solver_note_clue(solver_state *sstate)
+{
+    int f = sstate->clue_face;
+
+    if (sstate->clue_step && f >= 0 && sstate->clue_step[f] < 0)
+        sstate->clue_step[f] = sstate->nsteps;
+}
+
+/* Queues up a dot, and the faces around it, when something at the dot
+ * has changed. If a line at the dot has changed, trivial_deductions()
+ * needs to look at all the faces around it, because it looks at lines
+ * touching the corners of a face. If a dline has changed, then only
+ * dline_deductions() cares, but it needs to look at the faces too. */
+static void solver_queue_dot(solver_state *sstate, int dot, int dline)
+{
+    grid *g = sstate->state->game_grid;
+    grid_dot *d = g->dots + dot;
+    tdq *faces = dline ? sstate->dline_faces : sstate->trivial_faces;
+    int i;
+
+    if (!dline)
+        tdq_add(sstate->trivial_dots, dot);
+    if (sstate->dline_dots)
+        tdq_add(sstate->dline_dots, dot);
+    for (i = 0; i < d->order; i++)
+        if (d->faces[i])
+            tdq_add(faces, d->faces[i] - g->faces);
+}
+
 /* Sets the line (with index i) to the new state 'line_new', and updates
- * the cached counts of any affected faces and dots.
+ * the cached counts of any affected faces and dots, and the solver's
+ * to-do queues.
  * Returns TRUE if this actually changed the line's state. */
 static int solver_set_line(solver_state *sstate, int i,
                            enum line_state line_new
@@ -1126,6 +1302,7 @@ static int solver_set_line(solver_state *sstate, int i,
         return FALSE; /* nothing changed */
     }
     state->lines[i] = line_new;
+    solver_note_clue(sstate);
 
 #ifdef SHOW_WORKING
     fprintf(stderr, "solver: set line [%d] to %s (%s)\n",
@@ -1157,6 +1334,15 @@ static int solver_set_line(solver_state *sstate, int i,
         }
     }
 
+    solver_queue_dot(sstate, e->dot1 - g->dots, FALSE);
+    solver_queue_dot(sstate, e->dot2 - g->dots, FALSE);
+    if (sstate->dline_faces) {
+        if (e->face1)
+            tdq_add(sstate->dline_faces, e->face1 - g->faces);
+        if (e->face2)
+            tdq_add(sstate->dline_faces, e->face2 - g->faces);
+    }
+
     check_caches(sstate);
     return TRUE;
 }
@@ -1216,6 +1402,8 @@ static int merge_lines(solver_state *sstate, int i, int j, int inverse
     inverse ^= inv_tmp;
 
     edsf_merge(sstate->linedsf, i, j, inverse);
+    if (i != j)
+        solver_note_clue(sstate);
 
 #ifdef SHOW_WORKING
     if (i != j) {
@@ -1301,17 +1489,15 @@ static int face_setall(solver_state *sstate, int face,
     int retval = FALSE, r;
     game_state *state = sstate->state;
     grid *g;
-    grid_face *f;
     int i;
 
     if (old_type == new_type)
         return FALSE;
 
     g = state->game_grid;
-    f = g->faces + face;
 
-    for (i = 0; i < f->order; i++) {
-        int line_index = f->edges[i] - g->edges;
+    for (i = g->face_edge_start[face]; i < g->face_edge_start[face+1]; i++) {
+        int line_index = g->face_edges[i];
         if (state->lines[line_index] == old_type) {
             r = solver_set_line(sstate, line_index, new_type);
             assert(r == TRUE);
@@ -1374,14 +1560,29 @@ static int game_has_unique_soln(const game_state *state, int diff)
 }
 
 
-/* Remove clues one at a time at random. */
+/*
+ * Remove clues one at a time at random.
+ *
+ * Each removal has to be checked by solving the puzzle again, but most
+ * of the solver's work doesn't depend on the clue that has gone. So we
+ * keep a record of the solve of the current puzzle: the solver state
+ * before some of the solver calls, and for each face the first call in
+ * which its clue led to any deduction. Up to that call a solve without the
+ * clue goes exactly the same way, so we pick it up from the last recorded
+ * state before there rather than starting from scratch, and if the clue
+ * never mattered at all we needn't run the solver. The results are exactly
+ * those of solving afresh.
+ */
 static game_state *remove_clues(game_state *state, random_state *rs,
                                 int diff)
 {
     int *face_list;
     int num_faces = state->game_grid->num_faces;
-    game_state *ret = dup_game(state), *saved_ret;
-    int n;
+    game_state *ret = dup_game(state);
+    solver_state *sstate;
+    solver_history ref, trial, tmp;
+    int *ref_step, *trial_step;
+    int n, i, t;
 
     /* We need to remove some clues.  We'll do this by forming a list of all
      * available clues, shuffling it, then going along one at a
@@ -1394,17 +1595,82 @@ static game_state *remove_clues(game_state *state, random_state *rs,
 
     shuffle(face_list, num_faces, sizeof(int), rs);
 
+    ref.nstates = 0;
+    ref.interval = 1;
+    for (i = 0; i < MAX_HISTORY; i++)
+        ref.states[i] = NULL;
+    trial = ref;
+    ref_step = snewn(num_faces, int);
+    trial_step = snewn(num_faces, int);
+    for (i = 0; i < num_faces; i++)
+        ref_step[i] = -1;
+
+    sstate = new_solver_state(ret, diff);
+    sstate->clue_step = ref_step;
+    solver_run(sstate, &ref);
+    assert(sstate->solver_status == SOLVER_SOLVED);
+    sstate->clue_step = trial_step;
+
     for (n = 0; n < num_faces; ++n) {
-        saved_ret = dup_game(ret);
-        ret->clues[face_list[n]] = -1;
+        int f = face_list[n], clue = ret->clues[f];
+        int step = ref_step[f], ok;
+
+        ret->clues[f] = -1;
 
-        if (game_has_unique_soln(ret, diff)) {
-            free_game(saved_ret);
+        if (step < 0) {
+            /* The clue made no difference, so the solve is unchanged. */
+            ok = TRUE;
         } else {
-            free_game(ret);
-            ret = saved_ret;
+            /* Resume from the last recorded state before 'step', which is
+             * where the trial's record of the solve starts. */
+            step = step / ref.interval;
+            copy_solver_state(sstate, ref.states[step]);
+            step *= ref.interval;
+            sstate->state->clues[f] = -1;
+            for (i = 0; i < num_faces; i++)
+                trial_step[i] = -1;
+            trial.interval = ref.interval;
+            solver_run(sstate, &trial);
+            assert(sstate->solver_status != SOLVER_MISTAKE);
+            ok = (sstate->solver_status == SOLVER_SOLVED);
+        }
+
+        if (!ok) {
+            ret->clues[f] = clue;
+            continue;
+        }
+
+        /*
+         * The trial solve becomes the record for the new puzzle. Its
+         * states before 'step' are the ones we already had, apart from
+         * the missing clue; and so are the first uses of any clues
+         * which were used that early on.
+         */
+        for (t = 0; t < ref.nstates; t++)
+            if (step < 0 || t * ref.interval < step)
+                ref.states[t]->state->clues[f] = -1;
+        if (step >= 0) {
+            solver_history_thin(&ref, trial.interval);
+            for (t = 0; t * ref.interval < step; t++) {
+                solver_state *s = ref.states[t];
+                ref.states[t] = trial.states[t];
+                trial.states[t] = s;
+            }
+            tmp = ref;
+            ref = trial;
+            trial = tmp;
+
+            for (i = 0; i < num_faces; i++)
+                if (ref_step[i] < 0 || ref_step[i] >= step)
+                    ref_step[i] = trial_step[i];
         }
     }
+
+    free_solver_state(sstate);
+    free_solver_history(&ref);
+    free_solver_history(&trial);
+    sfree(ref_step);
+    sfree(trial_step);
     sfree(face_list);
 
     return ret;
@@ -1854,17 +2120,32 @@ static int is_atleastone(const char *dline_array, int index)
 {
     return BIT_SET(dline_array[index], 0);
 }
-static int set_atleastone(char *dline_array, int index)
+/* The setters queue up the dline's dot when they change it. */
+static void dline_changed(solver_state *sstate, int index)
 {
-    return SET_BIT(dline_array[index], 0);
+    grid *g = sstate->state->game_grid;
+    grid_edge *e = g->edges + index / 2;
+    int dot = (index & 1 ? e->dot1 : e->dot2) - g->dots;
+
+    solver_queue_dot(sstate, dot, TRUE);
+}
+static int set_atleastone(solver_state *sstate, int index)
+{
+    if (!SET_BIT(sstate->dlines[index], 0))
+        return FALSE;
+    dline_changed(sstate, index);
+    return TRUE;
 }
 static int is_atmostone(const char *dline_array, int index)
 {
     return BIT_SET(dline_array[index], 1);
 }
-static int set_atmostone(char *dline_array, int index)
+static int set_atmostone(solver_state *sstate, int index)
 {
-    return SET_BIT(dline_array[index], 1);
+    if (!SET_BIT(sstate->dlines[index], 1))
+        return FALSE;
+    dline_changed(sstate, index);
+    return TRUE;
 }
 
 static void array_setall(char *array, char from, char to, int len)
@@ -1910,7 +2191,7 @@ static int dline_set_opp_atleastone(solver_state *sstate,
             continue;
         /* Found opposite UNKNOWNS and they're next to each other */
         opp_dline_index = dline_index_from_dot(g, d, opp);
-        return set_atleastone(sstate->dlines, opp_dline_index);
+        return set_atleastone(sstate, opp_dline_index);
     }
     return FALSE;
 }
@@ -1928,17 +2209,17 @@ static int face_setall_identical(solver_state *sstate, int face_index,
     int retval = FALSE;
     game_state *state = sstate->state;
     grid *g = state->game_grid;
-    grid_face *f = g->faces + face_index;
-    int N = f->order;
+    const int *fe = g->face_edges + g->face_edge_start[face_index];
+    int N = g->face_edge_start[face_index+1] - g->face_edge_start[face_index];
     int i, j;
     int can1, can2, inv1, inv2;
 
     for (i = 0; i < N; i++) {
-        int line1_index = f->edges[i] - g->edges;
+        int line1_index = fe[i];
         if (state->lines[line1_index] != LINE_UNKNOWN)
             continue;
         for (j = i + 1; j < N; j++) {
-            int line2_index = f->edges[j] - g->edges;
+            int line2_index = fe[j];
             if (state->lines[line2_index] != LINE_UNKNOWN)
                 continue;
 
@@ -2092,7 +2373,7 @@ static int trivial_deductions(solver_state *sstate)
     int diff = DIFF_MAX;
 
     /* Per-face deductions */
-    for (i = 0; i < g->num_faces; i++) {
+    while ((i = tdq_remove(sstate->trivial_faces)) >= 0) {
         grid_face *f = g->faces + i;
 
         if (sstate->face_solved[i])
@@ -2108,6 +2389,7 @@ static int trivial_deductions(solver_state *sstate)
 
         if (state->clues[i] < 0)
             continue;
+        sstate->clue_face = i;
 
         /*
          * This code checks whether the numeric clue on a face is so
@@ -2189,11 +2471,12 @@ static int trivial_deductions(solver_state *sstate)
             }
         }
     }
+    sstate->clue_face = -1;
 
     check_caches(sstate);
 
     /* Per-dot deductions */
-    for (i = 0; i < g->num_dots; i++) {
+    while ((i = tdq_remove(sstate->trivial_dots)) >= 0) {
         grid_dot *d = g->dots + i;
         int yes, no, unknown;
 
@@ -2288,10 +2571,11 @@ static int dline_deductions(solver_state *sstate)
      * could get quite expensive if there are many large faces. */
 #define MAX_FACE_SIZE 12
 
-    for (i = 0; i < g->num_faces; i++) {
+    while ((i = tdq_remove(sstate->dline_faces)) >= 0) {
         int maxs[MAX_FACE_SIZE][MAX_FACE_SIZE];
         int mins[MAX_FACE_SIZE][MAX_FACE_SIZE];
         grid_face *f = g->faces + i;
+        const int *fe = g->face_edges + g->face_edge_start[i];
         int N = f->order;
         int j,m;
         int clue = state->clues[i];
@@ -2299,10 +2583,11 @@ static int dline_deductions(solver_state *sstate)
         if (sstate->face_solved[i])
             continue;
         if (clue < 0) continue;
+        sstate->clue_face = i;
 
         /* Calculate the (j,j+1) entries */
         for (j = 0; j < N; j++) {
-            int edge_index = f->edges[j] - g->edges;
+            int edge_index = fe[j];
             int dline_index;
             enum line_state line1 = state->lines[edge_index];
             enum line_state line2;
@@ -2313,7 +2598,7 @@ static int dline_deductions(solver_state *sstate)
             mins[j][k] = (line1 == LINE_YES) ? 1 : 0;
             /* Calculate the (j,j+2) entries */
             dline_index = dline_index_from_face(g, f, k);
-            edge_index = f->edges[k] - g->edges;
+            edge_index = fe[k];
             line2 = state->lines[edge_index];
             k++;
             if (k >= N) k = 0;
@@ -2357,8 +2642,7 @@ static int dline_deductions(solver_state *sstate)
         /* See if we can make any deductions */
         for (j = 0; j < N; j++) {
             int k;
-            grid_edge *e = f->edges[j];
-            int line_index = e - g->edges;
+            int line_index = fe[j];
             int dline_index;
 
             if (state->lines[line_index] != LINE_UNKNOWN)
@@ -2392,8 +2676,7 @@ static int dline_deductions(solver_state *sstate)
              * in square grids. */
             if (sstate->diff >= DIFF_TRICKY) {
                 /* Now see if we can make dline deduction for edges{j,j+1} */
-                e = f->edges[k];
-                if (state->lines[e - g->edges] != LINE_UNKNOWN)
+                if (state->lines[fe[k]] != LINE_UNKNOWN)
                     /* Only worth doing this for an UNKNOWN,UNKNOWN pair.
                      * Dlines where one of the edges is known, are handled in the
                      * dot-deductions */
@@ -2406,26 +2689,32 @@ static int dline_deductions(solver_state *sstate)
                 /* minimum YESs in the complement of this dline */
                 if (mins[k][j] > clue - 2) {
                     /* Adding 2 YESs would break the clue */
-                    if (set_atmostone(dlines, dline_index))
+                    if (set_atmostone(sstate, dline_index)) {
                         diff = min(diff, DIFF_NORMAL);
+                        solver_note_clue(sstate);
+                    }
                 }
                 /* maximum YESs in the complement of this dline */
                 if (maxs[k][j] < clue) {
                     /* Adding 2 NOs would mean not enough YESs */
-                    if (set_atleastone(dlines, dline_index))
+                    if (set_atleastone(sstate, dline_index)) {
                         diff = min(diff, DIFF_NORMAL);
+                        solver_note_clue(sstate);
+                    }
                 }
             }
         }
     }
+    sstate->clue_face = -1;
 
     if (diff < DIFF_NORMAL)
         return diff;
 
     /* ------ Dot deductions ------ */
 
-    for (i = 0; i < g->num_dots; i++) {
+    while ((i = tdq_remove(sstate->dline_dots)) >= 0) {
         grid_dot *d = g->dots + i;
+        const int *de = g->dot_edges + g->dot_edge_start[i];
         int N = d->order;
         int yes, no, unknown;
         int j;
@@ -2443,18 +2732,18 @@ static int dline_deductions(solver_state *sstate)
             k = j + 1;
             if (k >= N) k = 0;
             dline_index = dline_index_from_dot(g, d, j);
-            line1_index = d->edges[j] - g->edges;
-            line2_index = d->edges[k] - g->edges;
+            line1_index = de[j];
+            line2_index = de[k];
             line1 = state->lines[line1_index];
             line2 = state->lines[line2_index];
 
             /* Infer dline state from line state */
             if (line1 == LINE_NO || line2 == LINE_NO) {
-                if (set_atmostone(dlines, dline_index))
+                if (set_atmostone(sstate, dline_index))
                     diff = min(diff, DIFF_NORMAL);
             }
             if (line1 == LINE_YES || line2 == LINE_YES) {
-                if (set_atleastone(dlines, dline_index))
+                if (set_atleastone(sstate, dline_index))
                     diff = min(diff, DIFF_NORMAL);
             }
             /* Infer line state from dline state */
@@ -2500,10 +2789,10 @@ static int dline_deductions(solver_state *sstate)
                 }
             }
             if (yes == 1) {
-                if (set_atmostone(dlines, dline_index))
+                if (set_atmostone(sstate, dline_index))
                     diff = min(diff, DIFF_NORMAL);
                 if (unknown == 2) {
-                    if (set_atleastone(dlines, dline_index))
+                    if (set_atleastone(sstate, dline_index))
                         diff = min(diff, DIFF_NORMAL);
                 }
             }
@@ -2529,7 +2818,7 @@ static int dline_deductions(solver_state *sstate)
                         if (j == N-1 && opp == 0)
                             continue;
                         opp_dline_index = dline_index_from_dot(g, d, opp);
-                        if (set_atmostone(dlines, opp_dline_index))
+                        if (set_atmostone(sstate, opp_dline_index))
                             diff = min(diff, DIFF_NORMAL);
                     }
                     if (yes == 0 && is_atmostone(dlines, dline_index)) {
@@ -2591,6 +2880,7 @@ static int linedsf_deductions(solver_state *sstate)
         clue = state->clues[i];
         if (clue < 0)
             continue;
+        sstate->clue_face = i;
 
         N = g->faces[i].order;
         yes = sstate->face_yes_count[i];
@@ -2614,6 +2904,7 @@ static int linedsf_deductions(solver_state *sstate)
                                      (clue - yes) % 2, unknown);
         diff = min(diff, diff_tmp);
     }
+    sstate->clue_face = -1;
 
     /* ------ Dot deductions ------ */
     for (i = 0; i < g->num_dots; i++) {
@@ -2642,9 +2933,9 @@ static int linedsf_deductions(solver_state *sstate)
             can2 = edsf_canonify(sstate->linedsf, line2_index, &inv2);
             if (can1 == can2 && inv1 != inv2) {
                 /* These are opposites, so set dline atmostone/atleastone */
-                if (set_atmostone(dlines, dline_index))
+                if (set_atmostone(sstate, dline_index))
                     diff = min(diff, DIFF_NORMAL);
-                if (set_atleastone(dlines, dline_index))
+                if (set_atleastone(sstate, dline_index))
                     diff = min(diff, DIFF_NORMAL);
                 continue;
             }
@@ -2692,6 +2983,37 @@ static int linedsf_deductions(solver_state *sstate)
     return diff;
 }
 
+/*
+ * Helper for loop_deductions(), used when tracking clues for
+ * remove_clues(). Once the YES lines form a single chain or loop, the
+ * decisions loop_deductions() makes depend on which clues are satisfied,
+ * so we note every clue whose removal might change them: any clue not
+ * yet satisfied, except for those next to 'e' that adding e would
+ * satisfy.
+ */
+static void loop_note_clues(solver_state *sstate, const grid_edge *e)
+{
+    game_state *state = sstate->state;
+    grid *g = state->game_grid;
+    int i;
+
+    if (!sstate->clue_step)
+        return;
+
+    for (i = 0; i < g->num_faces; i++) {
+        int c = state->clues[i];
+        int o = sstate->face_yes_count[i];
+        if (c < 0 || o == c)
+            continue;
+        if (e && o == c - 1 &&
+            (e->face1 == g->faces + i || e->face2 == g->faces + i))
+            continue;
+        sstate->clue_face = i;
+        solver_note_clue(sstate);
+    }
+    sstate->clue_face = -1;
+}
+
 static int loop_deductions(solver_state *sstate)
 {
     int edgecount = 0, clues = 0, satclues = 0, sm1clues = 0;
@@ -2748,6 +3070,8 @@ static int loop_deductions(solver_state *sstate)
         progress = TRUE;
         goto finished_loop_deductionsing;
     }
+    if (shortest_chainlen == edgecount)
+        loop_note_clues(sstate, NULL);
 
     /*
      * Now go through looking for LINE_UNKNOWN edges which
@@ -2779,6 +3103,8 @@ static int loop_deductions(solver_state *sstate)
         if (sstate->looplen[eqclass] == edgecount + 1) {
             int sm1_nearby;
 
+            loop_note_clues(sstate, e);
+
             /*
              * This edge would form a loop which
              * took in all the edges in the entire
@@ -2844,15 +3170,11 @@ static int loop_deductions(solver_state *sstate)
     return progress ? DIFF_EASY : DIFF_MAX;
 }
 
-/* This will return a dynamically allocated solver_state containing the (more)
- * solved grid */
-static solver_state *solve_game_rec(const solver_state *sstate_start)
+/* Runs the solver on sstate in place, carrying on from wherever it had
+ * got to. If 'hist' is non-NULL, a copy of the state is saved in it before
+ * each call to a solver function. */
+static void solver_run(solver_state *sstate, solver_history *hist)
 {
-    solver_state *sstate;
-
-    /* Index of the solver we should call next. */
-    int i = 0;
-    
     /* As a speed-optimisation, we avoid re-running solvers that we know
      * won't make any progress.  This happens when a high-difficulty
      * solver makes a deduction that can only help other high-difficulty
@@ -2866,38 +3188,43 @@ static solver_state *solve_game_rec(const solver_state *sstate_start)
      * we don't bother running it if it's difficulty level is less than
      * "threshold_diff".
      */
-    int threshold_diff = 0;
-    int threshold_index = 0;
-    
-    sstate = dup_solver_state(sstate_start);
-
     check_caches(sstate);
 
-    while (i < NUM_SOLVERS) {
+    while (sstate->next_solver < NUM_SOLVERS) {
+        /* Index of the solver we should call next. */
+        int i = sstate->next_solver;
+
         if (sstate->solver_status == SOLVER_MISTAKE)
-            return sstate;
+            return;
         if (sstate->solver_status == SOLVER_SOLVED ||
             sstate->solver_status == SOLVER_AMBIGUOUS) {
             /* solver finished */
             break;
         }
 
-        if ((solver_diffs[i] >= threshold_diff || i >= threshold_index)
+        if ((solver_diffs[i] >= sstate->threshold_diff ||
+             i >= sstate->threshold_index)
             && solver_diffs[i] <= sstate->diff) {
             /* current_solver is eligible, so use it */
-            int next_diff = solver_fns[i](sstate);
+            int next_diff;
+
+            if (hist)
+                solver_history_save(hist, sstate);
+            sstate->clue_face = -1;
+            next_diff = solver_fns[i](sstate);
+            sstate->nsteps++;
             if (next_diff != DIFF_MAX) {
                 /* solver made progress, so use new thresholds and
                 * start again at top of list. */
-                threshold_diff = next_diff;
-                threshold_index = i;
-                i = 0;
+                sstate->threshold_diff = next_diff;
+                sstate->threshold_index = i;
+                sstate->next_solver = 0;
                 continue;
             }
         }
         /* current_solver is ineligible, or failed to make progress, so
          * go to the next solver in the list */
-        i++;
+        sstate->next_solver++;
     }
 
     if (sstate->solver_status == SOLVER_SOLVED ||
@@ -2905,8 +3232,16 @@ static solver_state *solve_game_rec(const solver_state *sstate_start)
         /* s/LINE_UNKNOWN/LINE_NO/g */
         array_setall(sstate->state->lines, LINE_UNKNOWN, LINE_NO,
                      sstate->state->game_grid->num_edges);
-        return sstate;
     }
+}
+
+/* This will return a dynamically allocated solver_state containing the (more)
+ * solved grid */
+static solver_state *solve_game_rec(const solver_state *sstate_start)
+{
+    solver_state *sstate = dup_solver_state(sstate_start);
+
+    solver_run(sstate, NULL);
 
     return sstate;
 }
@@ -3652,6 +3987,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     1, solve_game,
     TRUE, game_can_format_as_text_now, game_text_format,
     new_ui,
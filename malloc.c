@@ -6,12 +6,44 @@
 #include <string.h>
 #include "puzzles.h"
 
+#if defined MALLOC_STATS && \
+    (defined SOLO_PARALLEL || defined MINES_SPECULATE || \
+     defined MIDEND_POOL || defined GENERATE_JOBS)
+#define MALLOC_STATS_LOCKED
+#include <pthread.h>
+#endif
+
+#ifdef MALLOC_STATS
+/*
+ * Allocation statistics for the benchmark program. In builds with
+ * the threaded code, allocations made by worker threads count too,
+ * so the counters need a lock.
+ */
+unsigned long smalloc_count, smalloc_bytes;
+#ifdef MALLOC_STATS_LOCKED
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static void count_alloc(size_t size)
+{
+    pthread_mutex_lock(&stats_lock);
+    smalloc_count++;
+    smalloc_bytes += size;
+    pthread_mutex_unlock(&stats_lock);
+}
+#define COUNT_ALLOC(size) count_alloc(size)
+#else
+#define COUNT_ALLOC(size) (smalloc_count++, smalloc_bytes += (size))
+#endif
+#else
+#define COUNT_ALLOC(size) ((void)0)
+#endif
+
 /*
  * smalloc should guarantee to return a useful pointer - Halibut
  * can do nothing except die when it's out of memory anyway.
  */
 void *smalloc(size_t size) {
     void *p;
+    COUNT_ALLOC(size);
     p = malloc(size);
     if (!p)
 	fatal("out of memory");
@@ -32,6 +64,7 @@ void sfree(void *p) {
  */
 void *srealloc(void *p, size_t size) {
     void *q;
+    COUNT_ALLOC(size);
     if (p) {
 	q = realloc(p, size);
     } else {
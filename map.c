@@ -78,12 +78,32 @@ struct game_params {
     int w, h, n, diff;
 };
 
+/*
+ * Indexes into a graph's sorted edge list, built alongside it by
+ * gengraph() so that the solver and the colourer never need to
+ * binary-search it: the neighbours of vertex i are the edges from
+ * start[i] up to start[i+1], and adj[] is the adjacency matrix as a
+ * bitmap of 'words' words per vertex, for constant-time adjacency
+ * tests and word-at-a-time common neighbour searches.
+ */
+#define GRAPH_WORDBITS 32
+struct graphidx {
+    int *start;
+    unsigned long *adj;
+    int words;
+};
+
+#define graph_adjacent(gx, i, j) \
+    (((gx)->adj[(i)*(gx)->words + (j)/GRAPH_WORDBITS] >> \
+      ((j)%GRAPH_WORDBITS)) & 1)
+
 struct map {
     int refcount;
     int *map;
     int *graph;
     int n;
     int ngraph;
+    struct graphidx gx;
     int *immutable;
     int *edgex, *edgey;		       /* position of a point on each edge */
     int *regionx, *regiony;            /* position of a point in each region */
@@ -597,9 +617,11 @@ static void genmap(int w, int h, int n, int *map, random_state *rs)
 
 /*
  * Having got a map in a square grid, convert it into a graph
- * representation.
+ * representation, and fill in *gx (freeing anything already in it)
+ * to index it.
  */
-static int gengraph(int w, int h, int n, int *map, int *graph)
+static int gengraph(int w, int h, int n, int *map, int *graph,
+                    struct graphidx *gx)
 {
     int i, j, x, y;
 
@@ -624,15 +646,39 @@ static int gengraph(int w, int h, int n, int *map, int *graph)
 	}
 
     /*
-     * Turn the matrix into a list.
+     * Copy the matrix into the bitmap, and then turn it into a list,
+     * noting where each vertex's part of the list starts.
      */
-    for (i = j = 0; i < n*n; i++)
-	if (graph[i])
+    sfree(gx->start);
+    sfree(gx->adj);
+    gx->words = (n + GRAPH_WORDBITS - 1) / GRAPH_WORDBITS;
+    gx->start = snewn(n+1, int);
+    gx->adj = snewn(n * gx->words, unsigned long);
+    for (i = 0; i < n * gx->words; i++)
+        gx->adj[i] = 0;
+
+    for (i = j = 0; i < n*n; i++) {
+        if (i % n == 0)
+            gx->start[i / n] = j;
+	if (graph[i]) {
+            gx->adj[(i/n) * gx->words + (i%n) / GRAPH_WORDBITS] |=
+                1UL << ((i%n) % GRAPH_WORDBITS);
 	    graph[j++] = i;
+        }
+    }
+    gx->start[n] = j;
 
     return j;
 }
 
+static void free_graphidx(struct graphidx *gx)
+{
+    sfree(gx->start);
+    sfree(gx->adj);
+    gx->start = NULL;
+    gx->adj = NULL;
+}
+
 static int graph_edge_index(int *graph, int n, int ngraph, int i, int j)
 {
     int v = i*n+j;
@@ -652,26 +698,6 @@ static int graph_edge_index(int *graph, int n, int ngraph, int i, int j)
     return -1;
 }
 
-#define graph_adjacent(graph, n, ngraph, i, j) \
-    (graph_edge_index((graph), (n), (ngraph), (i), (j)) >= 0)
-
-static int graph_vertex_start(int *graph, int n, int ngraph, int i)
-{
-    int v = i*n;
-    int top, bot, mid;
-
-    bot = -1;
-    top = ngraph;
-    while (top - bot > 1) {
-	mid = (top + bot) / 2;
-	if (graph[mid] < v)
-	    bot = mid;
-	else
-	    top = mid;
-    }
-    return top;
-}
-
 /* ----------------------------------------------------------------------
  * Generate a four-colouring of a graph.
  *
@@ -680,10 +706,10 @@ static int graph_vertex_start(int *graph, int n, int ngraph, int i)
  * the sake of the Palm port and its limited stack.
  */
 
-static int fourcolour_recurse(int *graph, int n, int ngraph,
+static int fourcolour_recurse(int *graph, const struct graphidx *gx, int n,
 			      int *colouring, int *scratch, random_state *rs)
 {
-    int nfree, nvert, start, i, j, k, c, ci;
+    int nfree, nvert, start, end, i, j, k, c, ci;
     int cs[FOUR];
 
     /*
@@ -717,7 +743,8 @@ static int fourcolour_recurse(int *graph, int n, int ngraph,
 	    if (j-- == 0)
 		break;
     assert(i < n);
-    start = graph_vertex_start(graph, n, ngraph, i);
+    start = gx->start[i];
+    end = gx->start[i+1];
 
     /*
      * Loop over the possible colours for i, and recurse for each
@@ -741,7 +768,7 @@ static int fourcolour_recurse(int *graph, int n, int ngraph,
 	 * Update the scratch space to reflect a new neighbour
 	 * of this colour for each neighbour of vertex i.
 	 */
-	for (j = start; j < ngraph && graph[j] < n*(i+1); j++) {
+	for (j = start; j < end; j++) {
 	    k = graph[j] - i*n;
 	    if (scratch[k*FIVE+c] == 0)
 		scratch[k*FIVE+FOUR]--;
@@ -751,14 +778,14 @@ static int fourcolour_recurse(int *graph, int n, int ngraph,
 	/*
 	 * Recurse.
 	 */
-	if (fourcolour_recurse(graph, n, ngraph, colouring, scratch, rs))
+	if (fourcolour_recurse(graph, gx, n, colouring, scratch, rs))
 	    return TRUE;	       /* got one! */
 
 	/*
 	 * If that didn't work, clean up and try again with a
 	 * different colour.
 	 */
-	for (j = start; j < ngraph && graph[j] < n*(i+1); j++) {
+	for (j = start; j < end; j++) {
 	    k = graph[j] - i*n;
 	    scratch[k*FIVE+c]--;
 	    if (scratch[k*FIVE+c] == 0)
@@ -778,8 +805,8 @@ static int fourcolour_recurse(int *graph, int n, int ngraph,
     return FALSE;
 }
 
-static void fourcolour(int *graph, int n, int ngraph, int *colouring,
-		       random_state *rs)
+static void fourcolour(int *graph, const struct graphidx *gx, int n,
+                       int *colouring, random_state *rs)
 {
     int *scratch;
     int i;
@@ -799,7 +826,7 @@ static void fourcolour(int *graph, int n, int ngraph, int *colouring,
     for (i = 0; i < n; i++)
 	colouring[i] = -1;
 
-    i = fourcolour_recurse(graph, n, ngraph, colouring, scratch, rs);
+    i = fourcolour_recurse(graph, gx, n, colouring, scratch, rs);
     assert(i);			       /* by the Four Colour Theorem :-) */
 
     sfree(scratch);
@@ -813,6 +840,7 @@ struct solver_scratch {
     unsigned char *possible;	       /* bitmap of colours for each region */
 
     int *graph;
+    const struct graphidx *gx;
     int n;
     int ngraph;
 
@@ -825,12 +853,15 @@ struct solver_scratch {
     int depth;
 };
 
-static struct solver_scratch *new_scratch(int *graph, int n, int ngraph)
+static struct solver_scratch *new_scratch(int *graph,
+                                          const struct graphidx *gx,
+                                          int n, int ngraph)
 {
     struct solver_scratch *sc;
 
     sc = snew(struct solver_scratch);
     sc->graph = graph;
+    sc->gx = gx;
     sc->n = n;
     sc->ngraph = ngraph;
     sc->possible = snewn(n, unsigned char);
@@ -877,7 +908,7 @@ static int place_colour(struct solver_scratch *sc,
 #endif
                         )
 {
-    int *graph = sc->graph, n = sc->n, ngraph = sc->ngraph;
+    int *graph = sc->graph, n = sc->n;
     int j, k;
 
     if (!(sc->possible[index] & (1 << colour))) {
@@ -901,8 +932,7 @@ static int place_colour(struct solver_scratch *sc,
     /*
      * Rule out this colour from all the region's neighbours.
      */
-    for (j = graph_vertex_start(graph, n, ngraph, index);
-	 j < ngraph && graph[j] < n*(index+1); j++) {
+    for (j = sc->gx->start[index]; j < sc->gx->start[index+1]; j++) {
 	k = graph[j] - index*n;
 #ifdef SOLVER_DIAGNOSTICS
         if (verbose && (sc->possible[k] & (1 << colour)))
@@ -941,6 +971,7 @@ static int map_solver(struct solver_scratch *sc,
 		      int *graph, int n, int ngraph, int *colouring,
                       int difficulty)
 {
+    const struct graphidx *gx = sc->gx;
     int i;
 
     if (sc->depth == 0) {
@@ -1039,6 +1070,7 @@ static int map_solver(struct solver_scratch *sc,
         for (i = 0; i < ngraph; i++) {
             int j1 = graph[i] / n, j2 = graph[i] % n;
             int j, k, v, v2;
+            unsigned long common;
 #ifdef SOLVER_DIAGNOSTICS
             int started = FALSE;
 #endif
@@ -1069,28 +1101,32 @@ static int map_solver(struct solver_scratch *sc,
              * Therefore, if they are both adjacent to any other
              * region then that region cannot be either colour.
              * 
-             * Go through the neighbours of j1 and see if any are
-             * shared with j2.
+             * Find the neighbours shared by j1 and j2, a word of the
+             * adjacency bitmap at a time.
              */
-            for (j = graph_vertex_start(graph, n, ngraph, j1);
-                 j < ngraph && graph[j] < n*(j1+1); j++) {
-                k = graph[j] - j1*n;
-                if (graph_adjacent(graph, n, ngraph, k, j2) &&
-                    (sc->possible[k] & v)) {
+            for (j = 0; j < gx->words; j++) {
+                common = (gx->adj[j1 * gx->words + j] &
+                          gx->adj[j2 * gx->words + j]);
+                for (k = j * GRAPH_WORDBITS; common; k++, common >>= 1) {
+                    if (!(common & 1))
+                        continue;
+                    if (sc->possible[k] & v) {
 #ifdef SOLVER_DIAGNOSTICS
-                    if (verbose) {
-                        char buf[80];
-                        if (!started)
-                            printf("%*sadjacent regions %d,%d share colours"
-                                   " %s\n", 2*sc->depth, "", j1, j2,
-                                   colourset(buf, v));
-                        started = TRUE;
-                        printf("%*s  ruling out %s in region %d\n",2*sc->depth,
-                               "", colourset(buf, sc->possible[k] & v), k);
-                    }
+                        if (verbose) {
+                            char buf[80];
+                            if (!started)
+                                printf("%*sadjacent regions %d,%d share "
+                                       "colours %s\n", 2*sc->depth, "",
+                                       j1, j2, colourset(buf, v));
+                            started = TRUE;
+                            printf("%*s  ruling out %s in region %d\n",
+                                   2*sc->depth, "",
+                                   colourset(buf, sc->possible[k] & v), k);
+                        }
 #endif
-                    sc->possible[k] &= ~v;
-                    done_something = TRUE;
+                        sc->possible[k] &= ~v;
+                        done_something = TRUE;
+                    }
                 }
             }
         }
@@ -1177,8 +1213,7 @@ static int map_solver(struct solver_scratch *sc,
                         /*
                          * Try neighbours of j.
                          */
-                        for (gi = graph_vertex_start(graph, n, ngraph, j);
-                             gi < ngraph && graph[gi] < n*(j+1); gi++) {
+                        for (gi = gx->start[j]; gi < gx->start[j+1]; gi++) {
                             k = graph[gi] - j*n;
 
                             /*
@@ -1210,7 +1245,7 @@ static int map_solver(struct solver_scratch *sc,
                              * the original colour we ruled out.
                              */
                             if (currc == origc &&
-                                graph_adjacent(graph, n, ngraph, k, i) &&
+                                graph_adjacent(gx, k, i) &&
                                 (sc->possible[k] & currc)) {
 #ifdef SOLVER_DIAGNOSTICS
                                 if (verbose) {
@@ -1310,7 +1345,7 @@ static int map_solver(struct solver_scratch *sc,
         /*
          * Now iterate over the possible colours for this region.
          */
-        rsc = new_scratch(graph, n, ngraph);
+        rsc = new_scratch(graph, gx, n, ngraph);
         rsc->depth = sc->depth + 1;
         origcolouring = snewn(n, int);
         memcpy(origcolouring, colouring, n * sizeof(int));
@@ -1393,6 +1428,7 @@ static char *new_game_desc(const game_params *params, random_state *rs,
 			   char **aux, int interactive)
 {
     struct solver_scratch *sc = NULL;
+    struct graphidx gx;
     int *map, *graph, ngraph, *colouring, *colouring2, *regions;
     int i, j, w, h, n, solveret, cfreq[FOUR];
     int wh;
@@ -1412,6 +1448,8 @@ static char *new_game_desc(const game_params *params, random_state *rs,
 
     map = snewn(wh, int);
     graph = snewn(n*n, int);
+    gx.start = NULL;
+    gx.adj = NULL;
     colouring = snewn(n, int);
     colouring2 = snewn(n, int);
     regions = snewn(n, int);
@@ -1455,7 +1493,7 @@ static char *new_game_desc(const game_params *params, random_state *rs,
         /*
          * Convert the map into a graph.
          */
-        ngraph = gengraph(w, h, n, map, graph);
+        ngraph = gengraph(w, h, n, map, graph, &gx);
 
 #ifdef GENERATION_DIAGNOSTICS
         for (i = 0; i < ngraph; i++)
@@ -1465,7 +1503,7 @@ static char *new_game_desc(const game_params *params, random_state *rs,
         /*
          * Colour the map.
          */
-        fourcolour(graph, n, ngraph, colouring, rs);
+        fourcolour(graph, &gx, n, colouring, rs);
 
 #ifdef GENERATION_DIAGNOSTICS
         for (i = 0; i < n; i++)
@@ -1527,7 +1565,7 @@ static char *new_game_desc(const game_params *params, random_state *rs,
         shuffle(regions, n, sizeof(*regions), rs);
 
         if (sc) free_scratch(sc);
-        sc = new_scratch(graph, n, ngraph);
+        sc = new_scratch(graph, &gx, n, ngraph);
 
         for (i = 0; i < n; i++) {
             j = regions[i];
@@ -1694,6 +1732,7 @@ static char *new_game_desc(const game_params *params, random_state *rs,
     sfree(regions);
     sfree(colouring2);
     sfree(colouring);
+    free_graphidx(&gx);
     sfree(graph);
     sfree(map);
 
@@ -1834,6 +1873,8 @@ static game_state *new_game(midend *me, const game_params *params,
     state->map->refcount = 1;
     state->map->map = snewn(wh*4, int);
     state->map->graph = snewn(n*n, int);
+    state->map->gx.start = NULL;
+    state->map->gx.adj = NULL;
     state->map->n = n;
     state->map->immutable = snewn(n, int);
     for (i = 0; i < n; i++)
@@ -1873,7 +1914,8 @@ static game_state *new_game(midend *me, const game_params *params,
     }
     assert(pos == n);
 
-    state->map->ngraph = gengraph(w, h, n, state->map->map, state->map->graph);
+    state->map->ngraph = gengraph(w, h, n, state->map->map, state->map->graph,
+                                  &state->map->gx);
 
     /*
      * Attempt to smooth out some of the more jagged region
@@ -2174,6 +2216,7 @@ static void free_game(game_state *state)
     if (--state->map->refcount <= 0) {
 	sfree(state->map->map);
 	sfree(state->map->graph);
+	free_graphidx(&state->map->gx);
 	sfree(state->map->immutable);
 	sfree(state->map->edgex);
 	sfree(state->map->edgey);
@@ -2203,7 +2246,8 @@ static char *solve_game(const game_state *state, const game_state *currstate,
 	colouring = snewn(state->map->n, int);
 	memcpy(colouring, state->colouring, state->map->n * sizeof(int));
 
-	sc = new_scratch(state->map->graph, state->map->n, state->map->ngraph);
+	sc = new_scratch(state->map->graph, &state->map->gx,
+                         state->map->n, state->map->ngraph);
 	sret = map_solver(sc, state->map->graph, state->map->n,
 			 state->map->ngraph, colouring, DIFFCOUNT-1);
 	free_scratch(sc);
@@ -3230,6 +3274,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     TRUE, solve_game,
     FALSE, game_can_format_as_text_now, game_text_format,
     new_ui,
@@ -3301,7 +3346,7 @@ int main(int argc, char **argv)
     }
     s = new_game(NULL, p, desc);
 
-    sc = new_scratch(s->map->graph, s->map->n, s->map->ngraph);
+    sc = new_scratch(s->map->graph, &s->map->gx, s->map->n, s->map->ngraph);
 
     /*
      * When solving an Easy puzzle, we don't want to bother the
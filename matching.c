@@ -0,0 +1,143 @@
+/*
+ * Hopcroft-Karp algorithm for maximum bipartite matching. See
+ * matching.h for the interface.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "matching.h"
+
+#include "puzzles.h"		       /* for snewn/sfree */
+
+int matching_scratch_size(int nl, int nr)
+{
+    /* Lmatch, Rmatch, layer, queue/stack and adjacency position. */
+    return (4 * nl + nr) * sizeof(int);
+}
+
+int matching_with_scratch(void *scratch, int nl, int nr,
+			  int **adjlists, const int *adjsizes,
+			  int *outl, int *outr)
+{
+    int *Lmatch = (int *)scratch;
+    int *Rmatch = Lmatch + nl;
+    int *layer = Rmatch + nr;
+    int *todo = layer + nl;
+    int *pos = todo + nl;
+    int i, head, tail, sp, size, found;
+
+    for (i = 0; i < nl; i++)
+	Lmatch[i] = -1;
+    for (i = 0; i < nr; i++)
+	Rmatch[i] = -1;
+    size = 0;
+
+    while (1) {
+	/*
+	 * Breadth-first search from all the unmatched left vertices
+	 * at once, alternating unmatched and matched edges, to find
+	 * the length of the shortest augmenting path. `layer' ends up
+	 * holding each left vertex's distance along such paths, or -1
+	 * if it can't be on a shortest one. `found' is the layer in
+	 * which the paths end, at which point we stop searching.
+	 */
+	head = tail = 0;
+	for (i = 0; i < nl; i++) {
+	    if (Lmatch[i] < 0) {
+		layer[i] = 0;
+		todo[tail++] = i;
+	    } else {
+		layer[i] = -1;
+	    }
+	}
+	found = -1;
+	while (head < tail) {
+	    int u = todo[head++], j;
+
+	    if (found >= 0 && layer[u] >= found)
+		break;
+	    for (j = 0; j < adjsizes[u]; j++) {
+		int w = Rmatch[adjlists[u][j]];
+		if (w < 0) {
+		    found = layer[u];
+		} else if (layer[w] < 0) {
+		    layer[w] = layer[u] + 1;
+		    todo[tail++] = w;
+		}
+	    }
+	}
+	if (found < 0)
+	    break;		       /* no augmenting paths left */
+
+	/*
+	 * Now depth-first search from each unmatched left vertex,
+	 * following the layers, to find a maximal set of disjoint
+	 * augmenting paths. We keep each vertex's position in its
+	 * adjacency list across searches, since an edge which leads
+	 * nowhere in this phase will go on leading nowhere; and a
+	 * vertex whose list is used up is taken out of the layers.
+	 *
+	 * `todo' is reused as the stack of left vertices on the
+	 * current path; the right vertex between each one and the next
+	 * is the edge just before its position in its list.
+	 */
+	for (i = 0; i < nl; i++)
+	    pos[i] = 0;
+	for (i = 0; i < nl; i++) {
+	    if (Lmatch[i] >= 0 || layer[i] != 0)
+		continue;
+	    todo[0] = i;
+	    sp = 1;
+	    while (sp > 0) {
+		int u = todo[sp-1], v, w;
+
+		if (pos[u] == adjsizes[u]) {
+		    layer[u] = -1;     /* dead end */
+		    sp--;
+		    continue;
+		}
+		v = adjlists[u][pos[u]++];
+		w = Rmatch[v];
+		if (w < 0) {
+		    if (layer[u] != found)
+			continue;      /* not a shortest path */
+		    /* Augment along the path on the stack. */
+		    while (sp > 0) {
+			u = todo[--sp];
+			v = adjlists[u][pos[u]-1];
+			Lmatch[u] = v;
+			Rmatch[v] = u;
+		    }
+		    size++;
+		} else if (layer[w] == layer[u] + 1) {
+		    todo[sp++] = w;
+		}
+	    }
+	}
+    }
+
+    if (outl)
+	for (i = 0; i < nl; i++)
+	    outl[i] = Lmatch[i];
+    if (outr)
+	for (i = 0; i < nr; i++)
+	    outr[i] = Rmatch[i];
+
+    return size;
+}
+
+int matching(int nl, int nr, int **adjlists, const int *adjsizes,
+	     int *outl, int *outr)
+{
+    void *scratch;
+    int ret;
+
+    scratch = smalloc(matching_scratch_size(nl, nr));
+    ret = matching_with_scratch(scratch, nl, nr, adjlists, adjsizes,
+				outl, outr);
+    sfree(scratch);
+
+    return ret;
+}
@@ -0,0 +1,68 @@
+/*
+ * Hopcroft-Karp algorithm for finding a maximum matching in a
+ * bipartite graph. Each phase finds a maximal set of disjoint
+ * shortest augmenting paths at once, using a breadth-first search
+ * to layer the graph and then depth-first searches along the
+ * layers, so only O(sqrt(V)) phases are needed. That makes it a lot
+ * faster than setting up the matching as a network and running
+ * maxflow.c on it.
+ */
+
+#ifndef MATCHING_MATCHING_H
+#define MATCHING_MATCHING_H
+
+/*
+ * The actual algorithm.
+ *
+ * Inputs:
+ *
+ *  - `scratch' is previously allocated scratch space of a size
+ *    previously determined by calling `matching_scratch_size'.
+ *
+ *  - `nl' and `nr' are the numbers of vertices on the left and
+ *    right sides of the graph. Vertices on each side are assumed to
+ *    be numbered from 0 upwards.
+ *
+ *  - `adjlists' is an array of `nl' pointers, one for each left
+ *    vertex, each pointing to a list of the right vertices it is
+ *    connected to.
+ *
+ *  - `adjsizes' is an array of `nl' integers, giving the length of
+ *    each list in `adjlists'.
+ *
+ * The algorithm is deterministic, and tends to prefer edges which
+ * come earlier in their adjacency lists. If you want a random
+ * matching, shuffle the lists (or number the vertices in a random
+ * order) before calling it.
+ *
+ * Output:
+ *
+ *  - `outl' may be NULL. If non-NULL, it is an array of `nl'
+ *    integers, each giving the right vertex matched to that left
+ *    vertex, or -1 if it is unmatched.
+ *
+ *  - `outr' likewise, if non-NULL, is an array of `nr' integers
+ *    giving the left vertex matched to each right vertex, or -1.
+ *
+ *  - the returned value from the function is the number of edges in
+ *    the matching.
+ */
+int matching_with_scratch(void *scratch, int nl, int nr,
+			  int **adjlists, const int *adjsizes,
+			  int *outl, int *outr);
+
+/*
+ * The above function expects its `scratch' parameter to have
+ * already been set up, so that you can allocate it once and use it
+ * for multiple runs. This function tells you how big it must be.
+ */
+int matching_scratch_size(int nl, int nr);
+
+/*
+ * Simplified version of the above function, which allocates and
+ * frees its own scratch space.
+ */
+int matching(int nl, int nr, int **adjlists, const int *adjsizes,
+	     int *outl, int *outr);
+
+#endif /* MATCHING_MATCHING_H */
@@ -11,6 +11,10 @@
 #include <stdlib.h>
 #include <ctype.h>
 
+#ifdef MIDEND_POOL
+#include <pthread.h>
+#endif
+
 #include "puzzles.h"
 
 enum { DEF_PARAMS, DEF_SEED, DEF_DESC };   /* for midend_game_id_int */
@@ -92,6 +96,25 @@ struct midend {
 
     void (*game_id_change_notify_function)(void *);
     void *game_id_change_notify_ctx;
+
+    int fast_random;           /* generate from seeds with random_new_fast */
+
+    /*
+     * If keyframe_interval is nonzero, we don't keep a game_state
+     * for every entry in `states'. Entries whose index is a multiple
+     * of keyframe_interval are kept, as are all the entries which
+     * aren't ordinary moves (a RESTART state can't be rebuilt by
+     * execute_move) and the few either side of statepos; the rest
+     * have their `state' field set to NULL and are rebuilt by
+     * replaying move strings when they're next wanted. See
+     * midend_state() and midend_trim_states().
+     */
+    int keyframe_interval;
+
+    int pool_size;             /* puzzles to generate in advance, or 0 */
+#ifdef MIDEND_POOL
+    struct midend_pool *pool;  /* puzzles generated in advance, or NULL */
+#endif
 };
 
 #define ensure(me) do { \
@@ -115,6 +138,7 @@ struct deserialise_data {
     game_params *params, *cparams;
     game_ui *ui;
     struct midend_state_entry *states;
+    char **snapshots;                  /* NULL if the file had none */
     int nstates, statepos;
 };
 
@@ -125,6 +149,10 @@ static const char *midend_deserialise_internal(
     midend *me, int (*read)(void *ctx, void *buf, int len), void *rctx,
     const char *(*check)(void *ctx, midend *, const struct deserialise_data *),
     void *cctx);
+#ifdef MIDEND_POOL
+static void midend_pool_flush(midend *me);
+static void midend_pool_stop(struct midend_pool *pool);
+#endif
 
 void midend_reset_tilesize(midend *me)
 {
@@ -171,6 +199,22 @@ midend *midend_new(frontend *fe, const game *ourgame,
     me->params = ourgame->default_params();
     me->game_id_change_notify_function = NULL;
     me->game_id_change_notify_ctx = NULL;
+    me->fast_random = FALSE;
+    me->keyframe_interval = 0;
+    me->pool_size = 0;
+#ifdef MIDEND_POOL
+    me->pool = NULL;
+#endif
+    {
+        /*
+         * Allow compact undo to be turned on from the environment,
+         * by defining PUZZLES_UNDO_KEYFRAMES to the interval wanted.
+         */
+        char *e = getenv("PUZZLES_UNDO_KEYFRAMES");
+        int k;
+        if (e && sscanf(e, "%d", &k) == 1 && k > 0)
+            me->keyframe_interval = k;
+    }
 
     /*
      * Allow environment-based changing of the default settings by
@@ -225,7 +269,8 @@ const game *midend_which_game(midend *me)
 static void midend_purge_states(midend *me)
 {
     while (me->nstates > me->statepos) {
-        me->ourgame->free_game(me->states[--me->nstates].state);
+        if (me->states[--me->nstates].state)
+            me->ourgame->free_game(me->states[me->nstates].state);
         if (me->states[me->nstates].movestr)
             sfree(me->states[me->nstates].movestr);
     }
@@ -236,7 +281,8 @@ static void midend_free_game(midend *me)
 {
     while (me->nstates > 0) {
         me->nstates--;
-	me->ourgame->free_game(me->states[me->nstates].state);
+        if (me->states[me->nstates].state)
+            me->ourgame->free_game(me->states[me->nstates].state);
 	sfree(me->states[me->nstates].movestr);
     }
 
@@ -244,6 +290,57 @@ static void midend_free_game(midend *me)
         me->ourgame->free_drawstate(me->drawing, me->drawstate);
 }
 
+/*
+ * Return the game state at a given position in the undo chain,
+ * rebuilding it from the nearest earlier state we still have if it
+ * was discarded by midend_trim_states(), or never built when loading
+ * a binary save file. Any states rebuilt on the
+ * way are kept until the next trim, so that stepping through them
+ * one at a time doesn't replay the same moves over and over.
+ */
+static game_state *midend_state(midend *me, int i)
+{
+    int j;
+
+    assert(i >= 0 && i < me->nstates);
+    if (me->states[i].state)
+        return me->states[i].state;
+
+    for (j = i; !me->states[j].state; j--)
+        assert(j > 0);                 /* states[0] is never discarded */
+    for (j++; j <= i; j++) {
+        assert(me->states[j].movetype == MOVE ||
+               me->states[j].movetype == SOLVE);
+        me->states[j].state = me->ourgame->execute_move(
+            me->states[j-1].state, me->states[j].movestr);
+        assert(me->states[j].state);
+    }
+
+    return me->states[i].state;
+}
+
+/*
+ * Discard the game states we don't need to keep under compact undo
+ * (see the comment on keyframe_interval), so that between any two
+ * keyframes at most the states around statepos are held in memory.
+ */
+static void midend_trim_states(midend *me)
+{
+    int i;
+
+    if (!me->keyframe_interval)
+        return;
+
+    for (i = 1; i < me->nstates; i++) {
+        if (!me->states[i].state || me->states[i].movetype != MOVE ||
+            i % me->keyframe_interval == 0 ||
+            (i >= me->statepos - 2 && i <= me->statepos))
+            continue;
+        me->ourgame->free_game(me->states[i].state);
+        me->states[i].state = NULL;
+    }
+}
+
 static void midend_free_preset_menu(midend *me, struct preset_menu *menu)
 {
     if (menu) {
@@ -261,6 +358,10 @@ static void midend_free_preset_menu(midend *me, struct preset_menu *menu)
 
 void midend_free(midend *me)
 {
+#ifdef MIDEND_POOL
+    if (me->pool)
+        midend_pool_stop(me->pool);
+#endif
     midend_free_game(me);
 
     if (me->drawing)
@@ -310,7 +411,7 @@ void midend_size(midend *me, int *x, int *y, int user_size)
     if (me->drawstate && me->tilesize > 0) {
         me->ourgame->free_drawstate(me->drawing, me->drawstate);
         me->drawstate = me->ourgame->new_drawstate(me->drawing,
-                                                   me->states[0].state);
+                                                   midend_state(me, 0));
     }
 
     /*
@@ -366,6 +467,10 @@ void midend_set_params(midend *me, game_params *params)
 {
     me->ourgame->free_params(me->params);
     me->params = me->ourgame->dup_params(params);
+#ifdef MIDEND_POOL
+    if (me->pool)
+        midend_pool_flush(me);
+#endif
 }
 
 game_params *midend_get_params(midend *me)
@@ -376,7 +481,7 @@ game_params *midend_get_params(midend *me)
 static void midend_set_timer(midend *me)
 {
     me->timing = (me->ourgame->is_timed &&
-		  me->ourgame->timing_state(me->states[me->statepos-1].state,
+		  me->ourgame->timing_state(midend_state(me, me->statepos-1),
 					    me->ui));
     if (me->timing || me->flash_time || me->anim_time)
 	activate_timer(me->frontend);
@@ -389,7 +494,7 @@ void midend_force_redraw(midend *me)
     if (me->drawstate)
         me->ourgame->free_drawstate(me->drawing, me->drawstate);
     me->drawstate = me->ourgame->new_drawstate(me->drawing,
-					       me->states[0].state);
+					       midend_state(me, 0));
     midend_size_new_drawstate(me);
     midend_redraw(me);
 }
@@ -409,6 +514,388 @@ static void newgame_serialise_write(void *ctx, const void *buf, int len)
     ser->len = new_len;
 }
 
+/*
+ * Generate a new random seed. 15 digits comes to about 48 bits, which
+ * should be more than enough.
+ *
+ * I'll avoid putting a leading zero on the number, just in case it
+ * confuses anybody who thinks it's processed as an integer rather
+ * than a string.
+ */
+static char *midend_new_seed(midend *me)
+{
+    char newseed[16];
+    int i;
+
+    newseed[15] = '\0';
+    newseed[0] = '1' + (char)random_upto(me->random, 9);
+    for (i = 1; i < 15; i++)
+        newseed[i] = '0' + (char)random_upto(me->random, 10);
+    return dupstr(newseed);
+}
+
+static char *midend_generate(const game *ourgame, const game_params *params,
+                             const char *seedstr, int fast_random,
+                             char **aux_info, int interactive)
+{
+    random_state *rs;
+    char *desc;
+
+    if (fast_random)
+        rs = random_new_fast(seedstr, strlen(seedstr));
+    else
+        rs = random_new(seedstr, strlen(seedstr));
+    desc = ourgame->new_desc(params, rs, aux_info, interactive);
+    random_free(rs);
+    return desc;
+}
+
+#ifdef MIDEND_POOL
+/*
+ * Puzzle pool, for builds with MIDEND_POOL defined (as the Unix
+ * makefiles do unless told not to use threads; see Recipe). It's off
+ * unless the front end asks for it with midend_set_pool(), or the
+ * PUZZLES_POOL environment variable sets how many puzzles to keep
+ * generated in advance. PUZZLES_POOL_KB caps the memory taken by
+ * their descriptions and aux_info, default 1024. Puzzles still being
+ * generated count towards that as much as the biggest one finished.
+ *
+ * The first time midend_new_game() wants a random puzzle, a worker
+ * thread is started to generate more with the same parameters. Their
+ * seeds are drawn from the midend's random state on the main thread,
+ * just as midend_new_game() would draw them, and the puzzles are
+ * handed out in seed order; so every puzzle is exactly the one the
+ * synchronous path would have produced. If the next puzzle hasn't
+ * been started yet, the midend generates it itself rather than wait.
+ * Changing the parameters or the random number generator throws away
+ * the puzzles generated so far, and their seeds are used again for
+ * the new ones.
+ *
+ * The worker can't be interrupted in the middle of new_desc, so when
+ * the midend is freed it's just told to stop, and whichever of the
+ * two finishes last frees the pool.
+ */
+enum { POOL_QUEUED, POOL_RUNNING, POOL_DONE };
+
+struct midend_pool_entry {
+    unsigned long serial;	       /* identifies the entry to the worker */
+    int status;
+    char *seedstr, *desc, *aux_info;
+};
+
+struct midend_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work, done;
+    int refcount;		       /* the midend, plus the worker */
+    int stopped;
+
+    const game *ourgame;
+    game_params *params;
+    char *parstr;		       /* params, encoded for comparison */
+    int fast_random, interactive;
+
+    int size, nentries;
+    unsigned long serial;	       /* the last one issued */
+    long bytes, maxbytes;	       /* memory held by finished entries */
+    long entrybytes;		       /* the most one has held so far */
+    struct midend_pool_entry *entries; /* in seed order */
+};
+
+/*
+ * Throw away the puzzles generated so far, but keep their seeds
+ * queued, since they've already been drawn from the midend's random
+ * state. New serial numbers make sure that nothing the worker is in
+ * the middle of turns up in the new queue. The caller holds the lock.
+ */
+static void midend_pool_clear(struct midend_pool *pool)
+{
+    int i;
+
+    for (i = 0; i < pool->nentries; i++) {
+	sfree(pool->entries[i].desc);
+	sfree(pool->entries[i].aux_info);
+	pool->entries[i].desc = pool->entries[i].aux_info = NULL;
+	pool->entries[i].serial = ++pool->serial;
+	pool->entries[i].status = POOL_QUEUED;
+    }
+    pool->bytes = pool->entrybytes = 0;
+}
+
+static void midend_pool_free(struct midend_pool *pool)
+{
+    int i;
+
+    for (i = 0; i < pool->nentries; i++) {
+	sfree(pool->entries[i].seedstr);
+	sfree(pool->entries[i].desc);
+	sfree(pool->entries[i].aux_info);
+    }
+    sfree(pool->entries);
+    if (pool->params)
+	pool->ourgame->free_params(pool->params);
+    sfree(pool->parstr);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    sfree(pool);
+}
+
+static void *midend_pool_thread(void *vpool)
+{
+    struct midend_pool *pool = (struct midend_pool *)vpool;
+    int i, last;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopped) {
+	game_params *params;
+	unsigned long serial;
+	char *seedstr, *desc, *aux_info = NULL;
+	int fast_random, interactive;
+
+	for (i = 0; i < pool->nentries; i++)
+	    if (pool->entries[i].status == POOL_QUEUED)
+		break;
+	if (i == pool->nentries) {
+	    pthread_cond_wait(&pool->work, &pool->lock);
+	    continue;
+	}
+
+	pool->entries[i].status = POOL_RUNNING;
+	serial = pool->entries[i].serial;
+	seedstr = dupstr(pool->entries[i].seedstr);
+	params = pool->ourgame->dup_params(pool->params);
+	fast_random = pool->fast_random;
+	interactive = pool->interactive;
+	pthread_mutex_unlock(&pool->lock);
+
+	desc = midend_generate(pool->ourgame, params, seedstr, fast_random,
+			       &aux_info, interactive);
+	pool->ourgame->free_params(params);
+	sfree(seedstr);
+
+	/*
+	 * The entry may have been thrown away while we were working
+	 * on it, in which case so is the puzzle.
+	 */
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < pool->nentries; i++)
+	    if (pool->entries[i].serial == serial)
+		break;
+	if (i < pool->nentries) {
+	    long bytes = strlen(desc) + 1;
+	    pool->entries[i].desc = desc;
+	    pool->entries[i].aux_info = aux_info;
+	    pool->entries[i].status = POOL_DONE;
+	    if (aux_info)
+		bytes += strlen(aux_info) + 1;
+	    pool->bytes += bytes;
+	    if (pool->entrybytes < bytes)
+		pool->entrybytes = bytes;
+	    pthread_cond_broadcast(&pool->done);
+	} else {
+	    sfree(desc);
+	    sfree(aux_info);
+	}
+    }
+    last = (--pool->refcount == 0);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (last)
+	midend_pool_free(pool);
+    return NULL;
+}
+
+static struct midend_pool *midend_pool_new(midend *me)
+{
+    struct midend_pool *pool;
+    pthread_t thread;
+    const char *env = getenv("PUZZLES_POOL");
+    int size = env ? atoi(env) : me->pool_size;
+
+    if (size <= 0)
+	return NULL;
+
+    pool = snew(struct midend_pool);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->refcount = 1;
+    pool->stopped = FALSE;
+    pool->ourgame = me->ourgame;
+    pool->params = NULL;
+    pool->parstr = NULL;
+    pool->fast_random = me->fast_random;
+    pool->interactive = (me->drawing != NULL);
+    pool->size = size;
+    pool->nentries = 0;
+    pool->serial = 0;
+    pool->bytes = pool->entrybytes = 0;
+    env = getenv("PUZZLES_POOL_KB");
+    pool->maxbytes = 1024L * (env ? atoi(env) : 1024);
+    pool->entries = snewn(size, struct midend_pool_entry);
+
+    if (pthread_create(&thread, NULL, midend_pool_thread, pool) != 0) {
+	midend_pool_free(pool);
+	return NULL;
+    }
+    pthread_detach(thread);
+    pool->refcount++;
+
+    return pool;
+}
+
+/*
+ * Bring the pool's parameters and choice of random number generator
+ * up to date with the midend's. The caller holds the lock.
+ */
+static void midend_pool_update(midend *me, struct midend_pool *pool)
+{
+    char *parstr = me->ourgame->encode_params(me->params, TRUE);
+
+    if (!pool->parstr || strcmp(parstr, pool->parstr) ||
+	pool->fast_random != me->fast_random) {
+	midend_pool_clear(pool);
+	if (pool->params)
+	    me->ourgame->free_params(pool->params);
+	pool->params = me->ourgame->dup_params(me->params);
+	sfree(pool->parstr);
+	pool->parstr = parstr;
+	pool->fast_random = me->fast_random;
+	pthread_cond_signal(&pool->work);
+    } else {
+	sfree(parstr);
+    }
+}
+
+static void midend_pool_flush(midend *me)
+{
+    pthread_mutex_lock(&me->pool->lock);
+    midend_pool_update(me, me->pool);
+    pthread_mutex_unlock(&me->pool->lock);
+}
+
+/*
+ * Tell the worker to stop, and drop the midend's reference. If the
+ * worker is still in new_desc, it frees the pool when it finishes.
+ */
+static void midend_pool_stop(struct midend_pool *pool)
+{
+    int last;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopped = TRUE;
+    pthread_cond_broadcast(&pool->work);
+    last = (--pool->refcount == 0);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (last)
+	midend_pool_free(pool);
+}
+
+/*
+ * Whether another puzzle would fit within the pool's memory cap,
+ * reckoning that each one queued or being generated will take as much
+ * as the biggest finished so far. Until one has finished we can't
+ * tell, so we only allow one at a time. The caller holds the lock.
+ */
+static int midend_pool_room(struct midend_pool *pool)
+{
+    long bytes = pool->bytes;
+    int i;
+
+    for (i = 0; i < pool->nentries; i++)
+	if (pool->entries[i].status != POOL_DONE) {
+	    if (!pool->entrybytes)
+		return FALSE;
+	    bytes += pool->entrybytes;
+	}
+    return bytes + pool->entrybytes <= pool->maxbytes;
+}
+
+/*
+ * Queue up more seeds, as long as the pool isn't full. The caller
+ * holds the lock.
+ */
+static void midend_pool_fill(midend *me, struct midend_pool *pool)
+{
+    while (pool->nentries < pool->size && midend_pool_room(pool)) {
+	int i = pool->nentries++;
+	pool->entries[i].serial = ++pool->serial;
+	pool->entries[i].status = POOL_QUEUED;
+	pool->entries[i].seedstr = midend_new_seed(me);
+	pool->entries[i].desc = pool->entries[i].aux_info = NULL;
+    }
+    pthread_cond_signal(&pool->work);
+}
+
+/*
+ * Set up the midend's next random puzzle from the pool, in place of
+ * generating it in midend_new_game(). Returns FALSE if there's no
+ * pool to use.
+ */
+static int midend_pool_take(midend *me)
+{
+    struct midend_pool *pool;
+    char *seedstr, *desc, *aux_info;
+
+    if (!me->pool && !(me->pool = midend_pool_new(me)))
+	return FALSE;
+    pool = me->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    midend_pool_update(me, pool);
+    if (pool->nentries == 0) {
+	/*
+	 * Nothing queued, as happens the first time. Draw this
+	 * puzzle's seed now, but don't start the worker on the
+	 * following ones until we've finished with it.
+	 */
+	seedstr = midend_new_seed(me);
+	desc = aux_info = NULL;
+    } else {
+	if (pool->entries[0].status != POOL_QUEUED)
+	    while (pool->entries[0].status != POOL_DONE)
+		pthread_cond_wait(&pool->done, &pool->lock);
+
+	seedstr = pool->entries[0].seedstr;
+	desc = pool->entries[0].desc;
+	aux_info = pool->entries[0].aux_info;
+	if (desc) {
+	    pool->bytes -= strlen(desc) + 1;
+	    if (aux_info)
+		pool->bytes -= strlen(aux_info) + 1;
+	}
+	pool->nentries--;
+	memmove(pool->entries, pool->entries + 1,
+		pool->nentries * sizeof(struct midend_pool_entry));
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!desc)			       /* not started, so do it ourselves */
+	desc = midend_generate(me->ourgame, me->params, seedstr,
+			       me->fast_random, &aux_info,
+			       (me->drawing != NULL));
+
+    pthread_mutex_lock(&pool->lock);
+    midend_pool_fill(me, pool);
+    pthread_mutex_unlock(&pool->lock);
+
+    sfree(me->seedstr);
+    me->seedstr = seedstr;
+    if (me->curparams)
+	me->ourgame->free_params(me->curparams);
+    me->curparams = me->ourgame->dup_params(me->params);
+    sfree(me->desc);
+    sfree(me->privdesc);
+    sfree(me->aux_info);
+    me->desc = desc;
+    me->privdesc = NULL;
+    me->aux_info = aux_info;
+
+    return TRUE;
+}
+#endif
+
 void midend_new_game(midend *me)
 {
     me->newgame_undo.len = 0;
@@ -428,7 +915,8 @@ void midend_new_game(midend *me)
          * worse, valid but wrong.
          */
         midend_purge_states(me);
-        midend_serialise(me, newgame_serialise_write, &me->newgame_undo);
+        midend_serialise_binary(me, newgame_serialise_write,
+                                &me->newgame_undo);
     }
 
     midend_stop_anim(me);
@@ -438,28 +926,16 @@ void midend_new_game(midend *me)
 
     if (me->genmode == GOT_DESC) {
 	me->genmode = GOT_NOTHING;
+#ifdef MIDEND_POOL
+    } else if (me->genmode == GOT_NOTHING && midend_pool_take(me)) {
+        /* midend_pool_take has set up the seed and description. */
+#endif
     } else {
-        random_state *rs;
-
         if (me->genmode == GOT_SEED) {
             me->genmode = GOT_NOTHING;
         } else {
-            /*
-             * Generate a new random seed. 15 digits comes to about
-             * 48 bits, which should be more than enough.
-             * 
-             * I'll avoid putting a leading zero on the number,
-             * just in case it confuses anybody who thinks it's
-             * processed as an integer rather than a string.
-             */
-            char newseed[16];
-            int i;
-            newseed[15] = '\0';
-            newseed[0] = '1' + (char)random_upto(me->random, 9);
-            for (i = 1; i < 15; i++)
-                newseed[i] = '0' + (char)random_upto(me->random, 10);
             sfree(me->seedstr);
-            me->seedstr = dupstr(newseed);
+            me->seedstr = midend_new_seed(me);
 
 	    if (me->curparams)
 		me->ourgame->free_params(me->curparams);
@@ -471,17 +947,16 @@ void midend_new_game(midend *me)
         sfree(me->aux_info);
 	me->aux_info = NULL;
 
-        rs = random_new(me->seedstr, strlen(me->seedstr));
 	/*
 	 * If this midend has been instantiated without providing a
 	 * drawing API, it is non-interactive. This means that it's
 	 * being used for bulk game generation, and hence we should
 	 * pass the non-interactive flag to new_desc.
 	 */
-        me->desc = me->ourgame->new_desc(me->curparams, rs,
-					 &me->aux_info, (me->drawing != NULL));
+        me->desc = midend_generate(me->ourgame, me->curparams, me->seedstr,
+                                   me->fast_random, &me->aux_info,
+                                   (me->drawing != NULL));
 	me->privdesc = NULL;
-        random_free(rs);
     }
 
     ensure(me);
@@ -528,14 +1003,14 @@ void midend_new_game(midend *me)
     me->nstates++;
     me->statepos = 1;
     me->drawstate = me->ourgame->new_drawstate(me->drawing,
-					       me->states[0].state);
+					       midend_state(me, 0));
     midend_size_new_drawstate(me);
     me->elapsed = 0.0F;
     me->flash_pos = me->flash_time = 0.0F;
     me->anim_pos = me->anim_time = 0.0F;
     if (me->ui)
         me->ourgame->free_ui(me->ui);
-    me->ui = me->ourgame->new_ui(me->states[0].state);
+    me->ui = me->ourgame->new_ui(midend_state(me, 0));
     midend_set_timer(me);
     me->pressed_mouse_button = 0;
 
@@ -633,10 +1108,11 @@ static int midend_undo(midend *me)
     if (me->statepos > 1) {
         if (me->ui)
             me->ourgame->changed_state(me->ui,
-                                       me->states[me->statepos-1].state,
-                                       me->states[me->statepos-2].state);
+                                       midend_state(me, me->statepos-1),
+                                       midend_state(me, me->statepos-2));
 	me->statepos--;
         me->dir = -1;
+        midend_trim_states(me);
         return 1;
     } else if (me->newgame_undo.len) {
 	struct newgame_undo_deserialise_read_ctx rctx;
@@ -650,7 +1126,7 @@ static int midend_undo(midend *me)
          */
         serbuf.buf = NULL;
         serbuf.len = serbuf.size = 0;
-        midend_serialise(me, newgame_serialise_write, &serbuf);
+        midend_serialise_binary(me, newgame_serialise_write, &serbuf);
 
 	rctx.ser = &me->newgame_undo;
 	rctx.len = me->newgame_undo.len; /* copy for reentrancy safety */
@@ -706,10 +1182,11 @@ static int midend_redo(midend *me)
     if (me->statepos < me->nstates) {
         if (me->ui)
             me->ourgame->changed_state(me->ui,
-                                       me->states[me->statepos-1].state,
-                                       me->states[me->statepos].state);
+                                       midend_state(me, me->statepos-1),
+                                       midend_state(me, me->statepos));
 	me->statepos++;
         me->dir = +1;
+        midend_trim_states(me);
         return 1;
     } else if (me->newgame_redo.len) {
 	struct newgame_undo_deserialise_read_ctx rctx;
@@ -723,7 +1200,7 @@ static int midend_redo(midend *me)
          */
         serbuf.buf = NULL;
         serbuf.len = serbuf.size = 0;
-        midend_serialise(me, newgame_serialise_write, &serbuf);
+        midend_serialise_binary(me, newgame_serialise_write, &serbuf);
 
 	rctx.ser = &me->newgame_redo;
 	rctx.len = me->newgame_redo.len; /* copy for reentrancy safety */
@@ -786,8 +1263,8 @@ static void midend_finish_move(midend *me)
          (me->dir < 0 && me->statepos < me->nstates &&
           !special(me->states[me->statepos].movetype)))) {
 	flashtime = me->ourgame->flash_length(me->oldstate ? me->oldstate :
-					      me->states[me->statepos-2].state,
-					      me->states[me->statepos-1].state,
+					      midend_state(me, me->statepos-2),
+					      midend_state(me, me->statepos-1),
 					      me->oldstate ? me->dir : +1,
 					      me->ui);
 	if (flashtime > 0) {
@@ -809,7 +1286,8 @@ void midend_stop_anim(midend *me)
 {
     if (me->oldstate || me->anim_time != 0) {
 	midend_finish_move(me);
-        midend_redraw(me);
+        if (me->drawing)
+            midend_redraw(me);
     }
 }
 
@@ -840,10 +1318,11 @@ void midend_restart_game(midend *me)
     me->states[me->nstates].movestr = dupstr(me->desc);
     me->states[me->nstates].movetype = RESTART;
     me->statepos = ++me->nstates;
+    midend_trim_states(me);
     if (me->ui)
         me->ourgame->changed_state(me->ui,
-                                   me->states[me->statepos-2].state,
-                                   me->states[me->statepos-1].state);
+                                   midend_state(me, me->statepos-2),
+                                   midend_state(me, me->statepos-1));
     me->flash_pos = me->flash_time = 0.0F;
     midend_finish_move(me);
     midend_redraw(me);
@@ -853,7 +1332,7 @@ void midend_restart_game(midend *me)
 static int midend_really_process_key(midend *me, int x, int y, int button)
 {
     game_state *oldstate =
-        me->ourgame->dup_game(me->states[me->statepos - 1].state);
+        me->ourgame->dup_game(midend_state(me, me->statepos - 1));
     int type = MOVE, gottype = FALSE, ret = 1;
     float anim_time;
     game_state *s;
@@ -861,7 +1340,7 @@ static int midend_really_process_key(midend *me, int x, int y, int button)
 
     if (!IS_UI_FAKE_KEY(button)) {
         movestr = me->ourgame->interpret_move(
-            me->states[me->statepos-1].state,
+            midend_state(me, me->statepos-1),
             me->ui, me->drawstate, x, y, button);
     }
 
@@ -897,14 +1376,14 @@ static int midend_really_process_key(midend *me, int x, int y, int button)
 	    goto done;
     } else {
 	if (movestr == UI_UPDATE)
-	    s = me->states[me->statepos-1].state;
+	    s = midend_state(me, me->statepos-1);
 	else {
-	    s = me->ourgame->execute_move(me->states[me->statepos-1].state,
+	    s = me->ourgame->execute_move(midend_state(me, me->statepos-1),
 					  movestr);
 	    assert(s != NULL);
 	}
 
-        if (s == me->states[me->statepos-1].state) {
+        if (s == midend_state(me, me->statepos-1)) {
             /*
              * make_move() is allowed to return its input state to
              * indicate that although no move has been made, the UI
@@ -922,11 +1401,12 @@ static int midend_really_process_key(midend *me, int x, int y, int button)
             me->states[me->nstates].movestr = movestr;
             me->states[me->nstates].movetype = MOVE;
             me->statepos = ++me->nstates;
+            midend_trim_states(me);
             me->dir = +1;
 	    if (me->ui)
 		me->ourgame->changed_state(me->ui,
-					   me->states[me->statepos-2].state,
-					   me->states[me->statepos-1].state);
+					   midend_state(me, me->statepos-2),
+					   midend_state(me, me->statepos-1));
         } else {
             goto done;
         }
@@ -943,7 +1423,7 @@ static int midend_really_process_key(midend *me, int x, int y, int button)
         anim_time = 0;
     } else {
         anim_time = me->ourgame->anim_length(oldstate,
-                                             me->states[me->statepos-1].state,
+                                             midend_state(me, me->statepos-1),
                                              me->dir, me->ui);
     }
 
@@ -1114,11 +1594,11 @@ void midend_redraw(midend *me)
             me->anim_pos < me->anim_time) {
             assert(me->dir != 0);
             me->ourgame->redraw(me->drawing, me->drawstate, me->oldstate,
-				me->states[me->statepos-1].state, me->dir,
+				midend_state(me, me->statepos-1), me->dir,
 				me->ui, me->anim_pos, me->flash_pos);
         } else {
             me->ourgame->redraw(me->drawing, me->drawstate, NULL,
-				me->states[me->statepos-1].state, +1 /*shrug*/,
+				midend_state(me, me->statepos-1), +1 /*shrug*/,
 				me->ui, 0.0, me->flash_pos);
         }
         end_draw(me->drawing);
@@ -1433,6 +1913,26 @@ void midend_request_id_changes(midend *me, void (*notify)(void *), void *ctx)
     me->game_id_change_notify_ctx = ctx;
 }
 
+void midend_set_fast_random(midend *me, int fast)
+{
+    me->fast_random = fast;
+#ifdef MIDEND_POOL
+    if (me->pool)
+        midend_pool_flush(me);
+#endif
+}
+
+void midend_set_undo_keyframes(midend *me, int interval)
+{
+    me->keyframe_interval = interval > 0 ? interval : 0;
+    midend_trim_states(me);
+}
+
+void midend_set_pool(midend *me, int size)
+{
+    me->pool_size = size > 0 ? size : 0;
+}
+
 void midend_supersede_game_desc(midend *me, const char *desc,
                                 const char *privdesc)
 {
@@ -1768,7 +2268,7 @@ char *midend_text_format(midend *me)
 {
     if (me->ourgame->can_format_as_text_ever && me->statepos > 0 &&
 	me->ourgame->can_format_as_text_now(me->params))
-	return me->ourgame->text_format(me->states[me->statepos-1].state);
+	return me->ourgame->text_format(midend_state(me, me->statepos-1));
     else
 	return NULL;
 }
@@ -1786,8 +2286,8 @@ const char *midend_solve(midend *me)
 	return "No game set up to solve";   /* _shouldn't_ happen! */
 
     msg = NULL;
-    movestr = me->ourgame->solve(me->states[0].state,
-				 me->states[me->statepos-1].state,
+    movestr = me->ourgame->solve(midend_state(me, 0),
+				 midend_state(me, me->statepos-1),
 				 me->aux_info, &msg);
     assert(movestr != UI_UPDATE);
     if (!movestr) {
@@ -1795,7 +2295,7 @@ const char *midend_solve(midend *me)
 	    msg = "Solve operation failed";   /* _shouldn't_ happen, but can */
 	return msg;
     }
-    s = me->ourgame->execute_move(me->states[me->statepos-1].state, movestr);
+    s = me->ourgame->execute_move(midend_state(me, me->statepos-1), movestr);
     assert(s);
 
     /*
@@ -1808,16 +2308,18 @@ const char *midend_solve(midend *me)
     me->states[me->nstates].movestr = movestr;
     me->states[me->nstates].movetype = SOLVE;
     me->statepos = ++me->nstates;
+    midend_trim_states(me);
     if (me->ui)
         me->ourgame->changed_state(me->ui,
-                                   me->states[me->statepos-2].state,
-                                   me->states[me->statepos-1].state);
+                                   midend_state(me, me->statepos-2),
+                                   midend_state(me, me->statepos-1));
     me->dir = +1;
-    if (me->ourgame->flags & SOLVE_ANIMATES) {
-	me->oldstate = me->ourgame->dup_game(me->states[me->statepos-2].state);
+    /* Only animate if there's anything to animate on. */
+    if ((me->ourgame->flags & SOLVE_ANIMATES) && me->drawing) {
+	me->oldstate = me->ourgame->dup_game(midend_state(me, me->statepos-2));
         me->anim_time =
-	    me->ourgame->anim_length(me->states[me->statepos-2].state,
-				     me->states[me->statepos-1].state,
+	    me->ourgame->anim_length(midend_state(me, me->statepos-2),
+				     midend_state(me, me->statepos-1),
 				     +1, me->ui);
         me->anim_pos = 0.0;
     } else {
@@ -1844,7 +2346,7 @@ int midend_status(midend *me)
     if (me->statepos == 0)
         return +1;
 
-    return me->ourgame->status(me->states[me->statepos-1].state);
+    return me->ourgame->status(midend_state(me, me->statepos-1));
 }
 
 char *midend_rewrite_statusbar(midend *me, const char *text)
@@ -1880,30 +2382,250 @@ char *midend_rewrite_statusbar(midend *me, const char *text)
 #define SERIALISE_MAGIC "Simon Tatham's Portable Puzzle Collection"
 #define SERIALISE_VERSION "1"
 
-void midend_serialise(midend *me,
-                      void (*write)(void *ctx, const void *buf, int len),
-                      void *wctx)
+/*
+ * Save files come in two formats, containing the same records.
+ *
+ * In the text format, each line of the save file contains three
+ * components. First exactly 8 characters of header word indicating
+ * what type of data is contained on the line; then a colon followed
+ * by a decimal integer giving the length of the main string on the
+ * line; then a colon followed by the string itself (exactly as many
+ * bytes as previously specified, no matter what they contain). Then
+ * a newline (of reasonably flexible form).
+ *
+ * The binary format begins with the signature below, which can't
+ * start a text file, and each record is the same 8 characters of
+ * header word, then the length of the string as 4 bytes big-endian,
+ * then the string. It can also contain SNAPSHOT records, each giving
+ * the whole of the game state after the preceding move in the back
+ * end's encode_state() format, and it ends with a CHECKSUM record
+ * holding the Adler-32 (as in zlib, 4 bytes big-endian) of everything
+ * before the checksum itself.
+ */
+#define SERIALISE_SIGNATURE "\211SGTPUZ\n"
+#define SERIALISE_SIGNATURE_LEN 8
+#define SERIALISE_SNAPSHOT_INTERVAL 64
+
+/*
+ * The checksum only has to catch a damaged file, so it doesn't need
+ * to be anything like SHA-1, which would be most of the cost of
+ * loading one.
+ */
+static void adler32_update(unsigned long *sum, const void *vbuf, int len)
 {
-    int i;
+    const unsigned char *buf = (const unsigned char *)vbuf;
+    unsigned long a = *sum & 0xFFFF, b = (*sum >> 16) & 0xFFFF;
+
+    while (len > 0) {
+        int n = (len < 5552 ? len : 5552);  /* as many as can't overflow */
+        len -= n;
+        while (n--) {
+            a += *buf++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    *sum = (b << 16) | a;
+}
+
+static void put32(unsigned char *buf, unsigned long val)
+{
+    buf[0] = (unsigned char)(val >> 24);
+    buf[1] = (unsigned char)(val >> 16);
+    buf[2] = (unsigned char)(val >> 8);
+    buf[3] = (unsigned char)val;
+}
+
+static unsigned long get32(const unsigned char *buf)
+{
+    return ((unsigned long)buf[0] << 24 | (unsigned long)buf[1] << 16 |
+            (unsigned long)buf[2] << 8 | (unsigned long)buf[3]);
+}
+
+struct serialise_writer {
+    void (*write)(void *ctx, const void *buf, int len);
+    void *wctx;
+    int binary;
+    unsigned long sum;                 /* of everything written, if binary */
+};
+
+static void serialise_write(struct serialise_writer *w,
+                            const void *buf, int len)
+{
+    if (w->binary)
+        adler32_update(&w->sum, buf, len);
+    w->write(w->wctx, buf, len);
+}
+
+static void serialise_header(struct serialise_writer *w, const char *key,
+                             int len)
+{
+    char lbuf[9];
+
+    copy_left_justified(lbuf, sizeof(lbuf), key);
+    if (w->binary) {
+        unsigned char hdr[12];
+        memcpy(hdr, lbuf, 8);
+        put32(hdr + 8, len);
+        serialise_write(w, hdr, 12);
+    } else {
+        char hbuf[80];
+        sprintf(hbuf, "%s:%d:", lbuf, len);
+        serialise_write(w, hbuf, strlen(hbuf));
+    }
+}
+
+static void serialise_record(struct serialise_writer *w, const char *key,
+                             const char *val, int len)
+{
+    serialise_header(w, key, len);
+    serialise_write(w, val, len);
+    if (!w->binary)
+        serialise_write(w, "\n", 1);
+}
+
+struct serialise_reader {
+    int (*read)(void *ctx, void *buf, int len);
+    void *rctx;
+    int binary;                        /* -1 until the first record */
+    unsigned long sum;                 /* of everything read, if binary */
+};
+
+enum { RECORD_OK, RECORD_EOF, RECORD_BAD, RECORD_CORRUPT };
+
+static int serialise_read(struct serialise_reader *r, void *buf, int len)
+{
+    if (!r->read(r->rctx, buf, len))
+        return FALSE;
+    if (r->binary > 0)
+        adler32_update(&r->sum, buf, len);
+    return TRUE;
+}
+
+/*
+ * Read the next record of a save file in either format, putting its
+ * header word in 'key' (which has room for 9 characters) and its
+ * string in a new allocation in *val. Returns RECORD_EOF if the data
+ * runs out, RECORD_BAD if it isn't in the right format, and
+ * RECORD_CORRUPT if a binary file fails its checksum.
+ */
+static int serialise_read_record(struct serialise_reader *r, char *key,
+                                 char **val)
+{
+    int len, gotfirst = FALSE;
+
+    *val = NULL;
+
+    if (r->binary < 0) {
+        /*
+         * The first record: see which format we've got, from its
+         * first byte.
+         */
+        do {
+            if (!r->read(r->rctx, key, 1))
+                return RECORD_EOF;
+        } while (key[0] == '\r' || key[0] == '\n');
+        r->binary = (key[0] == SERIALISE_SIGNATURE[0]);
+        if (r->binary) {
+            char sig[SERIALISE_SIGNATURE_LEN];
+
+            sig[0] = key[0];
+            if (!r->read(r->rctx, sig+1, SERIALISE_SIGNATURE_LEN-1))
+                return RECORD_EOF;
+            if (memcmp(sig, SERIALISE_SIGNATURE, SERIALISE_SIGNATURE_LEN))
+                return RECORD_BAD;
+            r->sum = 1;
+            adler32_update(&r->sum, sig, SERIALISE_SIGNATURE_LEN);
+        } else {
+            gotfirst = TRUE;
+        }
+    }
+
+    if (r->binary) {
+        unsigned char hdr[12];
+        unsigned long ulen;
+
+        if (!serialise_read(r, hdr, 12))
+            return RECORD_EOF;
+        memcpy(key, hdr, 8);
+        key[8] = '\0';
+        key[strcspn(key, " ")] = '\0';
+        ulen = get32(hdr + 8);
+        if (ulen >= INT_MAX)
+            return RECORD_BAD;
+        len = (int)ulen;
+
+        if (!strcmp(key, "CHECKSUM")) {
+            unsigned long sum = r->sum;
+            unsigned char check[4];
+
+            if (len != 4)
+                return RECORD_BAD;
+            if (!r->read(r->rctx, check, 4))
+                return RECORD_EOF;
+            if (get32(check) != sum)
+                return RECORD_CORRUPT;
+            *val = dupstr("");
+            return RECORD_OK;
+        }
+    } else {
+        char c;
+
+        if (!gotfirst) {
+            do {
+                if (!serialise_read(r, key, 1))
+                    return RECORD_EOF;
+            } while (key[0] == '\r' || key[0] == '\n');
+        }
+        if (!serialise_read(r, key+1, 8))
+            return RECORD_EOF;
+        if (key[8] != ':')
+            return RECORD_BAD;
+        len = strcspn(key, ": ");
+        assert(len <= 8);
+        key[len] = '\0';
+
+        len = 0;
+        while (1) {
+            if (!serialise_read(r, &c, 1))
+                return RECORD_EOF;
+
+            if (c == ':') {
+                break;
+            } else if (c >= '0' && c <= '9') {
+                len = (len * 10) + (c - '0');
+            } else {
+                return RECORD_BAD;
+            }
+        }
+    }
+
+    *val = snewn(len+1, char);
+    if (!serialise_read(r, *val, len))
+        return RECORD_EOF;
+    (*val)[len] = '\0';
+    return RECORD_OK;
+}
+
+static void midend_serialise_internal(
+    midend *me, void (*write)(void *ctx, const void *buf, int len),
+    void *wctx, int binary)
+{
+    struct serialise_writer w;
+    int i, interval;
+
+    w.write = write;
+    w.wctx = wctx;
+    w.binary = binary;
+    if (binary) {
+        w.sum = 1;
+        serialise_write(&w, SERIALISE_SIGNATURE, SERIALISE_SIGNATURE_LEN);
+    }
 
-    /*
-     * Each line of the save file contains three components. First
-     * exactly 8 characters of header word indicating what type of
-     * data is contained on the line; then a colon followed by a
-     * decimal integer giving the length of the main string on the
-     * line; then a colon followed by the string itself (exactly as
-     * many bytes as previously specified, no matter what they
-     * contain). Then a newline (of reasonably flexible form).
-     */
 #define wr(h,s) do { \
-    char hbuf[80]; \
     const char *str = (s); \
-    char lbuf[9];                               \
-    copy_left_justified(lbuf, sizeof(lbuf), h); \
-    sprintf(hbuf, "%s:%d:", lbuf, (int)strlen(str)); \
-    write(wctx, hbuf, strlen(hbuf)); \
-    write(wctx, str, strlen(str)); \
-    write(wctx, "\n", 1); \
+    serialise_record(&w, h, str, strlen(str)); \
 } while (0)
 
     /*
@@ -2009,7 +2731,16 @@ void midend_serialise(midend *me,
      * constructed from either privdesc or desc), enough
      * information for execute_move() to reconstruct it from the
      * previous one.
+     *
+     * In a binary file, if the game can encode its states, some of
+     * them are followed by a snapshot of the whole state, so that
+     * loading doesn't have to keep every state: the current one,
+     * and every so often before and after it (matching the
+     * keyframes of compact undo, if that's on, so that the
+     * snapshots survive midend_trim_states() after loading).
      */
+    interval = (me->keyframe_interval ? me->keyframe_interval :
+                SERIALISE_SNAPSHOT_INTERVAL);
     for (i = 1; i < me->nstates; i++) {
         assert(me->states[i].movetype != NEWGAME);   /* only state 0 */
         switch (me->states[i].movetype) {
@@ -2023,9 +2754,61 @@ void midend_serialise(midend *me,
             wr("RESTART", me->states[i].movestr);
             break;
         }
+        if (binary && me->ourgame->encode_state &&
+            me->states[i].movetype != RESTART &&
+            (i % interval == 0 || i == me->statepos-1)) {
+            char *s = me->ourgame->encode_state(midend_state(me, i));
+            wr("SNAPSHOT", s);
+            sfree(s);
+        }
     }
 
 #undef wr
+
+    if (binary) {
+        unsigned char sum[4];
+
+        /* Any states midend_state() rebuilt above can go again. */
+        midend_trim_states(me);
+
+        /*
+         * Finish with a checksum of everything before it, so that a
+         * damaged file is caught even where the damage still parses
+         * (in a snapshot, say, or the UI string).
+         */
+        serialise_header(&w, "CHECKSUM", 4);
+        put32(sum, w.sum);
+        write(wctx, sum, 4);
+    }
+}
+
+void midend_serialise(midend *me,
+                      void (*write)(void *ctx, const void *buf, int len),
+                      void *wctx)
+{
+    midend_serialise_internal(me, write, wctx, FALSE);
+}
+
+void midend_serialise_binary(
+    midend *me, void (*write)(void *ctx, const void *buf, int len),
+    void *wctx)
+{
+    midend_serialise_internal(me, write, wctx, TRUE);
+}
+
+/*
+ * Whether a state built while loading a file with snapshots is one
+ * the mid-end should hold on to: state 0, a snapshot or a restart
+ * (the states midend_state() rebuilds the others from), or one from
+ * 'base', the last of those before the current position, up to the
+ * current position.
+ */
+static int deserialise_keep_state(const struct deserialise_data *data,
+                                  int base, int i)
+{
+    return (i == 0 || data->snapshots[i] ||
+            data->states[i].movetype == RESTART ||
+            (i >= base && i < data->statepos));
 }
 
 /*
@@ -2042,9 +2825,10 @@ static const char *midend_deserialise_internal(
     void *cctx)
 {
     struct deserialise_data data;
-    int gotstates = 0;
+    struct serialise_reader reader;
+    int gotstates = 0, gotchecksum = FALSE;
     int started = FALSE;
-    int i;
+    int i, base;
 
     char *val = NULL;
     /* Initially all errors give the same report */
@@ -2056,65 +2840,36 @@ static const char *midend_deserialise_internal(
     data.params = data.cparams = NULL;
     data.ui = NULL;
     data.states = NULL;
+    data.snapshots = NULL;
     data.nstates = 0;
     data.statepos = -1;
 
+    reader.read = read;
+    reader.rctx = rctx;
+    reader.binary = -1;
+
     /*
      * Loop round and round reading one key/value pair at a time
      * from the serialised stream, until we have enough game states
      * to finish.
      */
-    while (data.nstates <= 0 || data.statepos < 0 ||
-           gotstates < data.nstates-1) {
-        char key[9], c;
-        int len;
-
-        do {
-            if (!read(rctx, key, 1)) {
-                /* unexpected EOF */
-                goto cleanup;
-            }
-        } while (key[0] == '\r' || key[0] == '\n');
-
-        if (!read(rctx, key+1, 8)) {
+    while (reader.binary > 0 ? !gotchecksum :
+           (data.nstates <= 0 || data.statepos < 0 ||
+            gotstates < data.nstates-1)) {
+        char key[9];
+        int status;
+
+        status = serialise_read_record(&reader, key, &val);
+        if (status == RECORD_EOF) {
             /* unexpected EOF */
             goto cleanup;
-        }
-
-        if (key[8] != ':') {
-            if (started)
-                ret = "Data was incorrectly formatted for a saved game file";
-	    goto cleanup;
-        }
-        len = strcspn(key, ": ");
-        assert(len <= 8);
-        key[len] = '\0';
-
-        len = 0;
-        while (1) {
-            if (!read(rctx, &c, 1)) {
-                /* unexpected EOF */
-                goto cleanup;
-            }
-
-            if (c == ':') {
-                break;
-            } else if (c >= '0' && c <= '9') {
-                len = (len * 10) + (c - '0');
-            } else {
-                if (started)
-                    ret = "Data was incorrectly formatted for a"
-                    " saved game file";
-                goto cleanup;
-            }
-        }
-
-        val = snewn(len+1, char);
-        if (!read(rctx, val, len)) {
+        } else if (status != RECORD_OK) {
             if (started)
+                ret = (status == RECORD_CORRUPT ?
+                       "Saved game file is corrupt" :
+                       "Data was incorrectly formatted for a saved game file");
             goto cleanup;
         }
-        val[len] = '\0';
 
         if (!started) {
             if (strcmp(key, "SAVEFILE") || strcmp(val, SERIALISE_MAGIC)) {
@@ -2191,21 +2946,34 @@ static const char *midend_deserialise_internal(
                 }
             } else if (!strcmp(key, "STATEPOS")) {
                 data.statepos = atoi(val);
-            } else if (!strcmp(key, "MOVE")) {
-                gotstates++;
-                data.states[gotstates].movetype = MOVE;
-                data.states[gotstates].movestr = val;
-                val = NULL;
-            } else if (!strcmp(key, "SOLVE")) {
+            } else if (!strcmp(key, "MOVE") || !strcmp(key, "SOLVE") ||
+                       !strcmp(key, "RESTART")) {
+                if (!data.states || gotstates >= data.nstates-1) {
+                    ret = "Save file contained more moves than states";
+                    goto cleanup;
+                }
                 gotstates++;
-                data.states[gotstates].movetype = SOLVE;
+                data.states[gotstates].movetype =
+                    (!strcmp(key, "MOVE") ? MOVE :
+                     !strcmp(key, "SOLVE") ? SOLVE : RESTART);
                 data.states[gotstates].movestr = val;
                 val = NULL;
-            } else if (!strcmp(key, "RESTART")) {
-                gotstates++;
-                data.states[gotstates].movetype = RESTART;
-                data.states[gotstates].movestr = val;
+            } else if (!strcmp(key, "SNAPSHOT")) {
+                if (gotstates == 0 ||
+                    data.states[gotstates].movetype == RESTART) {
+                    ret = "Save file contained a misplaced snapshot";
+                    goto cleanup;
+                }
+                if (!data.snapshots) {
+                    data.snapshots = snewn(data.nstates, char *);
+                    for (i = 0; i < data.nstates; i++)
+                        data.snapshots[i] = NULL;
+                }
+                sfree(data.snapshots[gotstates]);
+                data.snapshots[gotstates] = val;
                 val = NULL;
+            } else if (!strcmp(key, "CHECKSUM")) {
+                gotchecksum = TRUE;
             }
         }
 
@@ -2245,23 +3013,60 @@ static const char *midend_deserialise_internal(
         ret = "Game private description in save file is invalid";
         goto cleanup;
     }
-    if (data.statepos < 0 || data.statepos >= data.nstates) {
+    if (data.nstates <= 0 || gotstates != data.nstates-1) {
+        ret = "Saved data ended unexpectedly";
+        goto cleanup;
+    }
+    if (data.statepos < 1 || data.statepos > data.nstates) {
         ret = "Game position in save file is out of range";
+        goto cleanup;
     }
+    if (data.snapshots && !me->ourgame->decode_state) {
+        ret = "Save file contained snapshots this game cannot read";
+        goto cleanup;
+    }
+
+    /*
+     * Every move is replayed, so that a bad one anywhere in the file
+     * fails the load rather than an assertion in midend_state() on a
+     * later undo or redo. Without snapshots, we keep every state we
+     * build. With them, we keep only the snapshots and the states
+     * from the last one before the current position up to it, and
+     * leave the rest for midend_state() to rebuild when they're
+     * wanted, as under compact undo. A move following a snapshot is
+     * replayed on the decoded snapshot, since that is what
+     * midend_state() will later apply it to.
+     */
+    base = 0;
+    if (data.snapshots)
+        for (base = data.statepos-1; base > 0; base--)
+            if (data.snapshots[base] || data.states[base].movetype == RESTART)
+                break;
 
     data.states[0].state = me->ourgame->new_game(
         me, data.cparams, data.privdesc ? data.privdesc : data.desc);
     for (i = 1; i < data.nstates; i++) {
+        game_state *s = NULL;
+
         assert(data.states[i].movetype != NEWGAME);
         switch (data.states[i].movetype) {
           case MOVE:
           case SOLVE:
-            data.states[i].state = me->ourgame->execute_move(
-                data.states[i-1].state, data.states[i].movestr);
-            if (data.states[i].state == NULL) {
+            s = me->ourgame->execute_move(data.states[i-1].state,
+                                          data.states[i].movestr);
+            if (s == NULL) {
                 ret = "Save file contained an invalid move";
                 goto cleanup;
             }
+            if (data.snapshots && data.snapshots[i]) {
+                me->ourgame->free_game(s);
+                s = me->ourgame->decode_state(data.states[0].state,
+                                              data.snapshots[i]);
+                if (s == NULL) {
+                    ret = "Save file contained an invalid snapshot";
+                    goto cleanup;
+                }
+            }
             break;
           case RESTART:
             if (me->ourgame->validate_desc(
@@ -2269,10 +3074,30 @@ static const char *midend_deserialise_internal(
                 ret = "Save file contained an invalid restart move";
                 goto cleanup;
             }
-            data.states[i].state = me->ourgame->new_game(
-                me, data.cparams, data.states[i].movestr);
+            s = me->ourgame->new_game(me, data.cparams,
+                                      data.states[i].movestr);
             break;
         }
+        data.states[i].state = s;
+
+        /* Now we've finished with the state before this one, unless
+         * it's one we're keeping. */
+        if (data.snapshots &&
+            !deserialise_keep_state(&data, base, i-1)) {
+            me->ourgame->free_game(data.states[i-1].state);
+            data.states[i-1].state = NULL;
+        }
+    }
+    if (data.snapshots && !deserialise_keep_state(&data, base, i-1)) {
+        me->ourgame->free_game(data.states[i-1].state);
+        data.states[i-1].state = NULL;
+    }
+    if (data.snapshots) {
+        /* Free these now, while data.nstates still counts them. */
+        for (i = 0; i < data.nstates; i++)
+            sfree(data.snapshots[i]);
+        sfree(data.snapshots);
+        data.snapshots = NULL;
     }
 
     data.ui = me->ourgame->new_ui(data.states[0].state);
@@ -2324,6 +3149,7 @@ static const char *midend_deserialise_internal(
         data.states = tmp;
     }
     me->statepos = data.statepos;
+    midend_trim_states(me);
 
     /*
      * Don't save the "new game undo/redo" state.  So "new game" twice or
@@ -2368,7 +3194,7 @@ static const char *midend_deserialise_internal(
         me->ourgame->free_drawstate(me->drawing, me->drawstate);
     me->drawstate =
         me->ourgame->new_drawstate(me->drawing,
-				   me->states[me->statepos-1].state);
+				   midend_state(me, me->statepos-1));
     midend_size_new_drawstate(me);
     if (me->game_id_change_notify_function)
         me->game_id_change_notify_function(me->game_id_change_notify_ctx);
@@ -2400,6 +3226,13 @@ static const char *midend_deserialise_internal(
         }
         sfree(data.states);
     }
+    if (data.snapshots) {
+        int i;
+
+        for (i = 0; i < data.nstates; i++)
+            sfree(data.snapshots[i]);
+        sfree(data.snapshots);
+    }
 
     return ret;
 }
@@ -2421,6 +3254,7 @@ const char *identify_game(char **name,
                           int (*read)(void *ctx, void *buf, int len),
                           void *rctx)
 {
+    struct serialise_reader reader;
     int nstates = 0, statepos = -1, gotstates = 0;
     int started = FALSE;
 
@@ -2429,61 +3263,29 @@ const char *identify_game(char **name,
     const char *ret = "Data does not appear to be a saved game file";
 
     *name = NULL;
+    reader.read = read;
+    reader.rctx = rctx;
+    reader.binary = -1;
 
     /*
      * Loop round and round reading one key/value pair at a time from
      * the serialised stream, until we've found the game name.
      */
     while (nstates <= 0 || statepos < 0 || gotstates < nstates-1) {
-        char key[9], c;
-        int len;
+        char key[9];
+        int status;
 
-        do {
-            if (!read(rctx, key, 1)) {
-                /* unexpected EOF */
-                goto cleanup;
-            }
-        } while (key[0] == '\r' || key[0] == '\n');
-
-        if (!read(rctx, key+1, 8)) {
+        status = serialise_read_record(&reader, key, &val);
+        if (status == RECORD_EOF) {
             /* unexpected EOF */
             goto cleanup;
-        }
-
-        if (key[8] != ':') {
-            if (started)
-                ret = "Data was incorrectly formatted for a saved game file";
-	    goto cleanup;
-        }
-        len = strcspn(key, ": ");
-        assert(len <= 8);
-        key[len] = '\0';
-
-        len = 0;
-        while (1) {
-            if (!read(rctx, &c, 1)) {
-                /* unexpected EOF */
-                goto cleanup;
-            }
-
-            if (c == ':') {
-                break;
-            } else if (c >= '0' && c <= '9') {
-                len = (len * 10) + (c - '0');
-            } else {
-                if (started)
-                    ret = "Data was incorrectly formatted for a"
-                    " saved game file";
-                goto cleanup;
-            }
-        }
-
-        val = snewn(len+1, char);
-        if (!read(rctx, val, len)) {
+        } else if (status != RECORD_OK) {
             if (started)
+                ret = (status == RECORD_CORRUPT ?
+                       "Saved game file is corrupt" :
+                       "Data was incorrectly formatted for a saved game file");
             goto cleanup;
         }
-        val[len] = '\0';
 
         if (!started) {
             if (strcmp(key, "SAVEFILE") || strcmp(val, SERIALISE_MAGIC)) {
@@ -2531,12 +3333,12 @@ const char *midend_print_puzzle(midend *me, document *doc, int with_soln)
 	    return "This game does not support the Solve operation";
 
 	msg = "Solve operation failed";/* game _should_ overwrite on error */
-	movestr = me->ourgame->solve(me->states[0].state,
-				     me->states[me->statepos-1].state,
+	movestr = me->ourgame->solve(midend_state(me, 0),
+				     midend_state(me, me->statepos-1),
 				     me->aux_info, &msg);
 	if (!movestr)
 	    return msg;
-	soln = me->ourgame->execute_move(me->states[me->statepos-1].state,
+	soln = me->ourgame->execute_move(midend_state(me, me->statepos-1),
 					 movestr);
 	assert(soln);
 
@@ -2552,7 +3354,7 @@ const char *midend_print_puzzle(midend *me, document *doc, int with_soln)
      */
     document_add_puzzle(doc, me->ourgame,
 			me->ourgame->dup_params(me->curparams),
-			me->ourgame->dup_game(me->states[0].state), soln);
+			me->ourgame->dup_game(midend_state(me, 0)), soln);
 
     return NULL;
 }
@@ -14,7 +14,10 @@
 #include <ctype.h>
 #include <math.h>
 
-#include "tree234.h"
+#ifdef MINES_SPECULATE
+#include <pthread.h>
+#endif
+
 #include "puzzles.h"
 
 enum {
@@ -60,6 +63,9 @@ struct mine_layout {
     int n, unique;
     random_state *rs;
     midend *me;		       /* to give back the new game desc */
+#ifdef MINES_SPECULATE
+    struct speculation *spec;	       /* layouts being generated in advance */
+#endif
 };
 
 struct game_state {
@@ -290,50 +296,72 @@ static int bitcount16(int inword)
 }
 
 /*
- * We use a tree234 to store a large number of small localised
- * sets, each with a mine count. We also keep some of those sets
+ * We store a large number of small localised sets, each with a mine
+ * count. Each set is a 3x3 bitmask anchored at the top left corner
+ * of its bounding rectangle. The store indexes them by that anchor
+ * square, so that finding the sets which can overlap a given one is
+ * a matter of looking in a few neighbouring squares, and testing for
+ * overlap is a shift and an AND. We also keep some of the sets
  * linked together into a to-do list.
+ *
+ * Sets are visited (by ss_overlap and ss_index) in order of anchor
+ * and then mask, so the solver's behaviour, and hence the grids the
+ * generator produces, don't depend on the details of the store.
  */
 struct set {
     short x, y, mask, mines;
     int todo;
-    struct set *prev, *next;
+    struct set *prev, *next;	       /* to-do list */
+    struct set *anext;		       /* same anchor, increasing mask */
 };
 
-static int setcmp(void *av, void *bv)
-{
-    struct set *a = (struct set *)av;
-    struct set *b = (struct set *)bv;
-
-    if (a->y < b->y)
-	return -1;
-    else if (a->y > b->y)
-	return +1;
-    else if (a->x < b->x)
-	return -1;
-    else if (a->x > b->x)
-	return +1;
-    else if (a->mask < b->mask)
-	return -1;
-    else if (a->mask > b->mask)
-	return +1;
-    else
-	return 0;
-}
-
 struct setstore {
-    tree234 *sets;
+    int w, h;
+    struct set **anchors;	       /* w*h lists of sets, by anchor */
+    int *rowcount;		       /* number of sets anchored in each row */
+    int count;
+    struct set **overlap;	       /* result buffer for ss_overlap */
+    int overlapsize;
     struct set *todo_head, *todo_tail;
 };
 
-static struct setstore *ss_new(void)
+static struct setstore *ss_new(int w, int h)
 {
     struct setstore *ss = snew(struct setstore);
-    ss->sets = newtree234(setcmp);
+    int i;
+
+    ss->w = w;
+    ss->h = h;
+    ss->anchors = snewn(w*h, struct set *);
+    for (i = 0; i < w*h; i++)
+	ss->anchors[i] = NULL;
+    ss->rowcount = snewn(h, int);
+    for (i = 0; i < h; i++)
+	ss->rowcount[i] = 0;
+    ss->count = 0;
+    ss->overlapsize = 32;
+    ss->overlap = snewn(ss->overlapsize, struct set *);
     ss->todo_head = ss->todo_tail = NULL;
     return ss;
 }
 
+static void ss_free(struct setstore *ss)
+{
+    int i;
+
+    for (i = 0; i < ss->w * ss->h; i++) {
+	while (ss->anchors[i]) {
+	    struct set *s = ss->anchors[i];
+	    ss->anchors[i] = s->anext;
+	    sfree(s);
+	}
+    }
+    sfree(ss->anchors);
+    sfree(ss->rowcount);
+    sfree(ss->overlap);
+    sfree(ss);
+}
+
 /*
  * Take two input sets, in the form (x,y,mask). Munge the first by
  * taking either its intersection with the second or its difference
@@ -342,33 +370,26 @@ static struct setstore *ss_new(void)
 static int setmunge(int x1, int y1, int mask1, int x2, int y2, int mask2,
 		    int diff)
 {
+    /*
+     * The columns and rows of a 3x3 mask which stay inside it when
+     * it's moved right or down by 0, 1 or 2 squares (indexed by the
+     * distance plus 2, so that moves left and up use the first two
+     * entries).
+     */
+    static const int colkeep[5] = { 0x124, 0x1B6, 0x1FF, 0x0DB, 0x049 };
+    static const int rowkeep[5] = { 0x1C0, 0x1F8, 0x1FF, 0x03F, 0x007 };
+    int dx = x2 - x1, dy = y2 - y1;
+
     /*
      * Adjust the second set so that it has the same x,y
      * coordinates as the first.
      */
-    if (abs(x2-x1) >= 3 || abs(y2-y1) >= 3) {
+    if (abs(dx) >= 3 || abs(dy) >= 3) {
 	mask2 = 0;
     } else {
-	while (x2 > x1) {
-	    mask2 &= ~(4|32|256);
-	    mask2 <<= 1;
-	    x2--;
-	}
-	while (x2 < x1) {
-	    mask2 &= ~(1|8|64);
-	    mask2 >>= 1;
-	    x2++;
-	}
-	while (y2 > y1) {
-	    mask2 &= ~(64|128|256);
-	    mask2 <<= 3;
-	    y2--;
-	}
-	while (y2 < y1) {
-	    mask2 &= ~(1|2|4);
-	    mask2 >>= 3;
-	    y2++;
-	}
+	mask2 &= colkeep[dx+2] & rowkeep[dy+2];
+	mask2 = (dx >= 0 ? mask2 << dx : mask2 >> -dx);
+	mask2 = (dy >= 0 ? mask2 << (3*dy) : mask2 >> (-3*dy));
     }
 
     /*
@@ -406,7 +427,7 @@ static void ss_add_todo(struct setstore *ss, struct set *s)
 
 static void ss_add(struct setstore *ss, int x, int y, int mask, int mines)
 {
-    struct set *s;
+    struct set *s, **sp;
 
     assert(mask != 0);
 
@@ -420,7 +441,17 @@ static void ss_add(struct setstore *ss, int x, int y, int mask, int mines)
 	mask >>= 3, y++;
 
     /*
-     * Create a set structure and add it to the tree.
+     * Find where the set belongs in its anchor's list. If it's
+     * already there, there's nothing to do.
+     */
+    assert(x >= 0 && x < ss->w && y >= 0 && y < ss->h);
+    for (sp = &ss->anchors[y*ss->w+x]; *sp && (*sp)->mask < mask;
+	 sp = &(*sp)->anext);
+    if (*sp && (*sp)->mask == mask)
+	return;
+
+    /*
+     * Create a set structure and add it to the store.
      */
     s = snew(struct set);
     s->x = x;
@@ -428,16 +459,13 @@ static void ss_add(struct setstore *ss, int x, int y, int mask, int mines)
     s->mask = mask;
     s->mines = mines;
     s->todo = FALSE;
-    if (add234(ss->sets, s) != s) {
-	/*
-	 * This set already existed! Free it and return.
-	 */
-	sfree(s);
-	return;
-    }
+    s->anext = *sp;
+    *sp = s;
+    ss->rowcount[y]++;
+    ss->count++;
 
     /*
-     * We've added a new set to the tree, so put it on the todo
+     * We've added a new set to the store, so put it on the todo
      * list.
      */
     ss_add_todo(ss, s);
@@ -445,7 +473,7 @@ static void ss_add(struct setstore *ss, int x, int y, int mask, int mines)
 
 static void ss_remove(struct setstore *ss, struct set *s)
 {
-    struct set *next = s->next, *prev = s->prev;
+    struct set *next = s->next, *prev = s->prev, **sp;
 
 #ifdef SOLVER_DIAGNOSTICS
     printf("removing set %d,%d %03x\n", s->x, s->y, s->mask);
@@ -466,9 +494,13 @@ static void ss_remove(struct setstore *ss, struct set *s)
     s->todo = FALSE;
 
     /*
-     * Remove s from the tree.
+     * Remove s from its anchor's list.
      */
-    del234(ss->sets, s);
+    for (sp = &ss->anchors[s->y*ss->w+s->x]; *sp != s; sp = &(*sp)->anext)
+	assert(*sp);
+    *sp = s->anext;
+    ss->rowcount[s->y]--;
+    ss->count--;
 
     /*
      * Destroy the actual set structure.
@@ -477,56 +509,63 @@ static void ss_remove(struct setstore *ss, struct set *s)
 }
 
 /*
- * Return a dynamically allocated list of all the sets which
- * overlap a provided input set.
+ * Return a NULL-terminated list of all the sets which overlap a
+ * provided input set. The list is owned by the setstore, and is only
+ * valid until the next call to this function.
  */
 static struct set **ss_overlap(struct setstore *ss, int x, int y, int mask)
 {
-    struct set **ret = NULL;
-    int nret = 0, retsize = 0;
+    int nret = 0;
     int xx, yy;
 
-    for (xx = x-3; xx < x+3; xx++)
-	for (yy = y-3; yy < y+3; yy++) {
-	    struct set stmp, *s;
-	    int pos;
-
-	    /*
-	     * Find the first set with these top left coordinates.
-	     */
-	    stmp.x = xx;
-	    stmp.y = yy;
-	    stmp.mask = 0;
+    for (xx = max(x-3, 0); xx < min(x+3, ss->w); xx++)
+	for (yy = max(y-3, 0); yy < min(y+3, ss->h); yy++) {
+	    struct set *s;
 
-	    if (findrelpos234(ss->sets, &stmp, NULL, REL234_GE, &pos)) {
-		while ((s = index234(ss->sets, pos)) != NULL &&
-		       s->x == xx && s->y == yy) {
-		    /*
-		     * This set potentially overlaps the input one.
-		     * Compute the intersection to see if they
-		     * really overlap, and add it to the list if
-		     * so.
-		     */
-		    if (setmunge(x, y, mask, s->x, s->y, s->mask, FALSE)) {
-			/*
-			 * There's an overlap.
-			 */
-			if (nret >= retsize) {
-			    retsize = nret + 32;
-			    ret = sresize(ret, retsize, struct set *);
-			}
-			ret[nret++] = s;
+	    for (s = ss->anchors[yy*ss->w+xx]; s; s = s->anext) {
+		/*
+		 * This set potentially overlaps the input one.
+		 * Compute the intersection to see if they really
+		 * overlap, and add it to the list if so.
+		 */
+		if (setmunge(x, y, mask, s->x, s->y, s->mask, FALSE)) {
+		    if (nret + 1 >= ss->overlapsize) {
+			ss->overlapsize = nret + 32;
+			ss->overlap = sresize(ss->overlap, ss->overlapsize,
+					      struct set *);
 		    }
-
-		    pos++;
+		    ss->overlap[nret++] = s;
 		}
 	    }
 	}
 
-    ret = sresize(ret, nret+1, struct set *);
-    ret[nret] = NULL;
+    ss->overlap[nret] = NULL;
 
-    return ret;
+    return ss->overlap;
+}
+
+/*
+ * Return the set at a given position in the order of (y, x, mask),
+ * or NULL if there aren't that many.
+ */
+static struct set *ss_index(struct setstore *ss, int index)
+{
+    int x, y;
+
+    for (y = 0; y < ss->h && index >= ss->rowcount[y]; y++)
+	index -= ss->rowcount[y];
+    if (y == ss->h)
+	return NULL;
+
+    for (x = 0; x < ss->w; x++) {
+	struct set *s;
+	for (s = ss->anchors[y*ss->w+x]; s; s = s->anext)
+	    if (index-- == 0)
+		return s;
+    }
+
+    assert(!"rowcount out of step with anchor lists");
+    return NULL;
 }
 
 /*
@@ -642,7 +681,7 @@ static int minesolve(int w, int h, int n, signed char *grid,
                      perturb_cb perturb,
 		     void *ctx, random_state *rs)
 {
-    struct setstore *ss = ss_new();
+    struct setstore *ss = ss_new(w, h);
     struct set **list;
     struct squaretodo astd, *std = &astd;
     int x, y, i, j;
@@ -760,8 +799,6 @@ static int minesolve(int w, int h, int n, signed char *grid,
 		     */
 		    ss_remove(ss, s);
 		}
-
-		sfree(list);
 	    }
 
 	    /*
@@ -867,8 +904,6 @@ static int minesolve(int w, int h, int n, signed char *grid,
 		}
 	    }
 
-	    sfree(list);
-
 	    /*
 	     * In this situation we have definitely done
 	     * _something_, even if it's only reducing the size of
@@ -962,7 +997,7 @@ static int minesolve(int w, int h, int n, signed char *grid,
 	     * a bit slow for large n, so I artificially cap this
 	     * recursion at n=10 to avoid too much pain.
 	     */
-	    nsets = count234(ss->sets);
+	    nsets = ss->count;
 	    if (nsets <= lenof(setused)) {
 		/*
 		 * Doing this with actual recursive function calls
@@ -1009,7 +1044,7 @@ static int minesolve(int w, int h, int n, signed char *grid,
 		 */
 		struct set *sets[lenof(setused)];
 		for (i = 0; i < nsets; i++)
-		    sets[i] = index234(ss->sets, i);
+		    sets[i] = ss_index(ss, i);
 
 		cursor = 0;
 		while (1) {
@@ -1148,7 +1183,7 @@ static int minesolve(int w, int h, int n, signed char *grid,
 	{
 	    struct set *s;
 
-	    for (i = 0; (s = index234(ss->sets, i)) != NULL; i++)
+	    for (i = 0; (s = ss_index(ss, i)) != NULL; i++)
 		printf("remaining set: %d,%d %03x %d\n", s->x, s->y, s->mask, s->mines);
 	}
 #endif
@@ -1172,13 +1207,13 @@ static int minesolve(int w, int h, int n, signed char *grid,
 	     * 
 	     * If we have no sets at all, we must give up.
 	     */
-	    if (count234(ss->sets) == 0) {
+	    if (ss->count == 0) {
 #ifdef SOLVER_DIAGNOSTICS
 		printf("perturbing on entire unknown set\n");
 #endif
 		ret = perturb(ctx, grid, 0, 0, 0);
 	    } else {
-		s = index234(ss->sets, random_upto(rs, count234(ss->sets)));
+		s = ss_index(ss, random_upto(rs, ss->count));
 #ifdef SOLVER_DIAGNOSTICS
 		printf("perturbing on set %d,%d %03x\n", s->x, s->y, s->mask);
 #endif
@@ -1216,8 +1251,6 @@ static int minesolve(int w, int h, int n, signed char *grid,
 			list[j]->mines += ret->changes[i].delta;
 			ss_add_todo(ss, list[j]);
 		    }
-
-		    sfree(list);
 		}
 
 		/*
@@ -1249,7 +1282,7 @@ static int minesolve(int w, int h, int n, signed char *grid,
 		{
 		    struct set *s;
 
-		    for (i = 0; (s = index234(ss->sets, i)) != NULL; i++)
+		    for (i = 0; (s = ss_index(ss, i)) != NULL; i++)
 			printf("remaining set: %d,%d %03x %d\n", s->x, s->y, s->mask, s->mines);
 		}
 #endif
@@ -1282,14 +1315,8 @@ static int minesolve(int w, int h, int n, signed char *grid,
     /*
      * Free the set list and square-todo list.
      */
-    {
-	struct set *s;
-	while ((s = delpos234(ss->sets, 0)) != NULL)
-	    sfree(s);
-	freetree234(ss->sets);
-	sfree(ss);
-	sfree(std->next);
-    }
+    ss_free(ss);
+    sfree(std->next);
 
     return nperturbs;
 }
@@ -1949,6 +1976,264 @@ static char *new_mine_layout(int w, int h, int n, int x, int y, int unique,
     return grid;
 }
 
+#ifdef MINES_SPECULATE
+/*
+ * Speculative layout generation, for builds with MINES_SPECULATE
+ * defined (as the Unix makefiles do unless told not to use threads;
+ * see Recipe). It's off unless the MINES_THREADS environment variable
+ * sets the number of worker threads to use.
+ *
+ * While an ungenerated game is waiting for its first click, the
+ * workers generate the layouts that would result from clicking on
+ * the likeliest squares: the centre and corners to begin with, then
+ * wherever the keyboard cursor is moved or a mouse button goes down.
+ * Once the list of layouts is full, each new square pushes out the
+ * oldest one that hasn't been started (or, failing that, the oldest
+ * finished one), since the player has most likely moved on from it.
+ * Each works from its own copy of the layout's random state, so it
+ * produces exactly the layout the synchronous path would have. When
+ * the click comes, open_square takes the finished layout if there is
+ * one, waits for it if it's in progress, and otherwise generates it
+ * itself as usual.
+ *
+ * Workers can't be interrupted in the middle of minegen, so once the
+ * game has no further use for them they're just told to stop, and
+ * the last one out frees the structure.
+ */
+#define MAX_SPECULATIONS 12
+
+enum { SPEC_QUEUED, SPEC_RUNNING, SPEC_DONE, SPEC_TAKEN };
+
+struct speculation {
+    pthread_mutex_t lock;
+    pthread_cond_t work, done;
+    int refcount;		       /* the layout, plus each worker */
+    int stopped;
+
+    int w, h, n, unique;
+    random_state *rs;
+
+    int njobs;
+    struct {
+	int x, y, status;
+	char *grid, *desc;
+    } jobs[MAX_SPECULATIONS];	       /* in the order asked for */
+};
+
+static void spec_free(struct speculation *sp)
+{
+    int i;
+
+    for (i = 0; i < sp->njobs; i++) {
+	sfree(sp->jobs[i].grid);
+	sfree(sp->jobs[i].desc);
+    }
+    random_free(sp->rs);
+    pthread_mutex_destroy(&sp->lock);
+    pthread_cond_destroy(&sp->work);
+    pthread_cond_destroy(&sp->done);
+    sfree(sp);
+}
+
+static void *spec_thread(void *vsp)
+{
+    struct speculation *sp = (struct speculation *)vsp;
+    int i, last;
+
+    pthread_mutex_lock(&sp->lock);
+    while (!sp->stopped) {
+	random_state *rs;
+	char *grid, *desc;
+	int x, y;
+
+	/*
+	 * Take the most recently requested job, since that's the
+	 * best guess at where the player is about to click.
+	 */
+	for (i = sp->njobs; i-- > 0 ;)
+	    if (sp->jobs[i].status == SPEC_QUEUED)
+		break;
+	if (i < 0) {
+	    pthread_cond_wait(&sp->work, &sp->lock);
+	    continue;
+	}
+
+	sp->jobs[i].status = SPEC_RUNNING;
+	x = sp->jobs[i].x;
+	y = sp->jobs[i].y;
+	rs = random_copy(sp->rs);
+	pthread_mutex_unlock(&sp->lock);
+
+	grid = minegen(sp->w, sp->h, sp->n, x, y, sp->unique, rs);
+	desc = describe_layout(grid, sp->w * sp->h, x, y, TRUE);
+	random_free(rs);
+
+	/* The job may have moved in the list while we were busy. */
+	pthread_mutex_lock(&sp->lock);
+	for (i = 0; i < sp->njobs; i++)
+	    if (sp->jobs[i].x == x && sp->jobs[i].y == y)
+		break;
+	assert(i < sp->njobs);
+	sp->jobs[i].grid = grid;
+	sp->jobs[i].desc = desc;
+	sp->jobs[i].status = SPEC_DONE;
+	pthread_cond_broadcast(&sp->done);
+    }
+    last = (--sp->refcount == 0);
+    pthread_mutex_unlock(&sp->lock);
+
+    if (last)
+	spec_free(sp);
+    return NULL;
+}
+
+/* Take job i out of the list. The caller holds the lock. */
+static void spec_remove(struct speculation *sp, int i)
+{
+    sfree(sp->jobs[i].grid);
+    sfree(sp->jobs[i].desc);
+    sp->njobs--;
+    memmove(sp->jobs + i, sp->jobs + i + 1,
+	    (sp->njobs - i) * sizeof(sp->jobs[0]));
+}
+
+/*
+ * Ask for the layout resulting from a first click at x,y. A square
+ * asked for again goes back to the end of the queue, if it hasn't
+ * been started yet.
+ */
+static void spec_add(struct speculation *sp, int x, int y)
+{
+    int i;
+
+    pthread_mutex_lock(&sp->lock);
+    for (i = 0; i < sp->njobs; i++)
+	if (sp->jobs[i].x == x && sp->jobs[i].y == y)
+	    break;
+    if (i < sp->njobs) {
+	if (sp->jobs[i].status != SPEC_QUEUED) {
+	    pthread_mutex_unlock(&sp->lock);
+	    return;
+	}
+	spec_remove(sp, i);
+    } else if (sp->njobs == MAX_SPECULATIONS) {
+	for (i = 0; i < sp->njobs; i++)
+	    if (sp->jobs[i].status == SPEC_QUEUED)
+		break;
+	if (i == sp->njobs)
+	    for (i = 0; i < sp->njobs; i++)
+		if (sp->jobs[i].status == SPEC_DONE)
+		    break;
+	if (i == sp->njobs) {
+	    pthread_mutex_unlock(&sp->lock);
+	    return;		       /* everything's in progress */
+	}
+	spec_remove(sp, i);
+    }
+
+    i = sp->njobs++;
+    sp->jobs[i].x = x;
+    sp->jobs[i].y = y;
+    sp->jobs[i].status = SPEC_QUEUED;
+    sp->jobs[i].grid = sp->jobs[i].desc = NULL;
+    pthread_cond_signal(&sp->work);
+    pthread_mutex_unlock(&sp->lock);
+}
+
+static struct speculation *spec_new(int w, int h, int n, int unique,
+				    random_state *rs)
+{
+    struct speculation *sp;
+    const char *env = getenv("MINES_THREADS");
+    int nthreads = env ? atoi(env) : 0;
+    int i;
+
+    if (nthreads <= 0)
+	return NULL;
+
+    sp = snew(struct speculation);
+    pthread_mutex_init(&sp->lock, NULL);
+    pthread_cond_init(&sp->work, NULL);
+    pthread_cond_init(&sp->done, NULL);
+    sp->refcount = 1;
+    sp->stopped = FALSE;
+    sp->w = w;
+    sp->h = h;
+    sp->n = n;
+    sp->unique = unique;
+    sp->rs = random_copy(rs);
+    sp->njobs = 0;
+
+    /* Queued in increasing order of priority. */
+    spec_add(sp, 0, 0);
+    spec_add(sp, w-1, 0);
+    spec_add(sp, 0, h-1);
+    spec_add(sp, w-1, h-1);
+    spec_add(sp, w/2, h/2);
+
+    for (i = 0; i < nthreads; i++) {
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, spec_thread, sp) != 0)
+	    break;
+	pthread_detach(thread);
+	sp->refcount++;
+    }
+
+    return sp;
+}
+
+/*
+ * Tell the workers to stop, and drop the layout's reference. Any
+ * worker still in minegen frees the structure when it finishes.
+ */
+static void spec_stop(struct speculation *sp)
+{
+    int last;
+
+    pthread_mutex_lock(&sp->lock);
+    sp->stopped = TRUE;
+    pthread_cond_broadcast(&sp->work);
+    last = (--sp->refcount == 0);
+    pthread_mutex_unlock(&sp->lock);
+
+    if (last)
+	spec_free(sp);
+}
+
+/*
+ * Return the layout for a first click at x,y if it has been or is
+ * being generated, waiting for it if need be. Otherwise return NULL,
+ * and make sure no worker starts on it.
+ */
+static char *spec_take(struct speculation *sp, int x, int y, char **desc)
+{
+    char *grid = NULL;
+    int i;
+
+    pthread_mutex_lock(&sp->lock);
+    for (i = 0; i < sp->njobs; i++)
+	if (sp->jobs[i].x == x && sp->jobs[i].y == y)
+	    break;
+    if (i < sp->njobs) {
+	if (sp->jobs[i].status == SPEC_QUEUED) {
+	    sp->jobs[i].status = SPEC_TAKEN;
+	} else {
+	    while (sp->jobs[i].status == SPEC_RUNNING)
+		pthread_cond_wait(&sp->done, &sp->lock);
+	    if (sp->jobs[i].status == SPEC_DONE) {
+		grid = sp->jobs[i].grid;
+		*desc = sp->jobs[i].desc;
+		sp->jobs[i].grid = sp->jobs[i].desc = NULL;
+		sp->jobs[i].status = SPEC_TAKEN;
+	    }
+	}
+    }
+    pthread_mutex_unlock(&sp->lock);
+
+    return grid;
+}
+#endif
+
 static char *new_game_desc(const game_params *params, random_state *rs,
 			   char **aux, int interactive)
 {
@@ -2051,7 +2336,15 @@ static int open_square(game_state *state, int x, int y)
 	 * hasn't been generated yet. Generate it based on the
 	 * initial click location.
 	 */
-	char *desc, *privdesc;
+	char *desc = NULL, *privdesc;
+#ifdef MINES_SPECULATE
+	if (state->layout->spec) {
+	    state->layout->mines = spec_take(state->layout->spec, x, y, &desc);
+	    spec_stop(state->layout->spec);
+	    state->layout->spec = NULL;
+	}
+	if (!state->layout->mines)
+#endif
 	state->layout->mines = new_mine_layout(w, h, state->layout->n,
 					       x, y, state->layout->unique,
 					       state->layout->rs,
@@ -2199,6 +2492,11 @@ static game_state *new_game(midend *me, const game_params *params,
 	state->layout->mines = NULL;
 	state->layout->rs = random_state_decode(desc);
 	state->layout->me = me;
+#ifdef MINES_SPECULATE
+	state->layout->spec = spec_new(state->w, state->h, state->layout->n,
+				       state->layout->unique,
+				       state->layout->rs);
+#endif
 
     } else {
 	state->layout->rs = NULL;
@@ -2288,6 +2586,10 @@ static game_state *dup_game(const game_state *state)
 static void free_game(game_state *state)
 {
     if (--state->layout->refcount <= 0) {
+#ifdef MINES_SPECULATE
+	if (state->layout->spec)
+	    spec_stop(state->layout->spec);
+#endif
 	sfree(state->layout->mines);
 	if (state->layout->rs)
 	    random_free(state->layout->rs);
@@ -2426,6 +2728,10 @@ static char *interpret_move(const game_state *from, game_ui *ui,
     if (IS_CURSOR_MOVE(button)) {
         move_cursor(button, &ui->cur_x, &ui->cur_y, from->w, from->h, 0);
         ui->cur_visible = 1;
+#ifdef MINES_SPECULATE
+	if (from->layout->spec)
+	    spec_add(from->layout->spec, ui->cur_x, ui->cur_y);
+#endif
         return UI_UPDATE;
     }
     if (IS_CURSOR_SELECT(button)) {
@@ -2473,6 +2779,10 @@ static char *interpret_move(const game_state *from, game_ui *ui,
 	else if (button == MIDDLE_BUTTON)
 	    ui->validradius = 1;
         ui->cur_visible = 0;
+#ifdef MINES_SPECULATE
+	if (button == LEFT_BUTTON && from->layout->spec)
+	    spec_add(from->layout->spec, cx, cy);
+#endif
 	return UI_UPDATE;
     }
 
@@ -3185,6 +3495,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     TRUE, solve_game,
     TRUE, game_can_format_as_text_now, game_text_format,
     new_ui,
@@ -374,4 +374,35 @@ void copy_left_justified(char *buf, size_t sz, const char *str)
     buf[sz - 1] = 0;
 }
 
+solve_path *solve_path_new(int maxmoves)
+{
+    solve_path *path = snew(solve_path);
+    path->refcount = 1;
+    path->nmoves = 0;
+    path->moves = snewn(maxmoves > 0 ? maxmoves : 1, int);
+    return path;
+}
+
+solve_path *solve_path_ref(solve_path *path)
+{
+    if (path)
+        path->refcount++;
+    return path;
+}
+
+void solve_path_free(solve_path *path)
+{
+    if (path && --path->refcount == 0) {
+        sfree(path->moves);
+        sfree(path);
+    }
+}
+
+float solve_path_step_time(const solve_path *path, float steptime)
+{
+    if (path->nmoves * steptime > SOLVE_ANIM_TIME)
+        return SOLVE_ANIM_TIME / path->nmoves;
+    return steptime;
+}
+
 /* vim: set shiftwidth=4 tabstop=8: */
@@ -1741,6 +1741,73 @@ static void free_game(game_state *state)
     sfree(state);
 }
 
+/*
+ * A state snapshot, for binary save files, is the flags and the last
+ * rotation (for animating undo past it), then one character per tile
+ * giving its edges and lock.
+ */
+static const char snapshot_chars[] = "0123456789abcdefghijklmnopqrstuv";
+
+static char *encode_state(const game_state *state)
+{
+    int wh = state->width * state->height, i;
+    char *ret = snewn(wh + 80, char), *p;
+
+    p = ret + sprintf(ret, "%d,%d,%d,%d,%d:", state->completed,
+                      state->used_solve, state->last_rotate_x,
+                      state->last_rotate_y, state->last_rotate_dir);
+    for (i = 0; i < wh; i++)
+        *p++ = snapshot_chars[state->tiles[i] & (0xF | LOCKED)];
+    *p = '\0';
+    return ret;
+}
+
+static game_state *decode_state(const game_state *initial,
+                                const char *encoding)
+{
+    int wh = initial->width * initial->height;
+    int completed, used_solve, rx, ry, rdir, n, i;
+    signed char value[256];
+    int rotations[16];
+    game_state *ret;
+
+    if (sscanf(encoding, "%d,%d,%d,%d,%d:%n", &completed, &used_solve,
+               &rx, &ry, &rdir, &n) < 5 ||
+        rx < 0 || rx >= initial->width || ry < 0 || ry >= initial->height ||
+        rdir < -1 || rdir > +1 || (int)strlen(encoding + n) != wh)
+        return NULL;
+    encoding += n;
+
+    ret = dup_game(initial);
+    ret->completed = completed;
+    ret->used_solve = used_solve;
+    ret->last_rotate_x = rx;
+    ret->last_rotate_y = ry;
+    ret->last_rotate_dir = rdir;
+
+    /*
+     * Every tile must be a valid character, and must be a rotation of
+     * the tile it started as: value[] maps each character back to its
+     * tile, and bit t of rotations[x] is set if t is a rotation of x.
+     */
+    memset(value, -1, sizeof(value));
+    for (i = 0; snapshot_chars[i]; i++)
+        value[(unsigned char)snapshot_chars[i]] = i;
+    for (i = 0; i < 16; i++)
+        rotations[i] = 1 << i | 1 << A(i) | 1 << F(i) | 1 << C(i);
+    for (i = 0; i < wh; i++) {
+        int t = value[(unsigned char)encoding[i]];
+
+        if (t < 0 || !(rotations[initial->tiles[i] & 0xF] >> (t & 0xF) & 1)) {
+            free_game(ret);
+            return NULL;
+        }
+        ret->tiles[i] = t;
+    }
+
+    return ret;
+}
+
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *aux, const char **error)
 {
@@ -3230,6 +3297,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    encode_state, decode_state,
     TRUE, solve_game,
     FALSE, game_can_format_as_text_now, game_text_format,
     new_ui,
@@ -112,6 +112,7 @@ typedef struct document document;
 typedef struct drawing_api drawing_api;
 typedef struct drawing drawing;
 typedef struct psdata psdata;
+typedef struct raster raster;
 
 #define ALIGN_VNORMAL 0x000
 #define ALIGN_VCENTRE 0x100
@@ -327,6 +328,10 @@ char *midend_rewrite_statusbar(midend *me, const char *text);
 void midend_serialise(midend *me,
                       void (*write)(void *ctx, const void *buf, int len),
                       void *wctx);
+void midend_serialise_binary(midend *me,
+                             void (*write)(void *ctx, const void *buf,
+                                           int len),
+                             void *wctx);
 const char *midend_deserialise(midend *me,
                                int (*read)(void *ctx, void *buf, int len),
                                void *rctx);
@@ -334,6 +339,9 @@ const char *identify_game(char **name,
                           int (*read)(void *ctx, void *buf, int len),
                           void *rctx);
 void midend_request_id_changes(midend *me, void (*notify)(void *), void *ctx);
+void midend_set_fast_random(midend *me, int fast);
+void midend_set_undo_keyframes(midend *me, int interval);
+void midend_set_pool(midend *me, int size);
 /* Printing functions supplied by the mid-end */
 const char *midend_print_puzzle(midend *me, document *doc, int with_soln);
 int midend_tilesize(midend *me);
@@ -345,6 +353,10 @@ void *smalloc(size_t size);
 void *srealloc(void *p, size_t size);
 void sfree(void *p);
 char *dupstr(const char *s);
+/* Running totals of calls to smalloc and srealloc and the bytes they
+ * asked for. These only exist if malloc.c is built with MALLOC_STATS
+ * defined, as it is for the benchmark program. */
+extern unsigned long smalloc_count, smalloc_bytes;
 #define snew(type) \
     ( (type *) smalloc (sizeof (type)) )
 #define snewn(number, type) \
@@ -399,6 +411,29 @@ void draw_text_outline(drawing *dr, int x, int y, int fonttype,
  * less than buffer size. */
 void copy_left_justified(char *buf, size_t sz, const char *str);
 
+/*
+ * The steps of a Solve move, kept by games with SOLVE_ANIMATES so
+ * that game_redraw can play them back one at a time; what a step
+ * means is up to the game. Reference-counted so that dup_game can
+ * share it: solve_path_new returns an empty path (with room for
+ * maxmoves steps) holding one reference, and solve_path_ref and
+ * solve_path_free take and drop one, accepting NULL.
+ */
+typedef struct solve_path {
+    int refcount;
+    int nmoves;
+    int *moves;
+} solve_path;
+solve_path *solve_path_new(int maxmoves);
+solve_path *solve_path_ref(solve_path *path);
+void solve_path_free(solve_path *path);
+
+/* The whole of a Solve animation takes at most SOLVE_ANIM_TIME, so
+ * this returns the time for each step: `steptime' (the length of an
+ * ordinary move) unless the path is too long for that. */
+#define SOLVE_ANIM_TIME 3.0F
+float solve_path_step_time(const solve_path *path, float steptime);
+
 /*
  * dsf.c
  */
@@ -422,6 +457,31 @@ void edsf_merge(int *dsf, int v1, int v2, int inverse);
 void dsf_merge(int *dsf, int v1, int v2);
 void dsf_init(int *dsf, int len);
 
+/*
+ * A dsf variant for backtracking solvers, which can undo merges
+ * instead of having to copy the whole array to save and restore it.
+ * rdsf_checkpoint returns a marker for the current set of merges, and
+ * rdsf_rollback undoes every merge made since that marker was taken,
+ * in time proportional to the number undone. Checkpoints nest: rolling
+ * back to one invalidates any taken after it.
+ *
+ * The price is that canonify doesn't compress paths, so takes
+ * logarithmic rather than nearly constant time; and the canonical
+ * element of a class is no longer necessarily its smallest member.
+ *
+ * rdsf_merge returns TRUE if it joined two different classes, and
+ * fails an assertion on contradictory data as edsf_merge does.
+ */
+typedef struct rdsf rdsf;
+rdsf *rdsf_new(int size);
+void rdsf_free(rdsf *r);
+void rdsf_reset(rdsf *r);      /* split everything back into singletons */
+int rdsf_canonify(rdsf *r, int val, int *inverse);
+int rdsf_size(rdsf *r, int val);
+int rdsf_merge(rdsf *r, int v1, int v2, int inverse);
+int rdsf_checkpoint(rdsf *r);
+void rdsf_rollback(rdsf *r, int checkpoint);
+
 /*
  * tdq.c
  */
@@ -458,6 +518,7 @@ void tdq_free(tdq *tdq);
 void tdq_add(tdq *tdq, int k);
 int tdq_remove(tdq *tdq);        /* returns -1 if nothing available */
 void tdq_fill(tdq *tdq);         /* add everything to the tdq at once */
+void tdq_copy(tdq *dst, const tdq *src); /* both the same size */
 
 /*
  * laydomino.c
@@ -474,6 +535,7 @@ extern char ver[];
  * random.c
  */
 random_state *random_new(const char *seed, int len);
+random_state *random_new_fast(const char *seed, int len);
 random_state *random_copy(random_state *tocopy);
 unsigned long random_bits(random_state *state, int bits);
 unsigned long random_upto(random_state *state, unsigned long limit);
@@ -516,6 +578,29 @@ psdata *ps_init(FILE *outfile, int colour);
 void ps_free(psdata *ps);
 drawing *ps_drawing_api(psdata *ps);
 
+/*
+ * cputime.c: user CPU time used by the calling thread, in seconds, or
+ * by the whole process where the OS can't say which
+ * (thread_cpu_time_is_per_thread tells you).
+ */
+double thread_cpu_time(void);
+extern const int thread_cpu_time_is_per_thread;
+
+/*
+ * raster.c: renders into an in-memory RGBA image, for use without a
+ * GUI (pass &raster_drawing and the raster to midend_new). Set the
+ * colours and then the size before the first redraw; raster_resize
+ * clears the image to colour 0.
+ */
+raster *raster_new(void);
+void raster_free(raster *r);
+void raster_set_colours(raster *r, const float *colours, int ncolours);
+void raster_resize(raster *r, int w, int h);
+const unsigned char *raster_pixels(raster *r, int *w, int *h);
+int raster_write_png(raster *r, FILE *fp);
+int raster_write_ppm(raster *r, FILE *fp);
+extern const drawing_api raster_drawing;
+
 /*
  * combi.c: provides a structure and functions for iterating over
  * combinations (i.e. choosing r things out of n).
@@ -599,6 +684,9 @@ struct game {
                             const char *desc);
     game_state *(*dup_game)(const game_state *state);
     void (*free_game)(game_state *state);
+    char *(*encode_state)(const game_state *state);
+    game_state *(*decode_state)(const game_state *initial,
+                                const char *encoding);
     int can_solve;
     char *(*solve)(const game_state *orig, const game_state *curr,
                    const char *aux, const char **error);
@@ -8,6 +8,13 @@
  * The generator is based on SHA-1. This is almost certainly
  * overkill, but I had the SHA-1 code kicking around and it was
  * easier to reuse it than to do anything else!
+ *
+ * For bulk generation, where the SHA-1 generator's speed starts to
+ * matter, random_new_fast() instead makes a random_state driven by
+ * xoshiro128** (seeded from the SHA-1 of the seed data). It's just
+ * as portable, but it produces a different stream, so a seed only
+ * reproduces a game if the same kind of random_state is used both
+ * times.
  */
 
 #include <assert.h>
@@ -205,8 +212,29 @@ struct random_state {
     unsigned char seedbuf[40];
     unsigned char databuf[20];
     int pos;
+    int fast;                          /* use xs[] instead of the above */
+    uint32 xs[4];
 };
 
+#define XS_MASK 0xFFFFFFFFUL
+#define xs_rol(x,y) ( (((x) << (y)) | ((x) >> (32-(y)))) & XS_MASK )
+
+static uint32 xoshiro_next(random_state *state)
+{
+    uint32 *s = state->xs;
+    uint32 ret = xs_rol((s[1] * 5) & XS_MASK, 7) * 9 & XS_MASK;
+    uint32 t = (s[1] << 9) & XS_MASK;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = xs_rol(s[3], 11);
+
+    return ret;
+}
+
 random_state *random_new(const char *seed, int len)
 {
     random_state *state;
@@ -217,6 +245,28 @@ random_state *random_new(const char *seed, int len)
     SHA_Simple(state->seedbuf, 20, state->seedbuf + 20);
     SHA_Simple(state->seedbuf, 40, state->databuf);
     state->pos = 0;
+    state->fast = FALSE;
+
+    return state;
+}
+
+random_state *random_new_fast(const char *seed, int len)
+{
+    random_state *state;
+    unsigned char digest[20];
+    int i;
+
+    state = snew(random_state);
+    memset(state, 0, sizeof(*state));
+    state->fast = TRUE;
+
+    SHA_Simple(seed, len, digest);
+    for (i = 0; i < 4; i++)
+        state->xs[i] = ((uint32)digest[4*i] << 24) |
+            ((uint32)digest[4*i+1] << 16) |
+            ((uint32)digest[4*i+2] << 8) | (uint32)digest[4*i+3];
+    if (!(state->xs[0] | state->xs[1] | state->xs[2] | state->xs[3]))
+        state->xs[0] = 1;              /* all-zero state is a fixed point */
 
     return state;
 }
@@ -225,9 +275,7 @@ random_state *random_copy(random_state *tocopy)
 {
     random_state *result;
     result = snew(random_state);
-    memcpy(result->seedbuf, tocopy->seedbuf, sizeof(result->seedbuf));
-    memcpy(result->databuf, tocopy->databuf, sizeof(result->databuf));
-    result->pos = tocopy->pos;
+    *result = *tocopy;
     return result;
 }
 
@@ -236,6 +284,17 @@ unsigned long random_bits(random_state *state, int bits)
     unsigned long ret = 0;
     int n;
 
+    if (state->fast) {
+        /*
+         * The top bits of xoshiro128** output are the best ones. A
+         * request for no bits at all would shift by 32, so it gets 0
+         * without using up any output, as in the SHA-1 generator.
+         */
+        if (bits == 0)
+            return 0;
+        return (unsigned long)(xoshiro_next(state) >> (32 - bits));
+    }
+
     for (n = 0; n < bits; n += 8) {
 	if (state->pos >= 20) {
 	    int i;
@@ -295,6 +354,17 @@ char *random_state_encode(random_state *state)
     char retbuf[256];
     int len = 0, i;
 
+    /*
+     * A fast state is encoded with a leading 'X', which can't appear
+     * in the hex encoding of a SHA-1 one.
+     */
+    if (state->fast) {
+        retbuf[len++] = 'X';
+        for (i = 0; i < 4; i++)
+            len += sprintf(retbuf+len, "%08lx", (unsigned long)state->xs[i]);
+        return dupstr(retbuf);
+    }
+
     for (i = 0; i < lenof(state->seedbuf); i++)
 	len += sprintf(retbuf+len, "%02x", state->seedbuf[i]);
     for (i = 0; i < lenof(state->databuf); i++)
@@ -311,9 +381,28 @@ random_state *random_state_decode(const char *input)
 
     state = snew(random_state);
 
-    memset(state->seedbuf, 0, sizeof(state->seedbuf));
-    memset(state->databuf, 0, sizeof(state->databuf));
-    state->pos = 0;
+    memset(state, 0, sizeof(*state));
+
+    if (*input == 'X') {
+        state->fast = TRUE;
+        for (input++, pos = 0; *input && pos < 32; input++, pos++) {
+            int v = *input;
+
+            if (v >= '0' && v <= '9')
+                v = v - '0';
+            else if (v >= 'A' && v <= 'F')
+                v = v - 'A' + 10;
+            else if (v >= 'a' && v <= 'f')
+                v = v - 'a' + 10;
+            else
+                v = 0;
+
+            state->xs[pos / 8] = (state->xs[pos / 8] << 4) | v;
+        }
+        if (!(state->xs[0] | state->xs[1] | state->xs[2] | state->xs[3]))
+            state->xs[0] = 1;
+        return state;
+    }
 
     byte = digits = 0;
     pos = 0;
@@ -0,0 +1,645 @@
+/*
+ * raster.c: a drawing API implementation which renders into an
+ * in-memory RGBA image, with no dependence on any GUI toolkit, plus
+ * functions to write the result out as a PNG or PPM file.
+ *
+ * Drawing follows the conventions of the GTK front end: integer
+ * coordinates name pixels, and polygon and circle outlines are one
+ * pixel wide. There's no anti-aliasing. Text is drawn from a small
+ * built-in bitmap font scaled up to roughly the requested size, so it
+ * is legible rather than pretty, and only printable ASCII is
+ * supported (we ask for the ASCII fallback of any text that offers
+ * one).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "puzzles.h"
+
+struct raster {
+    int w, h;
+    unsigned char *pixels;	       /* w*h*4 bytes, RGBA */
+    unsigned char *colours;	       /* ncolours*4 bytes, RGBA */
+    int ncolours;
+    int clipx0, clipy0, clipx1, clipy1; /* clip rectangle, [x0,x1)x[y0,y1) */
+};
+
+struct blitter {
+    int w, h;
+    int x, y;			       /* where it was last saved from */
+    unsigned char *pixels;
+};
+
+raster *raster_new(void)
+{
+    raster *r = snew(raster);
+
+    r->w = r->h = 0;
+    r->pixels = NULL;
+    r->colours = NULL;
+    r->ncolours = 0;
+    r->clipx0 = r->clipy0 = r->clipx1 = r->clipy1 = 0;
+
+    return r;
+}
+
+void raster_free(raster *r)
+{
+    sfree(r->pixels);
+    sfree(r->colours);
+    sfree(r);
+}
+
+void raster_set_colours(raster *r, const float *colours, int ncolours)
+{
+    int i, j;
+
+    sfree(r->colours);
+    r->colours = snewn(4 * ncolours, unsigned char);
+    r->ncolours = ncolours;
+    for (i = 0; i < ncolours; i++) {
+	for (j = 0; j < 3; j++) {
+	    float c = colours[3*i+j];
+	    r->colours[4*i+j] = (c <= 0 ? 0 : c >= 1 ? 255 :
+				 (unsigned char)(c * 255.0F + 0.5F));
+	}
+	r->colours[4*i+3] = 255;
+    }
+}
+
+/*
+ * Set the size of the image, and fill it with colour 0 (the
+ * background colour, in every game) if we know it yet.
+ */
+void raster_resize(raster *r, int w, int h)
+{
+    int i;
+
+    sfree(r->pixels);
+    r->w = w;
+    r->h = h;
+    r->pixels = snewn(4 * w * h, unsigned char);
+    for (i = 0; i < w * h; i++) {
+	if (r->ncolours > 0)
+	    memcpy(r->pixels + 4*i, r->colours, 4);
+	else
+	    memset(r->pixels + 4*i, 255, 4);
+    }
+    r->clipx0 = r->clipy0 = 0;
+    r->clipx1 = w;
+    r->clipy1 = h;
+}
+
+const unsigned char *raster_pixels(raster *r, int *w, int *h)
+{
+    *w = r->w;
+    *h = r->h;
+    return r->pixels;
+}
+
+/* ----------------------------------------------------------------------
+ * Primitive pixel operations. Everything is clipped here.
+ */
+
+static void raster_span(raster *r, int x0, int x1, int y, int colour)
+{
+    unsigned char *p;
+
+    assert(colour >= 0 && colour < r->ncolours);
+    if (y < r->clipy0 || y >= r->clipy1)
+	return;
+    if (x0 < r->clipx0)
+	x0 = r->clipx0;
+    if (x1 > r->clipx1)
+	x1 = r->clipx1;
+    for (p = r->pixels + 4 * (y * r->w + x0); x0 < x1; x0++, p += 4)
+	memcpy(p, r->colours + 4*colour, 4);
+}
+
+static void raster_plot(raster *r, int x, int y, int colour)
+{
+    raster_span(r, x, x+1, y, colour);
+}
+
+/*
+ * Fill a polygon given by floating-point vertices, setting each pixel
+ * whose centre lies inside it (by the even-odd rule).
+ */
+static void raster_fill_poly(raster *r, const double *pts, int n, int colour)
+{
+    double miny, maxy, *xs;
+    int i, j, k, y, nxs;
+
+    miny = maxy = pts[1];
+    for (i = 1; i < n; i++) {
+	if (miny > pts[2*i+1]) miny = pts[2*i+1];
+	if (maxy < pts[2*i+1]) maxy = pts[2*i+1];
+    }
+
+    xs = snewn(n, double);
+    for (y = (int)ceil(miny - 0.5); y + 0.5 < maxy; y++) {
+	double yc = y + 0.5;
+
+	nxs = 0;
+	for (i = 0; i < n; i++) {
+	    const double *a = pts + 2*i, *b = pts + 2*((i+1) % n);
+	    if ((a[1] <= yc && yc < b[1]) || (b[1] <= yc && yc < a[1]))
+		xs[nxs++] = a[0] + (yc - a[1]) * (b[0] - a[0]) / (b[1] - a[1]);
+	}
+
+	/* Insertion sort: there are only ever a handful of crossings. */
+	for (i = 1; i < nxs; i++) {
+	    double t = xs[i];
+	    for (j = i; j > 0 && xs[j-1] > t; j--)
+		xs[j] = xs[j-1];
+	    xs[j] = t;
+	}
+
+	for (k = 0; k + 1 < nxs; k += 2)
+	    raster_span(r, (int)ceil(xs[k] - 0.5), (int)ceil(xs[k+1] - 0.5),
+			y, colour);
+    }
+    sfree(xs);
+}
+
+/* ----------------------------------------------------------------------
+ * The drawing API.
+ */
+
+/*
+ * A 5x7 bitmap font covering printable ASCII. Each glyph is seven
+ * rows from top to bottom, with the leftmost pixel in bit 4.
+ */
+static const unsigned char raster_font[95][7] = {
+    {0x00,0x00,0x00,0x00,0x00,0x00,0x00}, /* space */
+    {0x04,0x04,0x04,0x04,0x04,0x00,0x04}, /* ! */
+    {0x0a,0x0a,0x0a,0x00,0x00,0x00,0x00}, /* " */
+    {0x0a,0x0a,0x1f,0x0a,0x1f,0x0a,0x0a}, /* # */
+    {0x04,0x0f,0x14,0x0e,0x05,0x1e,0x04}, /* $ */
+    {0x18,0x19,0x02,0x04,0x08,0x13,0x03}, /* % */
+    {0x0c,0x12,0x14,0x08,0x15,0x12,0x0d}, /* & */
+    {0x04,0x04,0x08,0x00,0x00,0x00,0x00}, /* ' */
+    {0x02,0x04,0x08,0x08,0x08,0x04,0x02}, /* ( */
+    {0x08,0x04,0x02,0x02,0x02,0x04,0x08}, /* ) */
+    {0x00,0x04,0x15,0x0e,0x15,0x04,0x00}, /* asterisk */
+    {0x00,0x04,0x04,0x1f,0x04,0x04,0x00}, /* + */
+    {0x00,0x00,0x00,0x00,0x0c,0x04,0x08}, /* , */
+    {0x00,0x00,0x00,0x1f,0x00,0x00,0x00}, /* - */
+    {0x00,0x00,0x00,0x00,0x00,0x0c,0x0c}, /* . */
+    {0x00,0x01,0x02,0x04,0x08,0x10,0x00}, /* slash */
+    {0x0e,0x11,0x13,0x15,0x19,0x11,0x0e}, /* 0 */
+    {0x04,0x0c,0x04,0x04,0x04,0x04,0x0e}, /* 1 */
+    {0x0e,0x11,0x01,0x02,0x04,0x08,0x1f}, /* 2 */
+    {0x1f,0x02,0x04,0x02,0x01,0x11,0x0e}, /* 3 */
+    {0x02,0x06,0x0a,0x12,0x1f,0x02,0x02}, /* 4 */
+    {0x1f,0x10,0x1e,0x01,0x01,0x11,0x0e}, /* 5 */
+    {0x06,0x08,0x10,0x1e,0x11,0x11,0x0e}, /* 6 */
+    {0x1f,0x01,0x02,0x04,0x08,0x08,0x08}, /* 7 */
+    {0x0e,0x11,0x11,0x0e,0x11,0x11,0x0e}, /* 8 */
+    {0x0e,0x11,0x11,0x0f,0x01,0x02,0x0c}, /* 9 */
+    {0x00,0x0c,0x0c,0x00,0x0c,0x0c,0x00}, /* : */
+    {0x00,0x0c,0x0c,0x00,0x0c,0x04,0x08}, /* ; */
+    {0x02,0x04,0x08,0x10,0x08,0x04,0x02}, /* < */
+    {0x00,0x00,0x1f,0x00,0x1f,0x00,0x00}, /* = */
+    {0x08,0x04,0x02,0x01,0x02,0x04,0x08}, /* > */
+    {0x0e,0x11,0x01,0x02,0x04,0x00,0x04}, /* ? */
+    {0x0e,0x11,0x01,0x0d,0x15,0x15,0x0e}, /* @ */
+    {0x0e,0x11,0x11,0x1f,0x11,0x11,0x11}, /* A */
+    {0x1e,0x11,0x11,0x1e,0x11,0x11,0x1e}, /* B */
+    {0x0e,0x11,0x10,0x10,0x10,0x11,0x0e}, /* C */
+    {0x1c,0x12,0x11,0x11,0x11,0x12,0x1c}, /* D */
+    {0x1f,0x10,0x10,0x1e,0x10,0x10,0x1f}, /* E */
+    {0x1f,0x10,0x10,0x1e,0x10,0x10,0x10}, /* F */
+    {0x0e,0x11,0x10,0x17,0x11,0x11,0x0f}, /* G */
+    {0x11,0x11,0x11,0x1f,0x11,0x11,0x11}, /* H */
+    {0x0e,0x04,0x04,0x04,0x04,0x04,0x0e}, /* I */
+    {0x07,0x02,0x02,0x02,0x02,0x12,0x0c}, /* J */
+    {0x11,0x12,0x14,0x18,0x14,0x12,0x11}, /* K */
+    {0x10,0x10,0x10,0x10,0x10,0x10,0x1f}, /* L */
+    {0x11,0x1b,0x15,0x15,0x11,0x11,0x11}, /* M */
+    {0x11,0x11,0x19,0x15,0x13,0x11,0x11}, /* N */
+    {0x0e,0x11,0x11,0x11,0x11,0x11,0x0e}, /* O */
+    {0x1e,0x11,0x11,0x1e,0x10,0x10,0x10}, /* P */
+    {0x0e,0x11,0x11,0x11,0x15,0x12,0x0d}, /* Q */
+    {0x1e,0x11,0x11,0x1e,0x14,0x12,0x11}, /* R */
+    {0x0f,0x10,0x10,0x0e,0x01,0x01,0x1e}, /* S */
+    {0x1f,0x04,0x04,0x04,0x04,0x04,0x04}, /* T */
+    {0x11,0x11,0x11,0x11,0x11,0x11,0x0e}, /* U */
+    {0x11,0x11,0x11,0x11,0x11,0x0a,0x04}, /* V */
+    {0x11,0x11,0x11,0x15,0x15,0x15,0x0a}, /* W */
+    {0x11,0x11,0x0a,0x04,0x0a,0x11,0x11}, /* X */
+    {0x11,0x11,0x11,0x0a,0x04,0x04,0x04}, /* Y */
+    {0x1f,0x01,0x02,0x04,0x08,0x10,0x1f}, /* Z */
+    {0x0e,0x08,0x08,0x08,0x08,0x08,0x0e}, /* [ */
+    {0x00,0x10,0x08,0x04,0x02,0x01,0x00}, /* backslash */
+    {0x0e,0x02,0x02,0x02,0x02,0x02,0x0e}, /* ] */
+    {0x04,0x0a,0x11,0x00,0x00,0x00,0x00}, /* ^ */
+    {0x00,0x00,0x00,0x00,0x00,0x00,0x1f}, /* _ */
+    {0x08,0x04,0x02,0x00,0x00,0x00,0x00}, /* ` */
+    {0x00,0x00,0x0e,0x01,0x0f,0x11,0x0f}, /* a */
+    {0x10,0x10,0x16,0x19,0x11,0x11,0x1e}, /* b */
+    {0x00,0x00,0x0e,0x10,0x10,0x11,0x0e}, /* c */
+    {0x01,0x01,0x0d,0x13,0x11,0x11,0x0f}, /* d */
+    {0x00,0x00,0x0e,0x11,0x1f,0x10,0x0e}, /* e */
+    {0x06,0x09,0x08,0x1c,0x08,0x08,0x08}, /* f */
+    {0x00,0x0f,0x11,0x11,0x0f,0x01,0x0e}, /* g */
+    {0x10,0x10,0x16,0x19,0x11,0x11,0x11}, /* h */
+    {0x04,0x00,0x0c,0x04,0x04,0x04,0x0e}, /* i */
+    {0x02,0x00,0x06,0x02,0x02,0x12,0x0c}, /* j */
+    {0x10,0x10,0x12,0x14,0x18,0x14,0x12}, /* k */
+    {0x0c,0x04,0x04,0x04,0x04,0x04,0x0e}, /* l */
+    {0x00,0x00,0x1a,0x15,0x15,0x11,0x11}, /* m */
+    {0x00,0x00,0x16,0x19,0x11,0x11,0x11}, /* n */
+    {0x00,0x00,0x0e,0x11,0x11,0x11,0x0e}, /* o */
+    {0x00,0x00,0x1e,0x11,0x1e,0x10,0x10}, /* p */
+    {0x00,0x00,0x0d,0x13,0x0f,0x01,0x01}, /* q */
+    {0x00,0x00,0x16,0x19,0x10,0x10,0x10}, /* r */
+    {0x00,0x00,0x0e,0x10,0x0e,0x01,0x1e}, /* s */
+    {0x08,0x08,0x1c,0x08,0x08,0x09,0x06}, /* t */
+    {0x00,0x00,0x11,0x11,0x11,0x13,0x0d}, /* u */
+    {0x00,0x00,0x11,0x11,0x11,0x0a,0x04}, /* v */
+    {0x00,0x00,0x11,0x11,0x15,0x15,0x0a}, /* w */
+    {0x00,0x00,0x11,0x0a,0x04,0x0a,0x11}, /* x */
+    {0x00,0x00,0x11,0x11,0x0f,0x01,0x0e}, /* y */
+    {0x00,0x00,0x1f,0x02,0x04,0x08,0x1f}, /* z */
+    {0x02,0x04,0x04,0x08,0x04,0x04,0x02}, /* { */
+    {0x04,0x04,0x04,0x04,0x04,0x04,0x04}, /* | */
+    {0x08,0x04,0x04,0x02,0x04,0x04,0x08}, /* } */
+    {0x00,0x00,0x08,0x15,0x02,0x00,0x00}, /* ~ */
+};
+#define GLYPH_W 6			       /* including a column of spacing */
+#define GLYPH_H 7
+
+static void raster_draw_text(void *handle, int x, int y, int fonttype,
+			     int fontsize, int align, int colour,
+			     const char *text)
+{
+    raster *r = (raster *)handle;
+    int scale = (fontsize + GLYPH_H / 2 + 1) / (GLYPH_H + 1);
+    int len = strlen(text), width, gx, gy, i;
+
+    if (scale < 1)
+	scale = 1;
+    width = (len * GLYPH_W - 1) * scale;
+
+    if (align & ALIGN_HCENTRE)
+	x -= width / 2;
+    else if (align & ALIGN_HRIGHT)
+	x -= width;
+    if (align & ALIGN_VCENTRE)
+	y -= GLYPH_H * scale / 2;
+    else
+	y -= GLYPH_H * scale;	       /* y was the baseline */
+
+    for (i = 0; i < len; i++) {
+	unsigned char c = text[i];
+	const unsigned char *glyph;
+
+	if (c < 32 || c > 126)
+	    c = '?';
+	glyph = raster_font[c - 32];
+	for (gy = 0; gy < GLYPH_H; gy++)
+	    for (gx = 0; gx < GLYPH_W - 1; gx++)
+		if (glyph[gy] & (0x10 >> gx)) {
+		    int px = x + (i * GLYPH_W + gx) * scale;
+		    int py = y + gy * scale, k;
+		    for (k = 0; k < scale; k++)
+			raster_span(r, px, px + scale, py + k, colour);
+		}
+    }
+}
+
+static void raster_draw_rect(void *handle, int x, int y, int w, int h,
+			     int colour)
+{
+    raster *r = (raster *)handle;
+    int yy;
+
+    for (yy = y; yy < y + h; yy++)
+	raster_span(r, x, x + w, yy, colour);
+}
+
+static void raster_draw_line(void *handle, int x1, int y1, int x2, int y2,
+			     int colour)
+{
+    raster *r = (raster *)handle;
+    int dx = abs(x2 - x1), dy = -abs(y2 - y1);
+    int sx = x1 < x2 ? 1 : -1, sy = y1 < y2 ? 1 : -1;
+    int err = dx + dy, e2;
+
+    /* Bresenham, including both endpoints. */
+    while (1) {
+	raster_plot(r, x1, y1, colour);
+	if (x1 == x2 && y1 == y2)
+	    break;
+	e2 = 2 * err;
+	if (e2 >= dy) {
+	    err += dy;
+	    x1 += sx;
+	}
+	if (e2 <= dx) {
+	    err += dx;
+	    y1 += sy;
+	}
+    }
+}
+
+static void raster_draw_thick_line(void *handle, float thickness,
+				   float x1, float y1, float x2, float y2,
+				   int colour)
+{
+    raster *r = (raster *)handle;
+    double dx = x2 - x1, dy = y2 - y1, len = sqrt(dx*dx + dy*dy);
+    double pts[8], ux, uy;
+
+    /*
+     * Fill the rectangle covered by the line, with square ends as
+     * the GTK front end draws it.
+     */
+    if (len == 0) {
+	ux = thickness / 2;
+	uy = 0;
+    } else {
+	ux = dx / len * thickness / 2;
+	uy = dy / len * thickness / 2;
+    }
+    pts[0] = x1 - ux - uy; pts[1] = y1 - uy + ux;
+    pts[2] = x2 + ux - uy; pts[3] = y2 + uy + ux;
+    pts[4] = x2 + ux + uy; pts[5] = y2 + uy - ux;
+    pts[6] = x1 - ux + uy; pts[7] = y1 - uy - ux;
+    raster_fill_poly(r, pts, 4, colour);
+}
+
+static void raster_draw_polygon(void *handle, int *coords, int npoints,
+				int fillcolour, int outlinecolour)
+{
+    raster *r = (raster *)handle;
+    int i;
+
+    if (fillcolour >= 0) {
+	double *pts = snewn(2 * npoints, double);
+	for (i = 0; i < 2 * npoints; i++)
+	    pts[i] = coords[i] + 0.5;
+	raster_fill_poly(r, pts, npoints, fillcolour);
+	sfree(pts);
+    }
+
+    assert(outlinecolour >= 0);
+    for (i = 0; i < npoints; i++) {
+	int j = (i + 1) % npoints;
+	raster_draw_line(handle, coords[2*i], coords[2*i+1],
+			 coords[2*j], coords[2*j+1], outlinecolour);
+    }
+}
+
+static void raster_draw_circle(void *handle, int cx, int cy, int radius,
+			       int fillcolour, int outlinecolour)
+{
+    raster *r = (raster *)handle;
+    double inner = (radius - 0.5) * (radius - 0.5);
+    double outer = (radius + 0.5) * (radius + 0.5);
+    int x, y;
+
+    assert(outlinecolour >= 0);
+    for (y = -radius - 1; y <= radius + 1; y++)
+	for (x = -radius - 1; x <= radius + 1; x++) {
+	    double d2 = (double)x*x + (double)y*y;
+	    if (d2 >= inner && d2 <= outer)
+		raster_plot(r, cx + x, cy + y, outlinecolour);
+	    else if (fillcolour >= 0 && d2 < inner)
+		raster_plot(r, cx + x, cy + y, fillcolour);
+	}
+}
+
+static void raster_clip(void *handle, int x, int y, int w, int h)
+{
+    raster *r = (raster *)handle;
+
+    r->clipx0 = max(x, 0);
+    r->clipy0 = max(y, 0);
+    r->clipx1 = min(x + w, r->w);
+    r->clipy1 = min(y + h, r->h);
+}
+
+static void raster_unclip(void *handle)
+{
+    raster *r = (raster *)handle;
+
+    r->clipx0 = r->clipy0 = 0;
+    r->clipx1 = r->w;
+    r->clipy1 = r->h;
+}
+
+static void raster_nothing(void *handle)
+{
+}
+
+static void raster_draw_update(void *handle, int x, int y, int w, int h)
+{
+}
+
+static blitter *raster_blitter_new(void *handle, int w, int h)
+{
+    blitter *bl = snew(blitter);
+
+    bl->w = w;
+    bl->h = h;
+    bl->x = bl->y = 0;
+    bl->pixels = snewn(4 * w * h, unsigned char);
+    memset(bl->pixels, 0, 4 * w * h);
+    return bl;
+}
+
+static void raster_blitter_free(void *handle, blitter *bl)
+{
+    sfree(bl->pixels);
+    sfree(bl);
+}
+
+/*
+ * Copy between a blitter and the image, skipping any part of the
+ * rectangle which lies off the edge of the image.
+ */
+static void raster_blit(raster *r, blitter *bl, int x, int y, int save)
+{
+    int xx, yy;
+
+    for (yy = 0; yy < bl->h; yy++) {
+	if (y + yy < 0 || y + yy >= r->h)
+	    continue;
+	for (xx = 0; xx < bl->w; xx++) {
+	    unsigned char *ip, *bp;
+	    if (x + xx < 0 || x + xx >= r->w)
+		continue;
+	    ip = r->pixels + 4 * ((y + yy) * r->w + (x + xx));
+	    bp = bl->pixels + 4 * (yy * bl->w + xx);
+	    if (save)
+		memcpy(bp, ip, 4);
+	    else
+		memcpy(ip, bp, 4);
+	}
+    }
+}
+
+static void raster_blitter_save(void *handle, blitter *bl, int x, int y)
+{
+    bl->x = x;
+    bl->y = y;
+    raster_blit((raster *)handle, bl, x, y, TRUE);
+}
+
+static void raster_blitter_load(void *handle, blitter *bl, int x, int y)
+{
+    if (x == BLITTER_FROMSAVED && y == BLITTER_FROMSAVED) {
+	x = bl->x;
+	y = bl->y;
+    }
+    raster_blit((raster *)handle, bl, x, y, FALSE);
+}
+
+static char *raster_text_fallback(void *handle, const char *const *strings,
+				  int nstrings)
+{
+    /* The last fallback is always plain ASCII. */
+    return dupstr(strings[nstrings-1]);
+}
+
+const struct drawing_api raster_drawing = {
+    raster_draw_text,
+    raster_draw_rect,
+    raster_draw_line,
+    raster_draw_polygon,
+    raster_draw_circle,
+    raster_draw_update,
+    raster_clip,
+    raster_unclip,
+    raster_nothing,		       /* start_draw */
+    raster_nothing,		       /* end_draw */
+    NULL,			       /* status_bar */
+    raster_blitter_new,
+    raster_blitter_free,
+    raster_blitter_save,
+    raster_blitter_load,
+    NULL, NULL, NULL, NULL, NULL, NULL, /* {begin,end}_{doc,page,puzzle} */
+    NULL, NULL,			       /* line_width, line_dotted */
+    raster_text_fallback,
+    raster_draw_thick_line,
+};
+
+/* ----------------------------------------------------------------------
+ * Output.
+ */
+
+int raster_write_ppm(raster *r, FILE *fp)
+{
+    int i;
+
+    fprintf(fp, "P6\n%d %d\n255\n", r->w, r->h);
+    for (i = 0; i < r->w * r->h; i++)
+	fwrite(r->pixels + 4*i, 1, 3, fp);
+    return ferror(fp) ? -1 : 0;
+}
+
+static unsigned long png_crc_table[256];
+
+static void png_put32(unsigned char *p, unsigned long v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void png_chunk(FILE *fp, const char *type,
+		      const unsigned char *data, unsigned long len)
+{
+    unsigned char buf[4];
+    unsigned long crc = 0xFFFFFFFFUL, i;
+
+    if (!png_crc_table[1]) {
+	unsigned long c;
+	int n, k;
+	for (n = 0; n < 256; n++) {
+	    c = n;
+	    for (k = 0; k < 8; k++)
+		c = (c & 1) ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+	    png_crc_table[n] = c;
+	}
+    }
+
+    png_put32(buf, len);
+    fwrite(buf, 1, 4, fp);
+    fwrite(type, 1, 4, fp);
+    fwrite(data, 1, len, fp);
+    for (i = 0; i < 4; i++)
+	crc = png_crc_table[(crc ^ (unsigned char)type[i]) & 0xFF] ^ (crc >> 8);
+    for (i = 0; i < len; i++)
+	crc = png_crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    png_put32(buf, crc ^ 0xFFFFFFFFUL);
+    fwrite(buf, 1, 4, fp);
+}
+
+/*
+ * Write the image as an RGBA PNG. To avoid needing zlib, the image
+ * data goes into uncompressed ('stored') deflate blocks, so the files
+ * are no smaller than a PPM; run them through a PNG optimiser if size
+ * matters. PNG has no empty images, so one with no pixels is an
+ * error.
+ */
+int raster_write_png(raster *r, FILE *fp)
+{
+    unsigned long rowlen = 4UL * r->w + 1, rawlen = rowlen * r->h;
+    unsigned long nblocks = (rawlen + 65534) / 65535;
+    unsigned long zlen = 2 + 5 * nblocks + rawlen + 4;
+    unsigned char *z, *p;
+    unsigned char ihdr[13];
+    unsigned long a = 1, b = 0, done;
+
+    if (r->w <= 0 || r->h <= 0)
+	return -1;
+    z = p = snewn(zlen, unsigned char);
+
+    /* zlib header: deflate, 32K window, no preset dictionary. */
+    *p++ = 0x78;
+    *p++ = 0x01;
+
+    for (done = 0; done < rawlen; ) {
+	unsigned long n = rawlen - done, k;
+	if (n > 65535)
+	    n = 65535;
+	*p++ = (done + n == rawlen);   /* BFINAL, BTYPE=00 (stored) */
+	*p++ = (unsigned char)(n & 0xFF);
+	*p++ = (unsigned char)(n >> 8);
+	*p++ = (unsigned char)(~n & 0xFF);
+	*p++ = (unsigned char)((~n >> 8) & 0xFF);
+	for (k = 0; k < n; k++) {
+	    unsigned long pos = done + k;
+	    unsigned long row = pos / rowlen, col = pos % rowlen;
+	    unsigned char c = (col == 0 ? 0 :   /* filter type None */
+			       r->pixels[row * (rowlen-1) + col - 1]);
+	    *p++ = c;
+	    a = (a + c) % 65521;
+	    b = (b + a) % 65521;
+	}
+	done += n;
+    }
+    png_put32(p, (b << 16) | a);
+    p += 4;
+
+    fwrite("\x89PNG\r\n\x1a\n", 1, 8, fp);
+    png_put32(ihdr, r->w);
+    png_put32(ihdr + 4, r->h);
+    ihdr[8] = 8;		       /* bit depth */
+    ihdr[9] = 6;		       /* colour type RGBA */
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    png_chunk(fp, "IHDR", ihdr, 13);
+    png_chunk(fp, "IDAT", z, p - z);
+    png_chunk(fp, "IEND", NULL, 0);
+
+    sfree(z);
+    return ferror(fp) ? -1 : 0;
+}
@@ -0,0 +1,265 @@
+/*
+ * render.c: headless renderer which draws puzzles into image files,
+ * using the in-memory drawing API in raster.c, for serving puzzle
+ * images without a GUI.
+ *
+ * Usage: render [--size WxH] [--solve] [--ppm] [--output <prefix>]
+ *               [<game>:<id>...]
+ *
+ * Each argument names a game (as in the Unix binary names) and a game
+ * id or random seed, e.g. 'net:5x5#12345' or 'solo:3x3:a2b...'. With
+ * no such arguments, they are read one per line from standard input.
+ * The n'th puzzle (counting from 1) is written to '<prefix><n>.png',
+ * or '.ppm' with --ppm; the default prefix is 'puzzle'. --size gives
+ * the maximum image size, within which the game picks its own tile
+ * size; by default each game is drawn at its preferred size. --solve
+ * draws the solved position instead of the initial one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include "puzzles.h"
+
+extern const game *gamelist[];
+extern const int gamecount;
+
+/* ----------------------------------------------------------------------
+ * The front end functions the mid-end and the games need. Timers are
+ * never run: we finish any animation by hand before drawing.
+ */
+
+void frontend_default_colour(frontend *fe, float *output)
+{
+    output[0] = output[1] = output[2] = 0.8F;
+}
+
+void activate_timer(frontend *fe) {}
+void deactivate_timer(frontend *fe) {}
+
+void get_random_seed(void **randseed, int *randseedsize)
+{
+    /* Only reached for a game id given as bare parameters. */
+    static const char seed[] = "render";
+
+    *randseed = snewn(sizeof(seed), char);
+    memcpy(*randseed, seed, sizeof(seed));
+    *randseedsize = sizeof(seed);
+}
+
+void fatal(const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "fatal error: ");
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+#ifdef DEBUGGING
+void debug_printf(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+#endif
+
+/* ----------------------------------------------------------------------
+ * Rendering.
+ */
+
+struct options {
+    int w, h;			       /* 0 means the game's preferred size */
+    int solve;
+    int ppm;
+    const char *prefix;
+};
+
+/* Match a game as named on the command line, ignoring case. */
+static const game *find_game(const char *name, int len)
+{
+    int i, j;
+
+    for (i = 0; i < gamecount; i++) {
+	const char *p = gamelist[i]->htmlhelp_topic;
+	for (j = 0; j < len && p[j]; j++)
+	    if (tolower((unsigned char)p[j]) !=
+		tolower((unsigned char)name[j]))
+		break;
+	if (j == len && !p[j])
+	    return gamelist[i];
+    }
+    return NULL;
+}
+
+/*
+ * Render one '<game>:<id>' specification to file number n. Returns
+ * FALSE, having reported the problem, on failure.
+ */
+static int render_one(const struct options *opts, const char *spec, int n)
+{
+    const char *colon = strchr(spec, ':');
+    const game *thegame;
+    midend *me;
+    raster *r;
+    float *colours;
+    const char *err;
+    char *filename;
+    FILE *fp;
+    int ncolours, x, y, ret;
+
+    thegame = colon ? find_game(spec, colon - spec) : NULL;
+    if (!thegame) {
+	fprintf(stderr, "%s: expected '<game>:<game id>'\n", spec);
+	return FALSE;
+    }
+
+    r = raster_new();
+    me = midend_new(NULL, thegame, &raster_drawing, r);
+    err = midend_game_id(me, colon + 1);
+    if (err) {
+	fprintf(stderr, "%s: %s\n", spec, err);
+	midend_free(me);
+	raster_free(r);
+	return FALSE;
+    }
+    midend_new_game(me);
+
+    colours = midend_colours(me, &ncolours);
+    raster_set_colours(r, colours, ncolours);
+    sfree(colours);
+
+    if (opts->w) {
+	x = opts->w;
+	y = opts->h;
+	midend_size(me, &x, &y, TRUE);
+    } else {
+	x = y = INT_MAX;
+	midend_size(me, &x, &y, FALSE);
+    }
+    raster_resize(r, x, y);
+
+    if (opts->solve) {
+	err = midend_solve(me);
+	if (err)
+	    fprintf(stderr, "%s: %s\n", spec, err);
+	/* Run the solve animation and any completion flash to the end. */
+	midend_timer(me, 1.0e6F);
+    }
+    midend_force_redraw(me);
+
+    if (x <= 0 || y <= 0) {
+	fprintf(stderr, "%s: puzzle has an empty image\n", spec);
+	midend_free(me);
+	raster_free(r);
+	return FALSE;
+    }
+
+    filename = snewn(strlen(opts->prefix) + 40, char);
+    sprintf(filename, "%s%d.%s", opts->prefix, n, opts->ppm ? "ppm" : "png");
+    fp = fopen(filename, "wb");
+    if (!fp) {
+	fprintf(stderr, "%s: unable to open for writing\n", filename);
+	ret = FALSE;
+    } else {
+	ret = (opts->ppm ? raster_write_ppm(r, fp) :
+	       raster_write_png(r, fp)) == 0;
+	if (fclose(fp) != 0)
+	    ret = FALSE;
+	if (!ret)
+	    fprintf(stderr, "%s: error writing file\n", filename);
+    }
+
+    sfree(filename);
+    midend_free(me);
+    raster_free(r);
+    return ret;
+}
+
+/*
+ * Read a line of any length, as the GTK front end's fgetline() does.
+ * Returns NULL at end of file.
+ */
+static char *read_line(FILE *fp)
+{
+    char *ret = snewn(512, char);
+    int size = 512, len = 0;
+    while (fgets(ret + len, size - len, fp)) {
+	len += strlen(ret + len);
+	if (ret[len-1] == '\n')
+	    break;		       /* got a newline, we're done */
+	size = len + 512;
+	ret = sresize(ret, size, char);
+    }
+    if (len == 0) {		       /* first fgets returned NULL */
+	sfree(ret);
+	return NULL;
+    }
+    ret[len] = '\0';
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    struct options opts;
+    int i, n = 0, nspecs = 0, failed = FALSE;
+
+    opts.w = opts.h = 0;
+    opts.solve = opts.ppm = FALSE;
+    opts.prefix = "puzzle";
+
+    for (i = 1; i < argc; i++) {
+	const char *p = argv[i];
+
+	if (!strcmp(p, "--size") && i+1 < argc) {
+	    if (sscanf(argv[++i], "%dx%d", &opts.w, &opts.h) != 2 ||
+		opts.w <= 0 || opts.h <= 0) {
+		fprintf(stderr, "%s: --size expects WxH\n", argv[0]);
+		return 1;
+	    }
+	} else if (!strcmp(p, "--output") && i+1 < argc) {
+	    opts.prefix = argv[++i];
+	} else if (!strcmp(p, "--solve")) {
+	    opts.solve = TRUE;
+	} else if (!strcmp(p, "--ppm")) {
+	    opts.ppm = TRUE;
+	} else if (p[0] == '-') {
+	    fprintf(stderr, "usage: %s [--size WxH] [--solve] [--ppm] "
+		    "[--output <prefix>] [<game>:<id>...]\n", argv[0]);
+	    return 1;
+	} else {
+	    nspecs++;
+	}
+    }
+
+    if (nspecs) {
+	for (i = 1; i < argc; i++) {
+	    if (!strcmp(argv[i], "--size") || !strcmp(argv[i], "--output"))
+		i++;
+	    else if (argv[i][0] != '-' && !render_one(&opts, argv[i], ++n))
+		failed = TRUE;
+	}
+    } else {
+	char *buf;
+
+	while ((buf = read_line(stdin)) != NULL) {
+	    buf[strcspn(buf, "\r\n")] = '\0';
+	    if (*buf && !render_one(&opts, buf, ++n))
+		failed = TRUE;
+	    sfree(buf);
+	}
+    }
+
+    return failed ? 1 : 0;
+}
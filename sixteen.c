@@ -43,6 +43,14 @@ struct game_params {
     int movetarget;
 };
 
+/*
+ * The moves made by a Solve are kept in the state's solve_path so
+ * that it can be animated. Each shifts a single row or column by one
+ * square, encoded as described under the solver below. There are
+ * none if the Solve simply replaced the grid, in which case there's
+ * no animation at all.
+ */
+
 struct game_state {
     int w, h, n;
     int *tiles;
@@ -50,6 +58,7 @@ struct game_state {
     int used_solve;		       /* used to suppress completion flash */
     int movecount, movetarget;
     int last_movement_sense;
+    solve_path *soln;
 };
 
 static game_params *default_params(void)
@@ -474,6 +483,7 @@ static game_state *new_game(midend *me, const game_params *params,
     state->movetarget = params->movetarget;
     state->used_solve = FALSE;
     state->last_movement_sense = 0;
+    state->soln = NULL;
 
     return state;
 }
@@ -492,20 +502,537 @@ static game_state *dup_game(const game_state *state)
     ret->movetarget = state->movetarget;
     ret->used_solve = state->used_solve;
     ret->last_movement_sense = state->last_movement_sense;
+    ret->soln = solve_path_ref(state->soln);
 
     return ret;
 }
 
 static void free_game(game_state *state)
 {
+    solve_path_free(state->soln);
     sfree(state->tiles);
     sfree(state);
 }
 
+/* ----------------------------------------------------------------------
+ * Solver.
+ *
+ * A single-square move is encoded as 2*line plus 1 if it moves the
+ * tiles towards higher coordinates, where lines 0 to h-1 are the rows
+ * and h to h+w-1 are the columns.
+ */
+
+#define MOVE_LINE(move) ( (move) / 2 )
+#define MOVE_DIR(move) ( (move) & 1 ? +1 : -1 )
+#define MAKE_MOVE(line, dir) ( 2 * (line) + ((dir) > 0) )
+
+static void apply_move(int *tiles, int w, int h, int move)
+{
+    int line = MOVE_LINE(move), start, step, len, i, t;
+
+    if (line < h) {
+        start = line * w;
+        step = 1;
+        len = w;
+    } else {
+        start = line - h;
+        step = w;
+        len = h;
+    }
+
+    if (MOVE_DIR(move) > 0) {
+        t = tiles[start + (len-1) * step];
+        for (i = len-1; i > 0; i--)
+            tiles[start + i * step] = tiles[start + (i-1) * step];
+        tiles[start] = t;
+    } else {
+        t = tiles[start];
+        for (i = 0; i < len-1; i++)
+            tiles[start + i * step] = tiles[start + (i+1) * step];
+        tiles[start + (len-1) * step] = t;
+    }
+}
+
+/*
+ * First we try IDA*, which finds a shortest solution, and is quick
+ * enough for games shuffled by a small number of moves. A row move
+ * changes the horizontal position of w tiles by one square each, so
+ * the total horizontal distance of the tiles from home (wrapping
+ * round) divided by w, rounded up, is a lower bound on the number of
+ * row moves still needed; likewise for columns.
+ *
+ * The same search can also look for a way to get just the first few
+ * tiles home, by leaving the rest out of the distances.
+ *
+ * Each deepening takes roughly as many times longer than the one
+ * before as that one did than its own predecessor, about ten times
+ * on a 4x4 grid. So rather than spend what's left of the node limit
+ * on a deepening that would need many times more, we give up as
+ * soon as that's what the last two predict. On a randomly shuffled
+ * 4x4 grid that makes Solve about three times as fast, at the cost
+ * of the optimal solutions that the search would have stumbled on
+ * early in a deepening it couldn't have finished.
+ */
+
+#define SOLVE_MAX_NODES 1000000L
+#define PLACE_MAX_NODES 20000L
+
+struct solver {
+    int w, h, n;
+    int *tiles;
+    int *xdist, *ydist;                /* by tile and column or row */
+    int *path, pathlen;
+    long nodes, maxnodes;
+};
+
+static void solver_init(struct solver *s, int w, int h)
+{
+    s->w = w;
+    s->h = h;
+    s->n = w * h;
+    s->tiles = snewn(s->n, int);
+    s->xdist = snewn(s->n * w, int);
+    s->ydist = snewn(s->n * h, int);
+}
+
+static void solver_free(struct solver *s)
+{
+    sfree(s->tiles);
+    sfree(s->xdist);
+    sfree(s->ydist);
+}
+
+/*
+ * Set up the distance tables so that the search aims to get tiles 1
+ * to `ntiles' home, ignoring the others.
+ */
+static void solver_set_goal(struct solver *s, int ntiles)
+{
+    int w = s->w, h = s->h, i, j, d;
+
+    for (i = 0; i < s->n; i++) {
+        for (j = 0; j < w; j++) {
+            d = abs(j - i % w);
+            s->xdist[i * w + j] = (i < ntiles ? min(d, w - d) : 0);
+        }
+        for (j = 0; j < h; j++) {
+            d = abs(j - i / w);
+            s->ydist[i * h + j] = (i < ntiles ? min(d, h - d) : 0);
+        }
+    }
+}
+
+/*
+ * How much a move changes the total distance of the tiles from home
+ * along the line it moves.
+ */
+static int move_delta(const struct solver *s, int move)
+{
+    int w = s->w, h = s->h, line = MOVE_LINE(move), dir = MOVE_DIR(move);
+    int i, t, ret = 0;
+
+    if (line < h) {
+        for (i = 0; i < w; i++) {
+            t = s->tiles[line * w + i] - 1;
+            ret += s->xdist[t * w + (i + dir + w) % w] - s->xdist[t * w + i];
+        }
+    } else {
+        for (i = 0; i < h; i++) {
+            t = s->tiles[i * w + line - h] - 1;
+            ret += s->ydist[t * h + (i + dir + h) % h] - s->ydist[t * h + i];
+        }
+    }
+
+    return ret;
+}
+
+#define SEARCH_FOUND (-1)
+#define SEARCH_GIVEUP (-2)
+
+/*
+ * Depth-first search below a position `g' moves deep, after `run'
+ * repetitions of the move `prev'. `xd' and `yd' are the total
+ * horizontal and vertical distances of the tiles from home. Returns
+ * SEARCH_FOUND or SEARCH_GIVEUP, or otherwise the smallest estimated
+ * solution length exceeding `bound' that we pruned.
+ */
+static int ida_search(struct solver *s, int prev, int run, int g,
+                      int xd, int yd, int bound)
+{
+    int w = s->w, h = s->h;
+    int move, ret = -1;
+
+    if (xd == 0 && yd == 0) {
+        s->pathlen = g;
+        return SEARCH_FOUND;
+    }
+    if (++s->nodes > s->maxnodes)
+        return SEARCH_GIVEUP;
+
+    for (move = 0; move < 2 * (w + h); move++) {
+        int line = MOVE_LINE(move), isrow = line < h;
+        int len = (isrow ? w : h), nxd = xd, nyd = yd, f;
+
+        if (len == 2 && MOVE_DIR(move) < 0)
+            continue;                  /* same as the other way */
+        if (prev >= 0 && MOVE_LINE(prev) == line) {
+            /*
+             * Don't undo the last move, or keep going round a line
+             * further than half way.
+             */
+            if (move != prev ||
+                run >= (MOVE_DIR(move) > 0 ? len/2 : (len-1)/2))
+                continue;
+        } else if (prev >= 0 && (MOVE_LINE(prev) < h) == isrow &&
+                   MOVE_LINE(prev) > line) {
+            continue;          /* parallel moves commute; keep them in order */
+        }
+
+        if (isrow)
+            nxd += move_delta(s, move);
+        else
+            nyd += move_delta(s, move);
+        f = g + 1 + (nxd + w-1) / w + (nyd + h-1) / h;
+
+        if (f <= bound) {
+            apply_move(s->tiles, w, h, move);
+            s->path[g] = move;
+            f = ida_search(s, move, move == prev ? run+1 : 1, g+1,
+                           nxd, nyd, bound);
+            apply_move(s->tiles, w, h, move ^ 1);
+            if (f == SEARCH_FOUND || f == SEARCH_GIVEUP)
+                return f;
+        }
+        if (ret < 0 || f < ret)
+            ret = f;
+    }
+
+    return ret;
+}
+
+/*
+ * Search from the position in s->tiles, giving up after `maxnodes'
+ * nodes. Returns the moves found, or NULL.
+ */
+static int *solver_run(struct solver *s, long maxnodes, int *nmoves)
+{
+    int w = s->w, h = s->h, i, xd, yd, bound, ret;
+    long last = 0, before = 0;         /* nodes in the last two deepenings */
+
+    xd = yd = 0;
+    for (i = 0; i < s->n; i++) {
+        xd += s->xdist[(s->tiles[i] - 1) * w + i % w];
+        yd += s->ydist[(s->tiles[i] - 1) * h + i / w];
+    }
+
+    s->nodes = 0;
+    s->maxnodes = maxnodes;
+    s->path = NULL;
+    for (bound = (xd + w-1) / w + (yd + h-1) / h; ; bound = ret) {
+        if (before > 0 && s->nodes + last / before * last > maxnodes) {
+            sfree(s->path);
+            return NULL;
+        }
+        s->path = sresize(s->path, bound + 1, int);
+        before = last;
+        last = -s->nodes;
+        ret = ida_search(s, -1, 0, 0, xd, yd, bound);
+        last += s->nodes;
+        if (ret == SEARCH_FOUND) {
+            *nmoves = s->pathlen;
+            return s->path;
+        }
+        if (ret == SEARCH_GIVEUP) {
+            sfree(s->path);
+            return NULL;
+        }
+    }
+}
+
+static int *solve_optimal(const game_state *state, int *nmoves)
+{
+    struct solver s;
+    int *ret;
+
+    solver_init(&s, state->w, state->h);
+    memcpy(s.tiles, state->tiles, state->n * sizeof(int));
+    solver_set_goal(&s, state->n);
+    ret = solver_run(&s, SOLVE_MAX_NODES, nmoves);
+    solver_free(&s);
+
+    return ret;
+}
+
+/*
+ * If that runs out of time, we put the tiles in place one at a time
+ * instead, in reading order, searching for a short way to get each
+ * one home without disturbing those already there.
+ *
+ * When that search runs out of time too, we fall back to fixed
+ * sequences. A row or column can't be moved without disturbing the
+ * tiles already placed, but a column move followed by a row move and
+ * then the column move undone only disturbs the row and one square
+ * of the column. So a tile can be brought in from below, and
+ * everything but the bottom row solved in this way.
+ *
+ * The bottom row is then sorted with the cycle of three squares
+ * below, which is a commutator of the same kind. Those are all even
+ * permutations, so first, if the bottom row is an odd permutation,
+ * we make a move which is odd: a bottom row move if the rows have
+ * even length, or otherwise a column move, after which we put back
+ * the tiles it disturbed using only the fixed sequences, since they
+ * don't change the parity. (If both have odd length every move is
+ * even, and the puzzle can't be solved at all.)
+ *
+ * As the moves are made, ones on the same line are merged, including
+ * across moves of parallel lines which commute with them; this takes
+ * out most of the waste of building the solution from fixed
+ * sequences.
+ */
+
+/*
+ * A sequence of moves of columns 0 and 1 and the bottom row (given
+ * as -1) which moves the tiles in the second and third squares of
+ * the bottom row one square left, and the one in the first square to
+ * the third. On any grid at least 3 wide, it leaves everything else
+ * alone.
+ */
+static const struct { int line, dir; } bottom_cycle[] = {
+    {1, +1}, {-1, +1}, {1, -1}, {-1, -1}, {0, +1},
+    {-1, -1}, {1, +1}, {-1, +1}, {1, -1}, {0, -1},
+};
+
+struct placer {
+    int w, h;
+    int *tiles;
+    int *lines, *amounts;              /* merged moves made so far */
+    int nchunks, chunksize;
+};
+
+static void place_move(struct placer *pl, int line, int amount)
+{
+    int len = (line < pl->h ? pl->w : pl->h), i;
+
+    amount = ((amount % len) + len) % len;
+    if (amount > len/2)
+        amount -= len;
+    for (i = 0; i < abs(amount); i++)
+        apply_move(pl->tiles, pl->w, pl->h, MAKE_MOVE(line, amount));
+
+    for (i = pl->nchunks; i-- > 0 ;) {
+        if ((pl->lines[i] < pl->h) != (line < pl->h))
+            break;
+        if (pl->lines[i] == line) {
+            amount += pl->amounts[i];
+            pl->nchunks--;
+            memmove(pl->lines + i, pl->lines + i+1,
+                    (pl->nchunks - i) * sizeof(int));
+            memmove(pl->amounts + i, pl->amounts + i+1,
+                    (pl->nchunks - i) * sizeof(int));
+            amount = ((amount % len) + len) % len;
+            if (amount > len/2)
+                amount -= len;
+            break;
+        }
+    }
+
+    if (amount) {
+        if (pl->nchunks == pl->chunksize) {
+            pl->chunksize = pl->chunksize * 3 / 2 + 16;
+            pl->lines = sresize(pl->lines, pl->chunksize, int);
+            pl->amounts = sresize(pl->amounts, pl->chunksize, int);
+        }
+        pl->lines[pl->nchunks] = line;
+        pl->amounts[pl->nchunks++] = amount;
+    }
+}
+
+/*
+ * Cycle the tiles in squares `x' to x+2 of the bottom row, moving
+ * them left if `dir' is positive or right if it's negative.
+ */
+static void place_bottom_cycle(struct placer *pl, int x, int dir)
+{
+    int h = pl->h, i, j;
+
+    place_move(pl, h-1, -x);
+    for (i = 0; i < lenof(bottom_cycle); i++) {
+        j = (dir > 0 ? i : lenof(bottom_cycle) - 1 - i);
+        place_move(pl, (bottom_cycle[j].line < 0 ? h-1 :
+                        h + bottom_cycle[j].line),
+                   bottom_cycle[j].dir * dir);
+    }
+    place_move(pl, h-1, +x);
+}
+
+/*
+ * Put the tiles in place in reading order, as far as the end of the
+ * last row but one, or further if `s' is non-NULL and searching can
+ * get them home.
+ */
+static void place_tiles(struct placer *pl, struct solver *s)
+{
+    int w = pl->w, h = pl->h, n = w * h;
+    int i, p, x, y, cx, cy, nmoves, *moves;
+
+    for (i = 0; i < n; i++) {
+        x = i % w;
+        y = i / w;
+        for (p = 0; pl->tiles[p] != i+1; p++);
+        if (p == i)
+            continue;
+
+        if (s) {
+            memcpy(s->tiles, pl->tiles, n * sizeof(int));
+            solver_set_goal(s, i+1);
+            moves = solver_run(s, PLACE_MAX_NODES, &nmoves);
+            if (moves) {
+                for (p = 0; p < nmoves; p++)
+                    place_move(pl, MOVE_LINE(moves[p]), MOVE_DIR(moves[p]));
+                sfree(moves);
+                continue;
+            }
+        }
+
+        if (y == h-1)
+            break;                     /* leave the rest to the cycles */
+
+        cx = p % w;
+        cy = p / w;
+        if (cy == y) {
+            /*
+             * The tile is further along its own row, so move it down
+             * out of the way of the tiles already placed.
+             */
+            place_move(pl, h + cx, +1);
+            place_move(pl, y+1, +1);
+            place_move(pl, h + cx, -1);
+            cx = (cx + 1) % w;
+            cy = y+1;
+        }
+
+        /*
+         * Line it up one square to the left of where it's going, then
+         * bring column x down to its row, move it across into the
+         * column, and put the column back.
+         */
+        place_move(pl, cy, x - 1 - cx);
+        place_move(pl, h + x, cy - y);
+        place_move(pl, cy, +1);
+        place_move(pl, h + x, y - cy);
+    }
+}
+
+static int *solve_by_placing(const game_state *state, int *nmoves)
+{
+    struct placer pl;
+    struct solver s;
+    int w = state->w, h = state->h, n = state->n;
+    int x, i, j, p, *moves;
+
+    pl.w = w;
+    pl.h = h;
+    pl.tiles = snewn(n, int);
+    memcpy(pl.tiles, state->tiles, n * sizeof(int));
+    pl.lines = pl.amounts = NULL;
+    pl.nchunks = pl.chunksize = 0;
+
+    solver_init(&s, w, h);
+    place_tiles(&pl, &s);
+    solver_free(&s);
+
+    if (perm_parity(pl.tiles + (h-1)*w, w)) {
+        if (w % 2 == 0) {
+            place_move(&pl, h-1, +1);
+        } else {
+            assert(h % 2 == 0);
+            place_move(&pl, h, +1);
+            place_tiles(&pl, NULL);
+            assert(!perm_parity(pl.tiles + (h-1)*w, w));
+        }
+    }
+    for (x = 0; x < w-2; x++) {
+        for (i = x; pl.tiles[(h-1)*w + i] != (h-1)*w + x + 1; i++);
+        while (i > x) {
+            if (i - x >= 2) {
+                place_bottom_cycle(&pl, i-2, -1);
+                i -= 2;
+            } else {
+                place_bottom_cycle(&pl, x, +1);
+                i = x;
+            }
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        assert(pl.tiles[i] == i+1);
+
+    *nmoves = 0;
+    for (i = 0; i < pl.nchunks; i++)
+        *nmoves += abs(pl.amounts[i]);
+    moves = snewn(*nmoves + 1, int);
+    for (i = j = 0; i < pl.nchunks; i++)
+        for (p = 0; p < abs(pl.amounts[i]); p++)
+            moves[j++] = MAKE_MOVE(pl.lines[i], pl.amounts[i]);
+
+    sfree(pl.tiles);
+    sfree(pl.lines);
+    sfree(pl.amounts);
+    return moves;
+}
+
+/*
+ * Find a sequence of moves leading to the solution, or NULL if the
+ * puzzle can't be solved.
+ */
+static int *solve_puzzle(const game_state *state, int *nmoves)
+{
+    int *moves;
+
+    /*
+     * Every move is an even permutation if the grid has odd width
+     * and height.
+     */
+    if (state->w % 2 && state->h % 2 && perm_parity(state->tiles, state->n))
+        return NULL;
+
+    moves = solve_optimal(state, nmoves);
+    if (!moves)
+        moves = solve_by_placing(state, nmoves);
+    return moves;
+}
+
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *aux, const char **error)
 {
-    return dupstr("S");
+    int *moves, nmoves, i;
+    char *ret, *p;
+
+    moves = solve_puzzle(currstate, &nmoves);
+    if (!moves) {
+        /*
+         * Fall back to simply replacing the grid with a solved one.
+         * This at least gives a clean state from which to practise
+         * manoeuvres.
+         */
+        return dupstr("S");
+    }
+
+    ret = snewn(2 + nmoves * 40, char);
+    p = ret;
+    *p++ = 'S';
+    for (i = 0; i < nmoves; i++) {
+        int line = MOVE_LINE(moves[i]);
+        if (line < currstate->h)
+            p += sprintf(p, ";R%d,%d", line, MOVE_DIR(moves[i]));
+        else
+            p += sprintf(p, ";C%d,%d", line - currstate->h,
+                         MOVE_DIR(moves[i]));
+    }
+    *p = '\0';
+
+    sfree(moves);
+    return ret;
 }
 
 static int game_can_format_as_text_now(const game_params *params)
@@ -596,6 +1123,7 @@ struct game_drawstate {
     int *tiles;
     int tilesize;
     int cur_x, cur_y;
+    int *animfrom, *animto;            /* steps of an animated Solve */
 };
 
 static char *interpret_move(const game_state *state, game_ui *ui,
@@ -725,20 +1253,56 @@ static game_state *execute_move(const game_state *from, const char *move)
     int tx, ty, n;
     game_state *ret;
 
-    if (!strcmp(move, "S")) {
+    if (move[0] == 'S') {
+	solve_path *sol;
 	int i;
 
 	ret = dup_game(from);
+	solve_path_free(ret->soln);
+	ret->soln = sol = solve_path_new(strlen(move));
 
-	/*
-	 * Simply replace the grid with a solved one. For this game,
-	 * this isn't a useful operation for actually telling the user
-	 * what they should have done, but it is useful for
-	 * conveniently being able to get hold of a clean state from
-	 * which to practise manoeuvres.
-	 */
-	for (i = 0; i < ret->n; i++)
-	    ret->tiles[i] = i+1;
+	if (!move[1]) {
+	    /*
+	     * Simply replace the grid with a solved one. We do this
+	     * if the puzzle can't be solved, or for a Solve move from
+	     * an older version; it isn't a useful operation for
+	     * actually telling the user what they should have done,
+	     * but it is useful for conveniently being able to get
+	     * hold of a clean state from which to practise
+	     * manoeuvres.
+	     */
+	    for (i = 0; i < ret->n; i++)
+		ret->tiles[i] = i+1;
+	} else {
+	    /*
+	     * Otherwise the Solve move is a sequence of single-square
+	     * moves, which we make one at a time, remembering them so
+	     * that they can be animated.
+	     */
+	    for (move++; *move == ';'; move += strcspn(move, ";")) {
+		move++;
+		if (move[0] == 'R' && sscanf(move+1, "%d,%d", &cy, &dx) == 2 &&
+		    cy >= 0 && cy < from->h && (dx == +1 || dx == -1)) {
+		    sol->moves[sol->nmoves] = MAKE_MOVE(cy, dx);
+		} else if (move[0] == 'C' &&
+			   sscanf(move+1, "%d,%d", &cx, &dy) == 2 &&
+			   cx >= 0 && cx < from->w && (dy == +1 || dy == -1)) {
+		    sol->moves[sol->nmoves] = MAKE_MOVE(from->h + cx, dy);
+		} else {
+		    free_game(ret);
+		    return NULL;
+		}
+		apply_move(ret->tiles, ret->w, ret->h,
+			   sol->moves[sol->nmoves++]);
+	    }
+	    for (i = 0; i < ret->n; i++)
+		if (ret->tiles[i] != i+1)
+		    break;
+	    if (*move || i < ret->n) {
+		free_game(ret);
+		return NULL;
+	    }
+	}
 	ret->used_solve = TRUE;
 	ret->completed = ret->movecount = 1;
 
@@ -757,6 +1321,8 @@ static game_state *execute_move(const game_state *from, const char *move)
 	return NULL;
 
     ret = dup_game(from);
+    solve_path_free(ret->soln);
+    ret->soln = NULL;
 
     do {
         tx = (cx - dx + from->w) % from->w;
@@ -828,6 +1394,8 @@ static game_drawstate *game_new_drawstate(drawing *dr, const game_state *state)
     ds->h = state->h;
     ds->bgcolour = COL_BACKGROUND;
     ds->tiles = snewn(ds->w*ds->h, int);
+    ds->animfrom = snewn(ds->w*ds->h, int);
+    ds->animto = snewn(ds->w*ds->h, int);
     ds->tilesize = 0;                  /* haven't decided yet */
     for (i = 0; i < ds->w*ds->h; i++)
         ds->tiles[i] = -1;
@@ -839,6 +1407,8 @@ static game_drawstate *game_new_drawstate(drawing *dr, const game_state *state)
 static void game_free_drawstate(drawing *dr, game_drawstate *ds)
 {
     sfree(ds->tiles);
+    sfree(ds->animfrom);
+    sfree(ds->animto);
     sfree(ds);
 }
 
@@ -918,13 +1488,75 @@ static void draw_arrow_for_cursor(drawing *dr, game_drawstate *ds,
                 TILE_SIZE, TILE_SIZE);
 }
 
+/*
+ * A Solve move is animated one step at a time, each taking at most
+ * ANIM_TIME, and all of them together at most SOLVE_ANIM_TIME.
+ */
+static const solve_path *anim_soln(const game_state *oldstate,
+                             const game_state *newstate, int dir)
+{
+    return (dir > 0 ? newstate : oldstate)->soln;
+}
+
+/*
+ * Work out which step of a Solve move we're part way through, and
+ * fill in `from' and `to' with the grid either side of it and
+ * `sense' with the direction it moves in. Returns how far through
+ * the step we are, scaled to look like the time into an ordinary
+ * move.
+ */
+static float solve_anim_step(const game_state *oldstate,
+                             const game_state *state, int dir,
+                             float animtime, int *from, int *to, int *sense)
+{
+    const solve_path *sol = anim_soln(oldstate, state, dir);
+    float steptime = solve_path_step_time(sol, ANIM_TIME);
+    int step = (int)(animtime / steptime);
+    int i, move;
+
+    if (step >= sol->nmoves)
+        step = sol->nmoves - 1;
+
+    /*
+     * When undoing, we're going from the solved position back
+     * through the moves in reverse.
+     */
+    memcpy(to, oldstate->tiles, state->n * sizeof(int));
+    for (i = 0; i <= step; i++) {
+        if (i == step)
+            memcpy(from, to, state->n * sizeof(int));
+        if (dir > 0)
+            move = sol->moves[i];
+        else
+            move = sol->moves[sol->nmoves - 1 - i] ^ 1;
+        apply_move(to, state->w, state->h, move);
+        *sense = MOVE_DIR(move);
+    }
+
+    return (animtime - step * steptime) * ANIM_TIME / steptime;
+}
+
 static void game_redraw(drawing *dr, game_drawstate *ds,
                         const game_state *oldstate, const game_state *state,
                         int dir, const game_ui *ui,
                         float animtime, float flashtime)
 {
-    int i, bgcolour;
+    int i, bgcolour, sense = 0;
     int cur_x = -1, cur_y = -1;
+    const int *oldtiles = (oldstate ? oldstate->tiles : NULL);
+    const int *tiles = state->tiles;
+
+    if (oldstate && anim_soln(oldstate, state, dir)) {
+        animtime = solve_anim_step(oldstate, state, dir, animtime,
+                                   ds->animfrom, ds->animto, &sense);
+        oldtiles = ds->animfrom;
+        tiles = ds->animto;
+    } else if (dir < 0) {
+        assert(oldstate);
+        sense = -oldstate->last_movement_sense;
+    } else {
+        sense = state->last_movement_sense;
+    }
 
     if (flashtime > 0) {
         int frame = (int)(flashtime / FLASH_FRAME);
@@ -1003,10 +1635,10 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
 	 * -1 because it must always be drawn).
 	 */
 
-	if (oldstate && oldstate->tiles[i] != state->tiles[i])
+	if (oldtiles && oldtiles[i] != tiles[i])
 	    t = -1;
 	else
-	    t = state->tiles[i];
+	    t = tiles[i];
 
 	t0 = t;
 
@@ -1025,16 +1657,8 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
 		int x0, y0, x1, y1, dx, dy;
 		int j;
 		float c;
-		int sense;
 
-		if (dir < 0) {
-		    assert(oldstate);
-		    sense = -oldstate->last_movement_sense;
-		} else {
-		    sense = state->last_movement_sense;
-		}
-
-		t = state->tiles[i];
+		t = tiles[i];
 
 		/*
 		 * FIXME: must be prepared to draw a double
@@ -1047,10 +1671,10 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
 		 */
 		x1 = COORD(X(state, i));
 		y1 = COORD(Y(state, i));
-		for (j = 0; j < oldstate->n; j++)
-		    if (oldstate->tiles[j] == state->tiles[i])
+		for (j = 0; j < state->n; j++)
+		    if (oldtiles[j] == tiles[i])
 			break;
-		assert(j < oldstate->n);
+		assert(j < state->n);
 		x0 = COORD(X(state, j));
 		y0 = COORD(Y(state, j));
 
@@ -1132,6 +1756,10 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
 static float game_anim_length(const game_state *oldstate,
                               const game_state *newstate, int dir, game_ui *ui)
 {
+    const solve_path *sol = anim_soln(oldstate, newstate, dir);
+
+    if (sol)
+        return sol->nmoves * solve_path_step_time(sol, ANIM_TIME);
     return ANIM_TIME;
 }
 
@@ -1182,6 +1810,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     TRUE, solve_game,
     TRUE, game_can_format_as_text_now, game_text_format,
     new_ui,
@@ -1202,7 +1831,7 @@ const struct game thegame = {
     FALSE, FALSE, game_print_size, game_print,
     TRUE,			       /* wants_statusbar */
     FALSE, game_timing_state,
-    0,				       /* flags */
+    SOLVE_ANIMATES,		       /* flags */
 };
 
 /* vim: set shiftwidth=4 tabstop=8: */
@@ -94,6 +94,10 @@
 int solver_show_working, solver_recurse_depth;
 #endif
 
+#if defined SOLO_PARALLEL || defined MIDEND_POOL || defined GENERATE_JOBS
+#include <pthread.h>
+#endif
+
 #include "puzzles.h"
 
 /*
@@ -176,9 +180,31 @@ static int find_sum_bits(unsigned long *array, int idx, int value_left,
     return idx;
 }
 
+#if defined MIDEND_POOL || defined GENERATE_JOBS
+/*
+ * In builds with the threaded code, new_game_desc and new_game can
+ * run on several threads at once (the mid-end's puzzle pool, or the
+ * GTK front end's '--generate --jobs'), so the tables are filled in
+ * just once, under a lock.
+ */
+static pthread_mutex_t sum_bits_lock = PTHREAD_MUTEX_INITIALIZER;
+#define SUM_BITS_LOCK() pthread_mutex_lock(&sum_bits_lock)
+#define SUM_BITS_UNLOCK() pthread_mutex_unlock(&sum_bits_lock)
+#else
+#define SUM_BITS_LOCK() ((void)0)
+#define SUM_BITS_UNLOCK() ((void)0)
+#endif
+
 static void precompute_sum_bits(void)
 {
+    static int done = FALSE;
     int i;
+
+    SUM_BITS_LOCK();
+    if (done) {
+	SUM_BITS_UNLOCK();
+	return;
+    }
     for (i = 3; i < 31; i++) {
 	int j;
 	if (i < 18) {
@@ -198,6 +224,8 @@ static void precompute_sum_bits(void)
 	if (j < MAX_4SUMS)
 	    sum_bits4[i][j] = 0;
     }
+    done = TRUE;
+    SUM_BITS_UNLOCK();
 }
 
 struct game_params {
@@ -3604,6 +3632,213 @@ static struct block_structure *gen_killer_cages(int cr, random_state *rs,
     return b;
 }
 
+/*
+ * The clue-stripping part of new_game_desc. We go through the symmetry
+ * classes of squares in a random order, and remove each one's clues
+ * from the grid if the puzzle is still soluble without them.
+ */
+struct xy { int x, y; };
+
+struct clue_stripper {
+    const game_params *params;
+    int cr;
+    struct block_structure *blocks, *kblocks;
+    digit *kgrid;
+    struct difficulty dlev;
+};
+
+/*
+ * Sees whether the puzzle in 'grid' would still be soluble with the
+ * clues at 'loc' (and its symmetric companions) removed, using 'grid2'
+ * as workspace. 'grid' itself is not changed.
+ */
+static int clue_removable(const struct clue_stripper *cs, const digit *grid,
+                          digit *grid2, struct xy loc)
+{
+    const game_params *params = cs->params;
+    int cr = cs->cr;
+    struct difficulty dlev = cs->dlev;
+    int coords[16], ncoords;
+    int j;
+
+    memcpy(grid2, grid, cr*cr);
+    ncoords = symmetries(params, loc.x, loc.y, coords, params->symm);
+    for (j = 0; j < ncoords; j++)
+        grid2[coords[2*j+1]*cr+coords[2*j]] = 0;
+
+    solver(cr, cs->blocks, cs->kblocks, params->xtype, grid2, cs->kgrid,
+           &dlev);
+    return (dlev.diff <= dlev.maxdiff &&
+            (!params->killer || dlev.kdiff <= dlev.maxkdiff));
+}
+
+static void remove_clue(const struct clue_stripper *cs, digit *grid,
+                        struct xy loc)
+{
+    int coords[16], ncoords;
+    int j;
+
+    ncoords = symmetries(cs->params, loc.x, loc.y, coords, cs->params->symm);
+    for (j = 0; j < ncoords; j++)
+        grid[coords[2*j+1]*cs->cr+coords[2*j]] = 0;
+}
+
+#ifdef SOLO_PARALLEL
+/*
+ * Parallel clue stripping, for builds with SOLO_PARALLEL defined (as
+ * the Unix makefiles do unless told not to use threads; see Recipe).
+ * It's off unless the SOLO_THREADS environment variable sets the
+ * number of worker threads to use. Grids smaller than
+ * STRIP_POOL_MIN_CR square are always done serially: the whole of
+ * their generation takes less time than starting and stopping the
+ * threads.
+ *
+ * Each batch tries the next few candidates from the shuffled list
+ * concurrently, all against the same grid. Then we go through the
+ * results in list order. Failures before the first success would have
+ * failed in the serial version too. The first success is committed.
+ * Everything after it was tried against a grid which has since lost a
+ * clue, so it goes back into the next batch. The result is therefore
+ * exactly what the serial loop produces.
+ */
+#define STRIP_POOL_MIN_CR 9
+
+struct strip_pool {
+    struct clue_stripper cs;
+    int nthreads;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work, done;
+
+    /* The current batch, protected by 'lock'. */
+    const digit *grid;
+    const struct xy *cands;
+    int ncands, next, pending;
+    int *ok;
+    int quit;
+};
+
+static void *strip_thread(void *vpool)
+{
+    struct strip_pool *pool = (struct strip_pool *)vpool;
+    digit *grid2;
+
+    pthread_mutex_lock(&pool->lock);
+    grid2 = snewn(pool->cs.cr * pool->cs.cr, digit);
+    while (1) {
+        int k, ok;
+
+        while (!pool->quit && pool->next >= pool->ncands)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        if (pool->quit)
+            break;
+
+        k = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        ok = clue_removable(&pool->cs, pool->grid, grid2, pool->cands[k]);
+        pthread_mutex_lock(&pool->lock);
+
+        pool->ok[k] = ok;
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    sfree(grid2);
+    return NULL;
+}
+
+static struct strip_pool *strip_pool_new(const struct clue_stripper *cs)
+{
+    struct strip_pool *pool;
+    const char *env = getenv("SOLO_THREADS");
+    int nthreads = env ? atoi(env) : 0;
+    int i;
+
+    if (nthreads <= 1 || cs->cr < STRIP_POOL_MIN_CR)
+        return NULL;
+
+    pool = snew(struct strip_pool);
+    pool->cs = *cs;
+    pool->nthreads = nthreads;
+    pool->threads = snewn(nthreads, pthread_t);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->grid = NULL;
+    pool->cands = NULL;
+    pool->ncands = pool->next = pool->pending = 0;
+    pool->ok = snewn(nthreads, int);
+    pool->quit = FALSE;
+
+    for (i = 0; i < nthreads; i++)
+        if (pthread_create(&pool->threads[i], NULL, strip_thread, pool))
+            fatal("unable to create thread");
+
+    return pool;
+}
+
+static void strip_pool_free(struct strip_pool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = TRUE;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->nthreads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    sfree(pool->threads);
+    sfree(pool->ok);
+    sfree(pool);
+}
+
+static void strip_clues_parallel(struct strip_pool *pool,
+                                 const struct clue_stripper *cs, digit *grid,
+                                 const struct xy *locs, int nlocs)
+{
+    int i = 0;
+
+    /*
+     * The workers are all idle here, but one may only just be
+     * starting up and reading pool->cs, so we still need the lock.
+     */
+    assert(cs->cr == pool->cs.cr);
+    pthread_mutex_lock(&pool->lock);
+    pool->cs = *cs;
+    pthread_mutex_unlock(&pool->lock);
+
+    while (i < nlocs) {
+        int n = min(nlocs - i, pool->nthreads);
+        int k;
+
+        pthread_mutex_lock(&pool->lock);
+        pool->grid = grid;
+        pool->cands = locs + i;
+        pool->ncands = pool->pending = n;
+        pool->next = 0;
+        pthread_cond_broadcast(&pool->work);
+        while (pool->pending > 0)
+            pthread_cond_wait(&pool->done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (k = 0; k < n; k++)
+            if (pool->ok[k])
+                break;
+        if (k < n) {
+            remove_clue(&pool->cs, grid, locs[i+k]);
+            i += k + 1;
+        } else {
+            i += n;
+        }
+    }
+}
+#endif
+
 static char *new_game_desc(const game_params *params, random_state *rs,
 			   char **aux, int interactive)
 {
@@ -3611,11 +3846,15 @@ static char *new_game_desc(const game_params *params, random_state *rs,
     int area = cr*cr;
     struct block_structure *blocks, *kblocks;
     digit *grid, *grid2, *kgrid;
-    struct xy { int x, y; } *locs;
+    struct xy *locs;
     int nlocs;
+    struct clue_stripper cs;
+#ifdef SOLO_PARALLEL
+    struct strip_pool *pool = NULL;
+#endif
     char *desc;
     int coords[16], ncoords;
-    int x, y, i, j;
+    int x, y, i;
     struct difficulty dlev;
 
     precompute_sum_bits();
@@ -3800,21 +4039,22 @@ static char *new_game_desc(const game_params *params, random_state *rs,
          * see whether removing that element (and its reflections)
          * from the grid will still leave the grid soluble.
          */
+        cs.params = params;
+        cs.cr = cr;
+        cs.blocks = blocks;
+        cs.kblocks = kblocks;
+        cs.kgrid = kgrid;
+        cs.dlev = dlev;
+#ifdef SOLO_PARALLEL
+        if (!pool)
+            pool = strip_pool_new(&cs);
+        if (pool) {
+            strip_clues_parallel(pool, &cs, grid, locs, nlocs);
+        } else
+#endif
         for (i = 0; i < nlocs; i++) {
-            x = locs[i].x;
-            y = locs[i].y;
-
-            memcpy(grid2, grid, area);
-            ncoords = symmetries(params, x, y, coords, params->symm);
-            for (j = 0; j < ncoords; j++)
-                grid2[coords[2*j+1]*cr+coords[2*j]] = 0;
-
-            solver(cr, blocks, kblocks, params->xtype, grid2, kgrid, &dlev);
-            if (dlev.diff <= dlev.maxdiff &&
-		(!params->killer || dlev.kdiff <= dlev.maxkdiff)) {
-                for (j = 0; j < ncoords; j++)
-                    grid[coords[2*j+1]*cr+coords[2*j]] = 0;
-            }
+            if (clue_removable(&cs, grid, grid2, locs[i]))
+                remove_clue(&cs, grid, locs[i]);
         }
 
         memcpy(grid2, grid, area);
@@ -3827,6 +4067,10 @@ static char *new_game_desc(const game_params *params, random_state *rs,
 
     sfree(grid2);
     sfree(locs);
+#ifdef SOLO_PARALLEL
+    if (pool)
+        strip_pool_free(pool);
+#endif
 
     /*
      * Now we have the grid as it will be presented to the user.
@@ -5569,6 +5813,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     TRUE, solve_game,
     TRUE, game_can_format_as_text_now, game_text_format,
     new_ui,
@@ -4,6 +4,7 @@
  */
 
 #include <assert.h>
+#include <string.h>
 
 #include "puzzles.h"
 
@@ -86,3 +87,12 @@ void tdq_fill(tdq *tdq)
     for (i = 0; i < tdq->n; i++)
         tdq_add(tdq, i);
 }
+
+void tdq_copy(tdq *dst, const tdq *src)
+{
+    assert(dst->n == src->n);
+    memcpy(dst->queue, src->queue, src->n * sizeof(int));
+    memcpy(dst->flags, src->flags, src->n);
+    dst->ip = src->ip;
+    dst->op = src->op;
+}
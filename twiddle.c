@@ -42,6 +42,14 @@ struct game_params {
     int movetarget;
 };
 
+/*
+ * The moves made by a Solve are kept in the state's solve_path so
+ * that it can be animated. Each is a single rotation, encoded as
+ * described under the solver below. There are none if the Solve
+ * simply replaced the grid, in which case there's no animation at
+ * all.
+ */
+
 struct game_state {
     int w, h, n;
     int orientable;
@@ -50,6 +58,7 @@ struct game_state {
     int used_solve;		       /* used to suppress completion flash */
     int movecount, movetarget;
     int lastx, lasty, lastr;	       /* coordinates of last rotation */
+    solve_path *soln;
 };
 
 static game_params *default_params(void)
@@ -468,6 +477,7 @@ static game_state *new_game(midend *me, const game_params *params,
     state->movecount = 0;
     state->movetarget = params->movetarget;
     state->lastx = state->lasty = state->lastr = -1;
+    state->soln = NULL;
 
     state->grid = snewn(wh, int);
 
@@ -507,6 +517,7 @@ static game_state *dup_game(const game_state *state)
     ret->lasty = state->lasty;
     ret->lastr = state->lastr;
     ret->used_solve = state->used_solve;
+    ret->soln = solve_path_ref(state->soln);
 
     ret->grid = snewn(ret->w * ret->h, int);
     memcpy(ret->grid, state->grid, ret->w * ret->h * sizeof(int));
@@ -516,6 +527,7 @@ static game_state *dup_game(const game_state *state)
 
 static void free_game(game_state *state)
 {
+    solve_path_free(state->soln);
     sfree(state->grid);
     sfree(state);
 }
@@ -532,10 +544,442 @@ static int compare_int(const void *av, const void *bv)
 	return 0;
 }
 
+/* ----------------------------------------------------------------------
+ * Solver.
+ *
+ * This is a bidirectional breadth-first search: we search outwards
+ * from the current position and backwards from the solution at the
+ * same time, a layer at a time on whichever side has the smaller
+ * frontier, until the two meet in the middle. Each position is
+ * packed into a byte per square, holding the tile's rank among the
+ * distinct numbers in the grid (so that in rows-only mode, tiles
+ * with the same number are indistinguishable) and, if it matters,
+ * its orientation. Each side keeps a hash table of the positions it
+ * has seen, so that none is expanded twice and we can spot the
+ * moment the two sides meet.
+ *
+ * Searching the whole puzzle at once only works if the solution is
+ * fairly short. If it isn't, we fall back to solving in stages,
+ * bringing the tiles home in numerical order, one number at a time.
+ * During each stage every tile with a higher number is replaced
+ * with the same blank, which keeps the number of positions down
+ * enough for each stage to be searched in full. The solution this
+ * finds is much longer than the shortest, but it does get there.
+ *
+ * Every search is limited to SOLVE_MAX_STATES positions in total,
+ * and if one runs out we give up altogether.
+ */
+
+#define SOLVE_MAX_STATES 500000
+#define SOLVE_HASH_SIZE 1048576		/* power of 2, > 2 * SOLVE_MAX_STATES */
+
+/*
+ * Moves are numbered 2*b+d, where b is the block's top left corner
+ * in reading order among the (w-n+1)*(h-n+1) possible ones, and d
+ * is 1 for an anticlockwise rotation (dir +1, as from a left click)
+ * and 0 for clockwise. So the inverse of move m is m^1.
+ */
+#define MOVE_BLOCK(m) ((m) >> 1)
+#define MOVE_DIR(m) ((m) & 1 ? +1 : -1)
+#define MAKE_MOVE(b, dir) (2 * (b) + ((dir) > 0))
+
+struct solver_side {
+    unsigned char *states;	       /* packed positions, in order found */
+    int *parent;		       /* index of position found from */
+    int *move;			       /* move made from parent */
+    int nstates, statesize;
+    int *hash;			       /* open addressing; -1 if empty */
+};
+
+struct solver {
+    int w, h, n, wh, nmoves;
+    /*
+     * For each move m and square i, the square whose tile m puts in
+     * i and how far round that tile is turned.
+     */
+    int *src;
+    unsigned char *turn;
+    unsigned char *usable;	       /* which moves the search may make */
+    int nstates;		       /* over both sides, for the budget */
+    struct solver_side sides[2];
+    unsigned char *cur, *next;	       /* scratch positions */
+};
+
+static struct solver *solver_new(int w, int h, int n, int orientable)
+{
+    struct solver *s = snew(struct solver);
+    int wh = w*h, bw = w-n+1;
+    int *grid = snewn(wh, int);
+    int i, m;
+
+    s->w = w;
+    s->h = h;
+    s->n = n;
+    s->wh = wh;
+    s->nmoves = 2 * bw * (h-n+1);
+    s->src = snewn(s->nmoves * wh, int);
+    s->turn = snewn(s->nmoves * wh, unsigned char);
+    s->usable = snewn(s->nmoves, unsigned char);
+    for (m = 0; m < s->nmoves; m++) {
+	s->usable[m] = TRUE;
+	for (i = 0; i < wh; i++)
+	    grid[i] = i * 4;
+	do_rotate(grid, w, h, n, TRUE, MOVE_BLOCK(m) % bw, MOVE_BLOCK(m) / bw,
+		  MOVE_DIR(m));
+	for (i = 0; i < wh; i++) {
+	    s->src[m*wh+i] = grid[i] / 4;
+	    s->turn[m*wh+i] = (orientable ? grid[i] & 3 : 0);
+	}
+    }
+    sfree(grid);
+
+    for (i = 0; i < 2; i++) {
+	struct solver_side *sd = &s->sides[i];
+	sd->statesize = 1024;
+	sd->states = snewn(sd->statesize * wh, unsigned char);
+	sd->parent = snewn(sd->statesize, int);
+	sd->move = snewn(sd->statesize, int);
+	sd->hash = snewn(SOLVE_HASH_SIZE, int);
+    }
+    s->cur = snewn(wh, unsigned char);
+    s->next = snewn(wh, unsigned char);
+
+    return s;
+}
+
+static void solver_free(struct solver *s)
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+	sfree(s->sides[i].states);
+	sfree(s->sides[i].parent);
+	sfree(s->sides[i].move);
+	sfree(s->sides[i].hash);
+    }
+    sfree(s->src);
+    sfree(s->turn);
+    sfree(s->usable);
+    sfree(s->cur);
+    sfree(s->next);
+    sfree(s);
+}
+
+/*
+ * A blank square (zero) stays blank; any other square's tile keeps
+ * its rank in the top six bits and turns in the bottom two.
+ */
+static void solver_apply(const struct solver *s, int m,
+			 const unsigned char *from, unsigned char *to)
+{
+    const int *src = s->src + m * s->wh;
+    const unsigned char *turn = s->turn + m * s->wh;
+    int i, v;
+
+    for (i = 0; i < s->wh; i++) {
+	v = from[src[i]];
+	to[i] = (v ? (v & ~3) | ((v + turn[i]) & 3) : 0);
+    }
+}
+
+static unsigned long solver_hash(const unsigned char *pos, int wh)
+{
+    unsigned long hash = 2166136261UL;
+    int i;
+
+    for (i = 0; i < wh; i++)
+	hash = ((hash ^ pos[i]) * 16777619UL) & 0xFFFFFFFFUL;
+    return hash ^ (hash >> 15);
+}
+
+/*
+ * Find a position in one side's hash table. Returns its index if
+ * present; otherwise returns -1 and sets *slot to where it should
+ * go.
+ */
+static int solver_lookup(const struct solver *s, const struct solver_side *sd,
+			 const unsigned char *pos, int *slot)
+{
+    int h = (int)(solver_hash(pos, s->wh) & (SOLVE_HASH_SIZE-1));
+
+    while (sd->hash[h] >= 0) {
+	if (!memcmp(sd->states + sd->hash[h] * s->wh, pos, s->wh))
+	    return sd->hash[h];
+	h = (h + 1) & (SOLVE_HASH_SIZE-1);
+    }
+    if (slot)
+	*slot = h;
+    return -1;
+}
+
+static int solver_add(struct solver *s, struct solver_side *sd, int slot,
+		      const unsigned char *pos, int parent, int move)
+{
+    int i = sd->nstates++;
+
+    if (i >= sd->statesize) {
+	sd->statesize = sd->statesize * 3 / 2 + 1024;
+	sd->states = sresize(sd->states, sd->statesize * s->wh, unsigned char);
+	sd->parent = sresize(sd->parent, sd->statesize, int);
+	sd->move = sresize(sd->move, sd->statesize, int);
+    }
+    memcpy(sd->states + i * s->wh, pos, s->wh);
+    sd->parent[i] = parent;
+    sd->move[i] = move;
+    sd->hash[slot] = i;
+    s->nstates++;
+
+    return i;
+}
+
+/*
+ * Read off the moves from the start to position ia on side 0, then
+ * from position ib on side 1 back to the goal.
+ */
+static int solver_path(const struct solver *s, int ia, int ib, int **moves)
+{
+    const struct solver_side *a = &s->sides[0], *b = &s->sides[1];
+    int na = 0, nb = 0, i, k;
+
+    for (k = ia; a->parent[k] >= 0; k = a->parent[k])
+	na++;
+    for (k = ib; b->parent[k] >= 0; k = b->parent[k])
+	nb++;
+
+    *moves = snewn(na + nb + 1, int);
+    for (k = ia, i = na; a->parent[k] >= 0; k = a->parent[k])
+	(*moves)[--i] = a->move[k];
+    for (k = ib, i = na; b->parent[k] >= 0; k = b->parent[k])
+	(*moves)[i++] = b->move[k] ^ 1;
+
+    return na + nb;
+}
+
+/*
+ * Search for a sequence of moves taking `start' to `goal'. Returns
+ * the number of moves, with the moves themselves in *moves, or -1
+ * if the search ran out of budget.
+ */
+static int solver_search(struct solver *s, const unsigned char *start,
+			 const unsigned char *goal, int **moves)
+{
+    int levelstart[2], i, j, k, m, slot, end, other;
+
+    if (!memcmp(start, goal, s->wh)) {
+	*moves = snewn(1, int);
+	return 0;
+    }
+
+    s->nstates = 0;
+    for (i = 0; i < 2; i++) {
+	struct solver_side *sd = &s->sides[i];
+	sd->nstates = 0;
+	for (k = 0; k < SOLVE_HASH_SIZE; k++)
+	    sd->hash[k] = -1;
+	solver_lookup(s, sd, i ? goal : start, &slot);
+	solver_add(s, sd, slot, i ? goal : start, -1, -1);
+	levelstart[i] = 0;
+    }
+
+    while (1) {
+	struct solver_side *sd;
+
+	/*
+	 * Expand the next layer of whichever side has fewer
+	 * positions waiting in its frontier.
+	 */
+	i = (s->sides[0].nstates - levelstart[0] <=
+	     s->sides[1].nstates - levelstart[1] ? 0 : 1);
+	other = 1 - i;
+	sd = &s->sides[i];
+	end = sd->nstates;
+	if (levelstart[i] == end)
+	    return -1;		       /* goal not reachable at all */
+
+	for (k = levelstart[i]; k < end; k++) {
+	    memcpy(s->cur, sd->states + k * s->wh, s->wh);
+	    for (m = 0; m < s->nmoves; m++) {
+		if (!s->usable[m])
+		    continue;
+		if (sd->move[k] >= 0 && m == (sd->move[k] ^ 1))
+		    continue;	       /* just undoes the last move */
+		solver_apply(s, m, s->cur, s->next);
+		if (solver_lookup(s, sd, s->next, &slot) >= 0)
+		    continue;
+		if (s->nstates >= SOLVE_MAX_STATES)
+		    return -1;
+		j = solver_add(s, sd, slot, s->next, k, m);
+		if ((slot = solver_lookup(s, &s->sides[other],
+					  s->next, NULL)) >= 0)
+		    return (i == 0 ? solver_path(s, j, slot, moves) :
+			    solver_path(s, slot, j, moves));
+	    }
+	}
+	levelstart[i] = end;
+    }
+}
+
+/*
+ * Append a move to a growing solution, cancelling it against the
+ * moves already there where we can.
+ */
+static void solve_append(int *moves, int *nmoves, int m)
+{
+    if (*nmoves > 0 && moves[*nmoves-1] == (m ^ 1)) {
+	(*nmoves)--;
+    } else if (*nmoves > 1 && moves[*nmoves-1] == m &&
+	       moves[*nmoves-2] == m) {
+	/* Three quarter turns the same way make one the other way. */
+	*nmoves -= 2;
+	solve_append(moves, nmoves, m ^ 1);
+    } else {
+	moves[(*nmoves)++] = m;
+    }
+}
+
+/*
+ * Solve a grid, returning the moves (and setting *nmoves), or NULL
+ * if we gave up.
+ */
+static int *solve_grid(const int *grid, int w, int h, int n, int orientable,
+		       int *nmoves)
+{
+    struct solver *s;
+    int wh = w*h;
+    int *nums, *vals, *moves, *stage;
+    unsigned char *pos, *goal, *mpos, *mgoal;
+    int i, j, k, m, t, x, y, nvals, nusable, nstage = -1, size;
+
+    /*
+     * Rank the distinct numbers in the grid, from 1 upwards so that
+     * zero is free to mean a blank. There's only room in a byte for
+     * 63 of them.
+     */
+    nums = snewn(wh, int);
+    vals = snewn(wh, int);
+    for (i = 0; i < wh; i++)
+	nums[i] = grid[i] / 4;
+    qsort(nums, wh, sizeof(int), compare_int);
+    for (i = nvals = 0; i < wh; i++)
+	if (nvals == 0 || nums[i] != vals[nvals-1])
+	    vals[nvals++] = nums[i];
+    if (nvals > 63) {
+	sfree(nums);
+	sfree(vals);
+	return NULL;
+    }
+
+    pos = snewn(wh, unsigned char);
+    goal = snewn(wh, unsigned char);
+    mpos = snewn(wh, unsigned char);
+    mgoal = snewn(wh, unsigned char);
+    for (i = 0; i < wh; i++) {
+	for (j = 0; vals[j] != grid[i] / 4; j++);
+	pos[i] = (j+1) * 4 + (orientable ? grid[i] & 3 : 0);
+	for (j = 0; vals[j] != nums[i]; j++);
+	goal[i] = (j+1) * 4;
+    }
+
+    s = solver_new(w, h, n, orientable);
+
+    /*
+     * First try the whole thing at once, in case the solution is
+     * short enough to find the best one. Otherwise, solve it a
+     * number at a time.
+     */
+    *nmoves = solver_search(s, pos, goal, &moves);
+    if (*nmoves < 0) {
+	size = wh;
+	moves = snewn(size, int);
+	*nmoves = 0;
+	for (k = 1; k <= nvals; k++) {
+	    for (i = 0; i < wh; i++) {
+		mpos[i] = (pos[i] / 4 <= k ? pos[i] : 0);
+		mgoal[i] = (goal[i] / 4 <= k ? goal[i] : 0);
+	    }
+
+	    /*
+	     * Leave alone the blocks lying entirely among the squares
+	     * already finished with, if we can, since that cuts the
+	     * search down a lot once there are only a few tiles left
+	     * to place. If there's no solution that way, let the
+	     * search use the blocks over the most recently finished
+	     * squares too, and so on back until it can use them all.
+	     */
+	    nusable = 0;
+	    for (t = k; t > 0; t--) {
+		for (m = i = 0; m < s->nmoves; m++) {
+		    int bx = MOVE_BLOCK(m) % (w-n+1);
+		    int by = MOVE_BLOCK(m) / (w-n+1);
+		    s->usable[m] = FALSE;
+		    for (y = by; y < by+n; y++)
+			for (x = bx; x < bx+n; x++)
+			    if (goal[y*w+x] / 4 >= t)
+				s->usable[m] = TRUE;
+		    i += s->usable[m];
+		}
+		if (i == nusable)
+		    continue;	       /* no different from last time */
+		nusable = i;
+		nstage = solver_search(s, mpos, mgoal, &stage);
+		if (nstage >= 0 || nusable == s->nmoves)
+		    break;
+	    }
+	    if (nstage < 0) {
+		sfree(moves);
+		moves = NULL;
+		break;
+	    }
+	    if (*nmoves + nstage > size) {
+		size = (*nmoves + nstage) * 3 / 2;
+		moves = sresize(moves, size, int);
+	    }
+	    for (i = 0; i < nstage; i++) {
+		solver_apply(s, stage[i], pos, mpos);
+		memcpy(pos, mpos, wh);
+		solve_append(moves, nmoves, stage[i]);
+	    }
+	    sfree(stage);
+	}
+    }
+
+    solver_free(s);
+    sfree(nums);
+    sfree(vals);
+    sfree(pos);
+    sfree(goal);
+    sfree(mpos);
+    sfree(mgoal);
+    return moves;
+}
+
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *aux, const char **error)
 {
-    return dupstr("S");
+    int w = currstate->w, h = currstate->h, n = currstate->n;
+    int bw = w-n+1;
+    int *moves, nmoves, i, len;
+    char *ret;
+
+    moves = solve_grid(currstate->grid, w, h, n, currstate->orientable,
+		       &nmoves);
+    if (!moves) {
+	/*
+	 * The search ran out of budget, as it does on the largest
+	 * presets. Rather than leave Solve doing nothing, just jump
+	 * to the solved position, as this game always used to.
+	 */
+	return dupstr("S");
+    }
+
+    ret = snewn(2 + nmoves * 40, char);
+    len = sprintf(ret, "S");
+    for (i = 0; i < nmoves; i++)
+	len += sprintf(ret + len, ";M%d,%d,%d", MOVE_BLOCK(moves[i]) % bw,
+		       MOVE_BLOCK(moves[i]) / bw, MOVE_DIR(moves[i]));
+    sfree(moves);
+
+    return ret;
 }
 
 static int game_can_format_as_text_now(const game_params *params)
@@ -631,6 +1075,7 @@ struct game_drawstate {
     int *grid;
     int tilesize;
     int cur_x, cur_y;
+    int *animgrid;                     /* a step of an animated Solve */
 };
 
 static char *interpret_move(const game_state *state, game_ui *ui,
@@ -731,20 +1176,50 @@ static game_state *execute_move(const game_state *from, const char *move)
     int w = from->w, h = from->h, n = from->n, wh = w*h;
     int x, y, dir;
 
-    if (!strcmp(move, "S")) {
+    if (move[0] == 'S') {
+	solve_path *sol;
 	int i;
-	ret = dup_game(from);
 
-	/*
-	 * Simply replace the grid with a solved one. For this game,
-	 * this isn't a useful operation for actually telling the user
-	 * what they should have done, but it is useful for
-	 * conveniently being able to get hold of a clean state from
-	 * which to practise manoeuvres.
-	 */
-	qsort(ret->grid, ret->w*ret->h, sizeof(int), compare_int);
-	for (i = 0; i < ret->w*ret->h; i++)
-	    ret->grid[i] &= ~3;
+	ret = dup_game(from);
+	solve_path_free(ret->soln);
+	ret->soln = sol = solve_path_new(strlen(move));
+
+	if (!move[1]) {
+	    /*
+	     * Simply replace the grid with a solved one. We do this
+	     * for a Solve move from an older version, or when the
+	     * solver gave up on finding the rotations; it isn't a
+	     * useful operation for actually telling the user what
+	     * they should have done, but it is useful for
+	     * conveniently being able to get hold of a clean state
+	     * from which to practise manoeuvres.
+	     */
+	    qsort(ret->grid, ret->w*ret->h, sizeof(int), compare_int);
+	    for (i = 0; i < ret->w*ret->h; i++)
+		ret->grid[i] &= ~3;
+	} else {
+	    /*
+	     * Otherwise the Solve move is a sequence of rotations,
+	     * which we make one at a time, remembering them so that
+	     * they can be animated.
+	     */
+	    for (move++; *move == ';'; move += strcspn(move, ";")) {
+		move++;
+		if (move[0] != 'M' ||
+		    sscanf(move+1, "%d,%d,%d", &x, &y, &dir) != 3 ||
+		    x < 0 || y < 0 || x > w - n || y > h - n ||
+		    (dir != +1 && dir != -1)) {
+		    free_game(ret);
+		    return NULL;
+		}
+		do_rotate(ret->grid, w, h, n, ret->orientable, x, y, dir);
+		sol->moves[sol->nmoves++] = MAKE_MOVE(y*(w-n+1)+x, dir);
+	    }
+	    if (*move || !grid_complete(ret->grid, wh, ret->orientable)) {
+		free_game(ret);
+		return NULL;
+	    }
+	}
 	ret->used_solve = TRUE;
 	ret->completed = ret->movecount = 1;
 
@@ -757,6 +1232,8 @@ static game_state *execute_move(const game_state *from, const char *move)
 	return NULL;		       /* can't parse this move string */
 
     ret = dup_game(from);
+    solve_path_free(ret->soln);
+    ret->soln = NULL;
     ret->movecount++;
     do_rotate(ret->grid, w, h, n, ret->orientable, x, y, dir);
     ret->lastx = x;
@@ -830,12 +1307,14 @@ static game_drawstate *game_new_drawstate(drawing *dr, const game_state *state)
     for (i = 0; i < ds->w*ds->h; i++)
         ds->grid[i] = -1;
     ds->cur_x = ds->cur_y = -state->n;
+    ds->animgrid = snewn(ds->w*ds->h, int);
 
     return ds;
 }
 
 static void game_free_drawstate(drawing *dr, game_drawstate *ds)
 {
+    sfree(ds->animgrid);
     sfree(ds->grid);
     sfree(ds);
 }
@@ -1047,6 +1526,61 @@ static int highlight_colour(float angle)
     return colours[(int)((angle + 2*PI) / (PI/16)) & 31];
 }
 
+static float rotate_time(int n)
+{
+    return (float)(ANIM_PER_BLKSIZE_UNIT * sqrt(n-1));
+}
+
+/*
+ * A Solve move is animated one rotation at a time, each taking at
+ * most the time of an ordinary move, and all of them together at
+ * most SOLVE_ANIM_TIME.
+ */
+static const solve_path *anim_soln(const game_state *oldstate,
+                             const game_state *newstate, int dir)
+{
+    return (dir > 0 ? newstate : oldstate)->soln;
+}
+
+/*
+ * Work out which step of a Solve move we're part way through, and
+ * fill in `grid' with the grid after it and *x, *y and *r with the
+ * rotation it makes. Returns how far through the step we are,
+ * scaled to look like the time into an ordinary move.
+ */
+static float solve_anim_step(const game_state *oldstate,
+                             const game_state *state, int dir,
+                             float animtime, int *grid,
+                             int *x, int *y, int *r)
+{
+    const solve_path *sol = anim_soln(oldstate, state, dir);
+    int w = state->w, h = state->h, n = state->n;
+    float steptime = solve_path_step_time(sol, rotate_time(n));
+    int step = (int)(animtime / steptime);
+    int i, move;
+
+    if (step >= sol->nmoves)
+        step = sol->nmoves - 1;
+
+    /*
+     * When undoing, we're going from the solved position back
+     * through the moves in reverse.
+     */
+    memcpy(grid, oldstate->grid, w * h * sizeof(int));
+    for (i = 0; i <= step; i++) {
+        if (dir > 0)
+            move = sol->moves[i];
+        else
+            move = sol->moves[sol->nmoves - 1 - i] ^ 1;
+        *x = MOVE_BLOCK(move) % (w-n+1);
+        *y = MOVE_BLOCK(move) / (w-n+1);
+        *r = MOVE_DIR(move);
+        do_rotate(grid, w, h, n, state->orientable, *x, *y, *r);
+    }
+
+    return (animtime - step * steptime) * rotate_time(n) / steptime;
+}
+
 static float game_anim_length_real(const game_state *oldstate,
                                    const game_state *newstate, int dir,
                                    const game_ui *ui)
@@ -1058,7 +1592,12 @@ static float game_anim_length_real(const game_state *oldstate,
      * non-const, but we still need this version to call from within
      * game_redraw which only has a const ui available.
      */
-    return (float)(ANIM_PER_BLKSIZE_UNIT * sqrt(newstate->n-1));
+    const solve_path *sol = anim_soln(oldstate, newstate, dir);
+
+    if (sol)
+        return sol->nmoves * solve_path_step_time(sol,
+                                                  rotate_time(newstate->n));
+    return rotate_time(newstate->n);
 }
 
 static float game_anim_length(const game_state *oldstate,
@@ -1092,6 +1631,7 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
     struct rotation srot, *rot;
     int lastx = -1, lasty = -1, lastr = -1;
     int cx, cy, cmoved = 0, n = state->n;
+    const int *grid = state->grid;
 
     cx = ui->cur_visible ? ui->cur_x : -state->n;
     cy = ui->cur_visible ? ui->cur_y : -state->n;
@@ -1145,7 +1685,12 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
 	float angle;
 	float anim_max = game_anim_length_real(oldstate, state, dir, ui);
 
-	if (dir > 0) {
+	if (anim_soln(oldstate, state, dir)) {
+	    animtime = solve_anim_step(oldstate, state, dir, animtime,
+				       ds->animgrid, &lastx, &lasty, &lastr);
+	    anim_max = rotate_time(n);
+	    grid = ds->animgrid;
+	} else if (dir > 0) {
 	    lastx = state->lastx;
 	    lasty = state->lasty;
 	    lastr = state->lastr;
@@ -1196,7 +1741,7 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
 	    ty >= lasty && ty < lasty + state->n)
 	    t = -1;
 	else
-	    t = state->grid[i];
+	    t = grid[i];
 
         if (cmoved) {
             /* cursor has moved (or changed visibility)... */
@@ -1217,7 +1762,7 @@ static void game_redraw(drawing *dr, game_drawstate *ds,
             if (tx == cx+n-1 && ty >= cy && ty <= cy+n-1) cedges |= CUR_RIGHT;
             if (ty == cy+n-1 && tx >= cx && tx <= cx+n-1) cedges |= CUR_BOTTOM;
 
-	    draw_tile(dr, ds, state, x, y, state->grid[i], bgcolour, rot, cedges);
+	    draw_tile(dr, ds, state, x, y, grid[i], bgcolour, rot, cedges);
             ds->grid[i] = t;
         }
     }
@@ -1285,6 +1830,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     TRUE, solve_game,
     TRUE, game_can_format_as_text_now, game_text_format,
     new_ui,
@@ -1305,7 +1851,7 @@ const struct game thegame = {
     FALSE, FALSE, game_print_size, game_print,
     TRUE,			       /* wants_statusbar */
     FALSE, game_timing_state,
-    0,				       /* flags */
+    SOLVE_ANIMATES,		       /* flags */
 };
 
 /* vim: set shiftwidth=4 tabstop=8: */
@@ -997,7 +997,18 @@ int maxtries;
 #else
 #define MAXTRIES 50
 #endif
+
+/*
+ * A count of solver runs, for the standalone solver's reports. It's
+ * only kept there, since the puzzle pool in the mid-end can run two
+ * generators at once.
+ */
+#ifdef STANDALONE_SOLVER
 int gg_solved;
+#define COUNT_SOLVE() (gg_solved++)
+#else
+#define COUNT_SOLVE() ((void)0)
+#endif
 
 static int game_assemble(game_state *new, int *scratch, digit *latin,
                          int difficulty)
@@ -1022,7 +1033,7 @@ static int game_assemble(game_state *new, int *scratch, digit *latin,
 #endif
 
     while(1) {
-        gg_solved++;
+        COUNT_SOLVE();
         if (solver_state(copy, difficulty) == 1) break;
 
         best = gg_best_clue(copy, scratch, latin);
@@ -1053,7 +1064,7 @@ static void game_strip(game_state *new, int *scratch, digit *latin,
 
         memcpy(copy->nums,  new->nums,  o2 * sizeof(digit));
         memcpy(copy->flags, new->flags, o2 * sizeof(unsigned int));
-        gg_solved++;
+        COUNT_SOLVE();
         if (solver_state(copy, difficulty) != 1) {
             /* put clue back, we can't solve without it. */
             int ret = gg_place_clue(new, scratch[i], latin, 0);
@@ -1136,7 +1147,9 @@ generate:
         add_adjacent_flags(state, sq);
     }
 
+#ifdef STANDALONE_SOLVER
     gg_solved = 0;
+#endif
     if (game_assemble(state, scratch, sq, params->diff) < 0)
         goto generate;
     game_strip(state, scratch, sq, params->diff);
@@ -2005,6 +2018,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     TRUE, solve_game,
     TRUE, game_can_format_as_text_now, game_text_format,
     new_ui,
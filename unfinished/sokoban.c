@@ -1451,6 +1451,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL,
     FALSE, solve_game,
     FALSE, game_can_format_as_text_now, game_text_format,
     new_ui,